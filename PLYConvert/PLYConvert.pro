@@ -0,0 +1,38 @@
+#-------------------------------------------------
+#
+# Batch conversion of PLY files
+#
+#-------------------------------------------------
+
+QT       -= gui
+
+TARGET = plyconvert
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+# Shared Project Configuration
+include(../config.pri)
+
+SOURCES += \
+    main.cpp
+
+# Add in the QPLY library
+win32-g++:CONFIG(release, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../QPLY/release/libQPLY.a
+else:win32-g++:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../QPLY/debug/libQPLY.a
+else:win32:!win32-g++:CONFIG(release, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../QPLY/release/QPLY.lib
+else:win32:!win32-g++:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../QPLY/debug/QPLY.lib
+else:macx: PRE_TARGETDEPS += $$OUT_PWD/../QPLY/libQPLY.a
+
+win32:CONFIG(release, debug|release): LIBS += -L$$OUT_PWD/../QPLY/release/ -lQPLY
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$OUT_PWD/../QPLY/debug/ -lQPLY
+else:macx: LIBS += -L$$OUT_PWD/../QPLY/ -lQPLY
+
+INCLUDEPATH += $$PWD/../QPLY/include
+DEPENDPATH += $$PWD/../QPLY/include
+
+# QPLY reads and writes .ply.gz files through zlib
+macx: LIBS += -lz
+win32:CONFIG(debug, debug|release): LIBS += -lzlibd
+else:win32: LIBS += -lzlib
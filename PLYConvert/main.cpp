@@ -0,0 +1,304 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSet>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include <QAtomicInt>
+
+#include <cstdio>
+
+#include <io.h>
+#include <column.h>
+#include <gzip.h>
+
+// The settings shared by all conversions
+struct ConvertOptions {
+    PLY::Stream_type mType;     // The format of the output files
+    QStringList mDrop;          // The properties to leave out, as NAME or ELEMENT.NAME
+    qint64 mMemoryLimit;        // The largest input file converted in memory, in bytes
+    int mThreads;               // The threads used within each conversion (0: all cores)
+};
+
+// Check whether a property should be left out of the output
+static bool isDropped(const ConvertOptions& pOptions, const PLY::Element& pElem, const PLY::Property& pProp) {
+    QString lName = QString::fromStdString(pProp.name);
+    QString lFullName = QString::fromStdString(pElem.name) + "." + lName;
+    return pOptions.mDrop.contains(lName) || pOptions.mDrop.contains(lFullName);
+}
+
+// Convert one file, in memory or streaming batch by batch
+static bool convertFile(const QString& pInput, const QString& pOutput, const ConvertOptions& pOptions, bool pInMemory) {
+    PLY::Header lInHeader;
+    PLY::Reader lReader(lInHeader);
+    lReader.threads = pOptions.mThreads;
+    bool lOpened = pInMemory ? lReader.map_file(pInput) : lReader.open_file(pInput);
+    if (!lOpened) {
+        qWarning("Failed to open '%s'", pInput.toLocal8Bit().data());
+        return false;
+    }
+
+    // Dropped properties are skipped while reading and left out of the output
+    for (PLY::Element& lElem : lInHeader.elements) {
+        for (PLY::Property& lProp : lElem.props) {
+            if (isDropped(pOptions, lElem, lProp)) {
+                lProp.store = false;
+            }
+        }
+    }
+
+    // The writer changes the stream type of its header, so it gets a copy
+    PLY::Header lOutHeader = lInHeader;
+    PLY::Writer lWriter(lOutHeader, pOutput.toLocal8Bit().data(), pOptions.mType);
+    lWriter.threads = pOptions.mThreads;
+    if (lWriter.source == nullptr) {
+        qWarning("Failed to create '%s'", pOutput.toLocal8Bit().data());
+        lReader.close_file();
+        return false;
+    }
+
+    bool lOK = true;
+    if (pInMemory) {
+        PLY::ColumnStorage lStore(lInHeader);
+        lOK = lReader.read_data(&lStore) && lWriter.write_data(&lStore);
+    } else {
+        // Only one batch of each element is in memory at a time
+        PLY::Batch lBatch;
+        lOK = lReader.start_batches() && lWriter.write_header();
+        while (lOK && lReader.next_batch(lBatch)) {
+            lOK = lWriter.write_batch(*lOutHeader.find_element(lBatch.elem->name.c_str()), lBatch.rows);
+        }
+        lOK = lOK && lReader.batches_done();
+    }
+
+    lReader.close_file();
+    lOK = lWriter.close_file() && lOK;
+    if (!lOK) {
+        qWarning("Failed to convert '%s'", pInput.toLocal8Bit().data());
+        QFile::remove(pOutput);
+    }
+    return lOK;
+}
+
+// The conversion of one file on the worker pool
+class ConvertTask : public QRunnable {
+public:
+    ConvertTask(QString pInput, QString pOutput, const ConvertOptions& pOptions,
+                QMutex& pReportLock, QAtomicInt& pFailures, int pIndex, int pCount) :
+        mInput(pInput), mOutput(pOutput), mOptions(pOptions), mReportLock(pReportLock),
+        mFailures(pFailures), mIndex(pIndex), mCount(pCount) {}
+
+    void run() {
+        // Compressed inputs are always streamed, as their size says little about the inflated data
+        qint64 lBytes = QFileInfo(mInput).size();
+        bool lInMemory = !PLY::is_gzip_file(mInput) && lBytes <= mOptions.mMemoryLimit;
+
+        QElapsedTimer lTimer;
+        lTimer.start();
+        bool lOK = convertFile(mInput, mOutput, mOptions, lInMemory);
+        double lSeconds = lTimer.nsecsElapsed() / 1e9;
+
+        if (!lOK) {
+            mFailures.ref();
+        }
+
+        // Report each file on a line of its own, measured by its size on disk
+        QMutexLocker lLocker(&mReportLock);
+        QTextStream lOut(stdout);
+        lOut << "[" << mIndex << "/" << mCount << "] " << mInput << " -> " << mOutput << ": ";
+        if (lOK) {
+            double lMB = lBytes / (1024.0 * 1024.0);
+            lOut << QString::number(lMB, 'f', 1) << " MB on disk in " << QString::number(lSeconds, 'f', 2) << " s ("
+                 << QString::number(lSeconds > 0 ? lMB / lSeconds : 0.0, 'f', 1) << " MB/s on disk, "
+                 << (lInMemory ? "in memory" : "streaming") << ")";
+        } else {
+            lOut << "FAILED";
+        }
+        lOut << endl;
+    }
+
+private:
+    QString mInput, mOutput;
+    const ConvertOptions& mOptions;
+    QMutex& mReportLock;
+    QAtomicInt& mFailures;
+    int mIndex, mCount;
+};
+
+// Expand the inputs into a list of files
+static QStringList expandInputs(const QStringList& pArgs) {
+    QStringList lFiles;
+    for (const QString& lArg : pArgs) {
+        QFileInfo lInfo(lArg);
+        if (lArg.contains('*') || lArg.contains('?') || lArg.contains('[')) {
+            // Wildcards are expanded here, as not every shell does so
+            QDir lDir = lInfo.absoluteDir();
+            for (const QFileInfo& lMatch : lDir.entryInfoList(QStringList(lInfo.fileName()), QDir::Files, QDir::Name)) {
+                lFiles << lMatch.absoluteFilePath();
+            }
+        } else if (lInfo.isDir()) {
+            QStringList lFilters;
+            lFilters << "*.ply" << "*.ply.gz";
+            for (const QFileInfo& lMatch : QDir(lArg).entryInfoList(lFilters, QDir::Files, QDir::Name)) {
+                lFiles << lMatch.absoluteFilePath();
+            }
+        } else {
+            lFiles << lInfo.absoluteFilePath();
+        }
+    }
+    return lFiles;
+}
+
+// Read a list of inputs from a text file, one on each line
+static bool readInputList(const QString& pListFile, QStringList& pArgs) {
+    QFile lFile(pListFile);
+    if (!lFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return false;
+    }
+    QTextStream lIn(&lFile);
+    while (!lIn.atEnd()) {
+        QString lLine = lIn.readLine().trimmed();
+        if (!lLine.isEmpty() && !lLine.startsWith('#')) {
+            pArgs << lLine;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication lApp(argc, argv);
+    QCoreApplication::setApplicationName("plyconvert");
+
+    QCommandLineParser lParser;
+    lParser.setApplicationDescription("Convert PLY files between ASCII and binary, change their byte order "
+                                      "and leave out unused properties.");
+    lParser.addHelpOption();
+    lParser.addPositionalArgument("inputs", "PLY files, directories or wildcard patterns to convert.", "[inputs...]");
+
+    QCommandLineOption lOutputOption(QStringList() << "o" << "output-dir",
+                                     "Write the converted files to <dir>, under their own names.", "dir");
+    QCommandLineOption lFormatOption(QStringList() << "f" << "format",
+                                     "The output format: ascii, binary (in the byte order of this system), "
+                                     "binary_little_endian or binary_big_endian.", "format", "binary");
+    QCommandLineOption lDropOption(QStringList() << "d" << "drop",
+                                   "Leave out a property, as <name> (in any element) or <element.name>. "
+                                   "Can be repeated or given as a comma separated list.", "name");
+    QCommandLineOption lListOption(QStringList() << "l" << "list",
+                                   "Also convert the inputs listed in <file>, one on each line.", "file");
+    QCommandLineOption lJobsOption(QStringList() << "j" << "jobs",
+                                   "Convert <n> files at a time (default: one for each core).", "n");
+    QCommandLineOption lMemoryOption(QStringList() << "m" << "memory-limit",
+                                     "Convert files of up to <mb> megabytes in memory, and stream larger and compressed "
+                                     "files batch by batch.", "mb", "1024");
+    lParser.addOption(lOutputOption);
+    lParser.addOption(lFormatOption);
+    lParser.addOption(lDropOption);
+    lParser.addOption(lListOption);
+    lParser.addOption(lJobsOption);
+    lParser.addOption(lMemoryOption);
+    lParser.process(lApp);
+
+    // Gather the inputs
+    QStringList lArgs = lParser.positionalArguments();
+    for (const QString& lListFile : lParser.values(lListOption)) {
+        if (!readInputList(lListFile, lArgs)) {
+            qWarning("Cannot read the input list '%s'", lListFile.toLocal8Bit().data());
+            return 1;
+        }
+    }
+    QStringList lInputs = expandInputs(lArgs);
+    if (lInputs.isEmpty()) {
+        qWarning("No input files");
+        lParser.showHelp(1);
+    }
+
+    if (!lParser.isSet(lOutputOption)) {
+        qWarning("No output directory given");
+        lParser.showHelp(1);
+    }
+    QDir lOutputDir(lParser.value(lOutputOption));
+    if (!lOutputDir.exists() && !QDir().mkpath(lOutputDir.path())) {
+        qWarning("Cannot create the output directory '%s'", lOutputDir.path().toLocal8Bit().data());
+        return 1;
+    }
+
+    // Gather the options
+    ConvertOptions lOptions;
+    QString lFormat = lParser.value(lFormatOption);
+    if (lFormat == "ascii") {
+        lOptions.mType = PLY::ASCII;
+    } else if (lFormat == "binary") {
+        lOptions.mType = PLY::Header().system();
+    } else if (lFormat == "binary_little_endian") {
+        lOptions.mType = PLY::BINARY_LE;
+    } else if (lFormat == "binary_big_endian") {
+        lOptions.mType = PLY::BINARY_BE;
+    } else {
+        qWarning("Unknown format '%s'", lFormat.toLocal8Bit().data());
+        return 1;
+    }
+
+    for (const QString& lDrop : lParser.values(lDropOption)) {
+        for (const QString& lName : lDrop.split(',', QString::SkipEmptyParts)) {
+            lOptions.mDrop << lName.trimmed();
+        }
+    }
+
+    bool lOK = true;
+    qint64 lMemoryMB = lParser.value(lMemoryOption).toLongLong(&lOK);
+    if (!lOK || lMemoryMB < 0) {
+        qWarning("Invalid memory limit '%s'", lParser.value(lMemoryOption).toLocal8Bit().data());
+        return 1;
+    }
+    lOptions.mMemoryLimit = lMemoryMB * 1024 * 1024;
+
+    int lJobs = QThread::idealThreadCount();
+    if (lParser.isSet(lJobsOption)) {
+        lJobs = lParser.value(lJobsOption).toInt(&lOK);
+        if (!lOK || lJobs < 1) {
+            qWarning("Invalid number of jobs '%s'", lParser.value(lJobsOption).toLocal8Bit().data());
+            return 1;
+        }
+    }
+
+    // A single job uses all cores for its file; otherwise each file gets one thread
+    lOptions.mThreads = (lJobs == 1 ? 0 : 1);
+
+    // Convert the files on a bounded pool of workers
+    QThreadPool lWorkers;
+    lWorkers.setMaxThreadCount(lJobs);
+    QMutex lReportLock;
+    QAtomicInt lFailures(0);
+    QSet<QString> lOutputs;
+    for (int i = 0; i < lInputs.size(); i++) {
+        QString lInput = lInputs[i];
+        QString lOutput = lOutputDir.absoluteFilePath(QFileInfo(lInput).fileName());
+
+        // Never overwrite an input, or the output of another input
+        bool lSameFile = QFileInfo(lOutput).exists() &&
+                QFileInfo(lOutput).canonicalFilePath() == QFileInfo(lInput).canonicalFilePath();
+        if (lOutputs.contains(lOutput) || lSameFile) {
+            qWarning("Skipping '%s', as it would overwrite '%s'", lInput.toLocal8Bit().data(), lOutput.toLocal8Bit().data());
+            lFailures.ref();
+            continue;
+        }
+        lOutputs.insert(lOutput);
+
+        lWorkers.start(new ConvertTask(lInput, lOutput, lOptions, lReportLock, lFailures, i + 1, lInputs.size()));
+    }
+    lWorkers.waitForDone();
+
+    int lFailed = lFailures.load();
+    if (lFailed > 0) {
+        qWarning("%d of %d files could not be converted", lFailed, lInputs.size());
+        return 1;
+    }
+    return 0;
+}
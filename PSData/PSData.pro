@@ -6,7 +6,7 @@
 
 TARGET = psdata
 TEMPLATE = lib
-QT += core gui
+QT += core gui concurrent
 
 DEFINES += PSDATA_LIBRARY
 
@@ -17,6 +17,7 @@ include(../config.pri)
 LIBS += -lquazip
 
 SOURCES += \
+    src/MeshSimplifier.cpp \
     src/PLYMeshData.cpp \
     src/PSCameraData.cpp \
     src/PSChunkData.cpp \
@@ -34,6 +35,7 @@ SOURCES += \
 HEADERS += \
     psdata_global.h \
     include/EnumFactory.h \
+    include/MeshSimplifier.h \
     include/PLYMeshData.h \
     include/PSCameraData.h \
     include/PSChunkData.h \
@@ -63,3 +65,8 @@ else:win32-g++:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../QPLY
 else:win32:!win32-g++:CONFIG(release, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../QPLY/release/QPLY.lib
 else:win32:!win32-g++:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../QPLY/debug/QPLY.lib
 else:macx: PRE_TARGETDEPS += $$OUT_PWD/../QPLY/libQPLY.a
+
+# QPLY reads and writes .ply.gz files through zlib
+macx: LIBS += -lz
+win32:CONFIG(debug, debug|release): LIBS += -lzlibd
+else:win32: LIBS += -lzlib
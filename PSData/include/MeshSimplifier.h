@@ -0,0 +1,102 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include "psdata_global.h"
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <queue>
+#include <vector>
+
+// One level of detail, made of triangles over the vertices of the full mesh
+struct PSDATASHARED_EXPORT MeshLOD {
+    std::vector<unsigned int> mIndices;     // Three vertex indices per face
+    float mError;                           // Estimated distance to the full surface (model units)
+};
+
+// Quadric error metric simplification by half-edge collapses.
+// Each collapse moves a vertex onto one of its neighbors, so every LOD reuses
+// the vertices (and vertex buffer) of the full mesh. Vertices on open borders and
+// non-manifold edges never move; once a mesh is welded a UV seam is an open border
+// on both of its sides, so the seams and the texture atlas mapping are kept.
+class PSDATASHARED_EXPORT MeshSimplifier {
+public:
+    // Positions are x, y, z floats, pStride floats apart; there are three indices per face
+    MeshSimplifier(const float* pPositions, size_t pStride, size_t pVertexCount,
+                   const unsigned int* pIndices, size_t pFaceCount);
+
+    // Simplify down to each face count in turn, making one LOD per target. A LOD has more
+    // faces than its target when no more vertices can move. Can only be called once.
+    // Setting pCancel (from any thread) stops the build early, and then no LODs are returned.
+    std::vector<MeshLOD> buildLODs(std::vector<size_t> pTargets, const std::atomic<bool>* pCancel = nullptr);
+
+    // Number of vertices that cannot move
+    size_t getLockedCount() const { return mLockedCount; }
+
+private:
+    // Sum of squared distances to planes, weighted by the area of the face of each plane
+    struct Quadric {
+        double mA2, mAB, mAC, mAD, mB2, mBC, mBD, mC2, mCD, mD2;
+        double mArea;
+
+        Quadric();
+        void addPlane(double pA, double pB, double pC, double pD, double pArea);
+        void add(const Quadric& pOther);
+        double evaluate(double pX, double pY, double pZ) const;
+    };
+
+    // Collapse of a vertex onto its best neighbor, valid while the vertex stamp is unchanged
+    struct QueuedCollapse {
+        float mCost;
+        unsigned int mVertex, mStamp;
+        bool operator>(const QueuedCollapse& pOther) const { return mCost > pOther.mCost; }
+    };
+
+    const float* position(unsigned int pVertex) const { return mPositions + pVertex*mStride; }
+    bool faceHas(unsigned int pFace, unsigned int pVertex) const;
+
+    // Setup helper functions
+    void buildAdjacency();
+    void lockBorderVertices();
+    void computeQuadrics();
+
+    // Live faces and neighbors of a vertex
+    void gatherFaces(unsigned int pVertex, std::vector<unsigned int>& pFaces) const;
+    void gatherNeighbors(unsigned int pVertex, std::vector<unsigned int>& pNeighbors) const;
+
+    // Collapse helper functions
+    bool canCollapse(unsigned int pFrom, unsigned int pTo);
+    void queueBestCollapse(unsigned int pVertex, bool pCheck);
+    void collapse(unsigned int pFrom, unsigned int pTo);
+    void compactQueue();
+    MeshLOD currentLOD() const;
+
+    // Input mesh
+    const float* mPositions;
+    size_t mStride, mVertexCount, mFaceCount;
+    std::vector<unsigned int> mFaces;
+    std::vector<char> mFaceAlive;
+    size_t mLiveFaces;
+
+    // Faces of each vertex: the initial CSR lists, replaced by a merged list once a vertex absorbs another
+    std::vector<unsigned int> mAdjStart, mAdjFaces;
+    std::vector<std::vector<unsigned int> > mMergedFaces;
+
+    // Per vertex state
+    std::vector<Quadric> mQuadrics;
+    std::vector<char> mLocked, mAlive;
+    std::vector<unsigned int> mStamp, mBestTarget;
+    std::vector<float> mBestCost;
+    size_t mLockedCount, mQueuedCount;
+
+    // Pending collapses, cheapest first
+    std::priority_queue<QueuedCollapse, std::vector<QueuedCollapse>, std::greater<QueuedCollapse> > mQueue;
+    float mMaxError;
+
+    // Scratch lists reused by the collapse checks
+    std::vector<unsigned int> mScratchFaces, mScratchLinkFrom, mScratchLinkTo;
+    std::vector<unsigned int> mScratchCandidates, mScratchUpdates;
+};
+
+#endif
@@ -2,10 +2,14 @@
 #define PLY_MESH_DATA_H
 
 #include "psdata_global.h"
+#include "MeshSimplifier.h"
 
 #include <QString>
 #include <QFileInfo>
 
+#include <atomic>
+#include <functional>
+
 #ifdef _WIN32
 #pragma warning(push)
 #pragma warning(disable: 4100)
@@ -23,7 +27,13 @@
 #endif
 
 class QuaZipFile;
+class QFile;
+
+namespace PLY {
+    struct ColumnArray;
+}
 
+class QImage;
 class QOpenGLTexture;
 class QOpenGLBuffer;
 class QOpenGLContext;
@@ -38,6 +48,22 @@ public:
     static const int ATTRIB_LOC_COLORS;
     static const int ATTRIB_LOC_TEXCOR;
 
+    // Layouts of the vertex buffer
+    enum VertexLayout {
+        LAYOUT_FULL,        // 32-bit floats for every attribute (52 bytes)
+        LAYOUT_COMPACT      // Quantized position, octahedral normal, RGBA8 and half-float UV (20 bytes)
+    };
+
+    // Geometry summary, gathered while the mesh is read
+    struct MeshStats {
+        float mMin[3], mMax[3];             // Bounding box
+        float mCentroid[3];                 // Mean vertex position
+        float mSphereCenter[3];             // Bounding sphere (around the bounding box center)
+        float mSphereRadius;
+        size_t mDegenerateFaces;            // Faces with a repeated vertex or no area
+        size_t mUnreferencedVertices;       // Vertices no face uses
+    };
+
     // Constructor/Destructor
     PLYMeshData();
     ~PLYMeshData();
@@ -51,6 +77,9 @@ public:
     size_t getVertexCount() const { return mVertexCount; }
     size_t getFaceCount() const { return mFaceCount; }
 
+    // Bounding box, bounding sphere and other geometry statistics
+    const MeshStats& getStats() const { return mStats; }
+
     // Unit size transformation
     const float* getCenter() const { return mVertexCenter; }
     float getUnitScale() const { return mVertexScale; }
@@ -66,16 +95,64 @@ public:
 
     // Get VBO/VAO objects
     QOpenGLBuffer* getVertexBuffer() { return mVertexBuffer; }
+    QOpenGLBuffer* getIndexBuffer() { return mIndexBuffer; }
     QOpenGLVertexArrayObject* getVAO() { return mVAO; }
 
+    // Index type for glDrawElements (GL_UNSIGNED_SHORT or GL_UNSIGNED_INT)
+    unsigned int getIndexType() const { return mIndexType; }
+
+    // Layout used by the next call to buildBuffers, and by the current buffers
+    VertexLayout getVertexLayout() const { return mVertexLayout; }
+    void setVertexLayout(VertexLayout pLayout) { mVertexLayout = pLayout; }
+    VertexLayout getBufferLayout() const { return mBufferLayout; }
+
+    // Transformation from the position attribute of the current buffers to model space (position*scale + offset)
+    void getPositionDecode(float pOffset[3], float pScale[3]) const;
+
+    // Build coarser levels of detail (finest first). This is slow, but only reads the
+    // mesh, so it can run on another thread as long as the mesh is not changed.
+    // Setting pCancel stops it early, returning no levels.
+    std::vector<MeshLOD> simplify(const std::atomic<bool>* pCancel = nullptr) const;
+
+    // Keep levels of detail from simplify; they are uploaded by the next call to
+    // buildBuffers or rebuildIndexBuffer
+    void setLODs(std::vector<MeshLOD> pLODs) { mLODs.swap(pLODs); }
+    int getLODCount() const { return (int)mLODs.size(); }
+    float getLODError(int pLOD) const { return mLODs[pLOD].mError; }
+
+    // Range of the index buffer to draw a level of detail (-1: the full mesh)
+    size_t getIndexCount(int pLOD = -1) const;
+    size_t getIndexOffset(int pLOD = -1) const;     // In bytes
+
+    // Read only the header of a PLY file to get the mesh counts
+    static bool probePLYFile(QFileInfo pProjectFile, QString pFilename,
+                             size_t& pVertexCount, size_t& pFaceCount);
+
+    // Estimate the memory used by the vertex and index buffers of a mesh (levels of detail included)
+    static size_t estimateBufferBytes(size_t pVertexCount, size_t pFaceCount);
+
+    // Keep a processed copy of the mesh next to the project, and reuse it while
+    // the PLY file is unchanged (off by default)
+    void setUseCache(bool pUseCache) { mUseCache = pUseCache; }
+
+    // Receive a coarse point preview of the mesh on the reading thread, once readPLYFile has read
+    // the vertices and before it processes the faces (not for a cached mesh). The handler owns it.
+    void setPreviewHandler(std::function<void(PLYMeshData*)> pHandler) { mPreviewHandler = pHandler; }
+
+    // A preview has points but no faces; its vertex buffer is drawn with GL_POINTS
+    bool isPointPreview() const { return mFaceCount == 0 && mPackedCount > 0; }
+    size_t getPackedCount() const { return mPackedCount; }
+
     // Read data from a PLY file
     bool readPLYFile(QFileInfo pProjectFile, QString pFilename = "model0.ply", QFileInfo pTextureFile = QFileInfo());
 
-    // Manage OpenGL Texture Construction
+    // Manage OpenGL Texture Construction (from the texture files, or from images read elsewhere)
     void buildTextures();
+    void buildTextures(const QImage pImages[4]);
 
     // Manage vertex buffer construction
     void buildBuffers(QOpenGLContext *pGLContext);
+    void rebuildIndexBuffer();
     void destroyBuffers();
     void releaseBuffers();
 
@@ -85,28 +162,53 @@ private:
 
     // PLY Parsing helper functions
     bool parsePLYFileStream(QString pFilename = "", QuaZipFile* pInsideFile = nullptr);
-    void processRawData();
+    void processRawData(PLY::ColumnArray& pVertices, PLY::ColumnArray& pFaces);
+    void computeBounds(const float* const pPos[3], size_t pCount);
+    static PLYMeshData* makePreview(PLY::ColumnArray& pVertices);
+
+    // Processed mesh cache helper functions
+    static QString cacheFileName(QFileInfo pProjectFile, QString pFilename);
+    bool readCache(QString pCacheFile, QString pKey, quint32 pCRC, qint64 pMTime, qint64 pSize);
+    bool writeCache(QString pCacheFile, QString pKey, quint32 pCRC, qint64 pMTime, qint64 pSize) const;
+
+    // Free the packed data, or unmap it from the cache
+    void releaseMeshData();
+
+    // Fill the bound index buffer with the full mesh and its levels of detail
+    bool uploadIndices();
 
     // Buffers for the vertex and face data
     QOpenGLBuffer *mVertexBuffer;
+    QOpenGLBuffer *mIndexBuffer;
     QOpenGLVertexArrayObject *mVAO;
 
     // Texture
     QFileInfo mTextureFile[4];
     QOpenGLTexture *mGLTexture[4];
 
-    // Packed data and metrics
+    // Packed data and metrics (welded vertices and three indices per face)
     void *mPackedData;
+    void *mIndexData;
+    size_t mPackedCount;
+    unsigned int mIndexType;
+    VertexLayout mVertexLayout, mBufferLayout;
+
+    // Levels of detail, drawn from the end of the index buffer
+    std::vector<MeshLOD> mLODs;
+
+    // Mapped cache holding the packed data (nullptr when it was allocated)
+    QFile *mCacheFile;
+    unsigned char *mCacheMap;
+    bool mUseCache;
 
-    // PLY Data Storage
-    std::vector<PLY::VertexNCT> mPLYVertCollection;
-    std::vector<PLY::FaceTex> mPLYFaceCollection;
+    // Receiver of the preview made while reading
+    std::function<void(PLYMeshData*)> mPreviewHandler;
 
     // Mesh element sizes
     size_t mVertexCount, mFaceCount;
 
     // Normalization data
-    float mVertexMax[3], mVertexMin[3];
+    MeshStats mStats;
     float mVertexBBox[3], mVertexCenter[3];
     float mVertexScale;
 
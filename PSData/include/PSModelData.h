@@ -28,6 +28,9 @@ public:
 	
     void addTextureFile(int pId, QString pFilepath);
 
+    // Read the mesh counts from the header of the PLY file
+    bool probeMeshCounts();
+
     QFileInfo getArchiveFile() const;
 
     long getFaceCount() const;
@@ -15,6 +15,7 @@ public:
     static QXmlStreamReader* explodeTag(QXmlStreamReader* reader, QStack<QFileInfo> &currentFileStack);
     static QFileInfo checkForAndUpdatePath(QXmlStreamReader* reader, QFileInfo currentFile);
     static QXmlStreamReader* getXMLStreamFromFile(QFileInfo pFile);
+    static void deleteXMLStream(QXmlStreamReader* reader);
 
     void readElementArray(QXmlStreamReader* reader, QString arrayName, QString elementName);
     virtual void processArrayElement(QXmlStreamReader* reader, QString elementName);
@@ -0,0 +1,392 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+#include "MeshSimplifier.h"
+
+// Marks a vertex with no queued collapse
+static const unsigned int NO_VERTEX = UINT_MAX;
+
+// Weight of the squared edge length in the cost of a collapse. It only decides between
+// collapses of (nearly) equal error, favoring short edges, so flat regions end up with
+// evenly sized triangles instead of a few vertices collecting huge fans.
+static const double EDGE_LENGTH_WEIGHT = 1e-3;
+
+// Smallest cosine of the angle a face may turn through in a collapse
+static const double MIN_FACE_TURN_COSINE = 0.25;
+
+// Most neighbors a vertex may end up with after a collapse
+static const size_t MAX_VALENCE = 16;
+
+// Collapses (or queued vertices) between checks of the cancel flag
+static const size_t CANCEL_CHECK_INTERVAL = 4096;
+
+MeshSimplifier::Quadric::Quadric() {
+    mA2 = mAB = mAC = mAD = mB2 = mBC = mBD = mC2 = mCD = mD2 = 0.0;
+    mArea = 0.0;
+}
+
+void MeshSimplifier::Quadric::addPlane(double pA, double pB, double pC, double pD, double pArea) {
+    mA2 += pArea*pA*pA; mAB += pArea*pA*pB; mAC += pArea*pA*pC; mAD += pArea*pA*pD;
+    mB2 += pArea*pB*pB; mBC += pArea*pB*pC; mBD += pArea*pB*pD;
+    mC2 += pArea*pC*pC; mCD += pArea*pC*pD;
+    mD2 += pArea*pD*pD;
+    mArea += pArea;
+}
+
+void MeshSimplifier::Quadric::add(const Quadric& pOther) {
+    mA2 += pOther.mA2; mAB += pOther.mAB; mAC += pOther.mAC; mAD += pOther.mAD;
+    mB2 += pOther.mB2; mBC += pOther.mBC; mBD += pOther.mBD;
+    mC2 += pOther.mC2; mCD += pOther.mCD;
+    mD2 += pOther.mD2;
+    mArea += pOther.mArea;
+}
+
+double MeshSimplifier::Quadric::evaluate(double pX, double pY, double pZ) const {
+    return mA2*pX*pX + 2.0*mAB*pX*pY + 2.0*mAC*pX*pZ + 2.0*mAD*pX
+         + mB2*pY*pY + 2.0*mBC*pY*pZ + 2.0*mBD*pY
+         + mC2*pZ*pZ + 2.0*mCD*pZ
+         + mD2;
+}
+
+// Un-normalized normal of the triangle (p0, p1, p2)
+static void triangleNormal(const float* p0, const float* p1, const float* p2, double pNormal[3]) {
+    double lE1[3], lE2[3];
+    for(int k=0; k<3; k++) {
+        lE1[k] = (double)p1[k] - p0[k];
+        lE2[k] = (double)p2[k] - p0[k];
+    }
+    pNormal[0] = lE1[1]*lE2[2] - lE1[2]*lE2[1];
+    pNormal[1] = lE1[2]*lE2[0] - lE1[0]*lE2[2];
+    pNormal[2] = lE1[0]*lE2[1] - lE1[1]*lE2[0];
+}
+
+MeshSimplifier::MeshSimplifier(const float* pPositions, size_t pStride, size_t pVertexCount,
+                               const unsigned int* pIndices, size_t pFaceCount) :
+    mPositions(pPositions), mStride(pStride), mVertexCount(pVertexCount), mFaceCount(pFaceCount),
+    mFaces(pIndices, pIndices + pFaceCount*3), mFaceAlive(pFaceCount, 1), mLiveFaces(0),
+    mMergedFaces(pVertexCount), mQuadrics(pVertexCount), mLocked(pVertexCount, 0), mAlive(pVertexCount, 1),
+    mStamp(pVertexCount, 0), mBestTarget(pVertexCount, NO_VERTEX), mBestCost(pVertexCount, 0.0f),
+    mLockedCount(0), mQueuedCount(0), mMaxError(0.0f) {
+
+    // Faces with a repeated or invalid vertex take no part
+    for(size_t f=0; f<mFaceCount; f++) {
+        const unsigned int* lIdx = &mFaces[f*3];
+        if(lIdx[0] >= mVertexCount || lIdx[1] >= mVertexCount || lIdx[2] >= mVertexCount ||
+           lIdx[0] == lIdx[1] || lIdx[1] == lIdx[2] || lIdx[0] == lIdx[2]) {
+            mFaceAlive[f] = 0;
+        } else {
+            mLiveFaces++;
+        }
+    }
+
+    buildAdjacency();
+    lockBorderVertices();
+    computeQuadrics();
+}
+
+bool MeshSimplifier::faceHas(unsigned int pFace, unsigned int pVertex) const {
+    const unsigned int* lIdx = &mFaces[pFace*3];
+    return (lIdx[0] == pVertex || lIdx[1] == pVertex || lIdx[2] == pVertex);
+}
+
+void MeshSimplifier::buildAdjacency() {
+    // Count the faces of each vertex, then fill the lists (CSR layout)
+    mAdjStart.assign(mVertexCount + 1, 0);
+    for(size_t f=0; f<mFaceCount; f++) {
+        if(!mFaceAlive[f]) { continue; }
+        for(int k=0; k<3; k++) {
+            mAdjStart[mFaces[f*3 + k] + 1]++;
+        }
+    }
+    for(size_t v=0; v<mVertexCount; v++) {
+        mAdjStart[v + 1] += mAdjStart[v];
+    }
+
+    mAdjFaces.resize(mAdjStart[mVertexCount]);
+    std::vector<unsigned int> lFill(mAdjStart.begin(), mAdjStart.end() - 1);
+    for(size_t f=0; f<mFaceCount; f++) {
+        if(!mFaceAlive[f]) { continue; }
+        for(int k=0; k<3; k++) {
+            mAdjFaces[lFill[mFaces[f*3 + k]]++] = (unsigned int)f;
+        }
+    }
+}
+
+void MeshSimplifier::lockBorderVertices() {
+    // An edge of a closed manifold surface has exactly two faces; a vertex
+    // with any other edge lies on a border (or seam) and cannot move
+    std::vector<unsigned int> lOthers;
+    for(size_t v=0; v<mVertexCount; v++) {
+        lOthers.clear();
+        for(unsigned int a=mAdjStart[v]; a<mAdjStart[v + 1]; a++) {
+            const unsigned int* lIdx = &mFaces[mAdjFaces[a]*3];
+            for(int k=0; k<3; k++) {
+                if(lIdx[k] != v) { lOthers.push_back(lIdx[k]); }
+            }
+        }
+        std::sort(lOthers.begin(), lOthers.end());
+
+        for(size_t i=0; i<lOthers.size(); ) {
+            size_t j = i;
+            while(j < lOthers.size() && lOthers[j] == lOthers[i]) { j++; }
+            if(j - i != 2) {
+                mLocked[v] = 1;
+                mLockedCount++;
+                break;
+            }
+            i = j;
+        }
+    }
+}
+
+void MeshSimplifier::computeQuadrics() {
+    // Each vertex starts with the planes of its faces, weighted by their areas
+    for(size_t f=0; f<mFaceCount; f++) {
+        if(!mFaceAlive[f]) { continue; }
+        const unsigned int* lIdx = &mFaces[f*3];
+        const float* p0 = position(lIdx[0]);
+        double lNormal[3];
+        triangleNormal(p0, position(lIdx[1]), position(lIdx[2]), lNormal);
+
+        double lLength = std::sqrt(lNormal[0]*lNormal[0] + lNormal[1]*lNormal[1] + lNormal[2]*lNormal[2]);
+        if(lLength <= 0.0) { continue; }
+        double a = lNormal[0]/lLength, b = lNormal[1]/lLength, c = lNormal[2]/lLength;
+        double d = -(a*p0[0] + b*p0[1] + c*p0[2]);
+        for(int k=0; k<3; k++) {
+            mQuadrics[lIdx[k]].addPlane(a, b, c, d, 0.5*lLength);
+        }
+    }
+}
+
+void MeshSimplifier::gatherFaces(unsigned int pVertex, std::vector<unsigned int>& pFaces) const {
+    pFaces.clear();
+    const std::vector<unsigned int>& lMerged = mMergedFaces[pVertex];
+    if(!lMerged.empty()) {
+        for(unsigned int f : lMerged) {
+            if(mFaceAlive[f]) { pFaces.push_back(f); }
+        }
+    } else {
+        for(unsigned int a=mAdjStart[pVertex]; a<mAdjStart[pVertex + 1]; a++) {
+            if(mFaceAlive[mAdjFaces[a]]) { pFaces.push_back(mAdjFaces[a]); }
+        }
+    }
+}
+
+void MeshSimplifier::gatherNeighbors(unsigned int pVertex, std::vector<unsigned int>& pNeighbors) const {
+    pNeighbors.clear();
+    const std::vector<unsigned int>& lMerged = mMergedFaces[pVertex];
+    const unsigned int* lBegin = lMerged.empty() ? mAdjFaces.data() + mAdjStart[pVertex] : lMerged.data();
+    const unsigned int* lEnd = lMerged.empty() ? mAdjFaces.data() + mAdjStart[pVertex + 1] : lMerged.data() + lMerged.size();
+    for(const unsigned int* f=lBegin; f!=lEnd; f++) {
+        if(!mFaceAlive[*f]) { continue; }
+        const unsigned int* lIdx = &mFaces[*f*3];
+        for(int k=0; k<3; k++) {
+            if(lIdx[k] != pVertex) { pNeighbors.push_back(lIdx[k]); }
+        }
+    }
+    std::sort(pNeighbors.begin(), pNeighbors.end());
+    pNeighbors.erase(std::unique(pNeighbors.begin(), pNeighbors.end()), pNeighbors.end());
+}
+
+bool MeshSimplifier::canCollapse(unsigned int pFrom, unsigned int pTo) {
+    if(!mAlive[pTo]) { return false; }
+
+    // The faces on the edge disappear
+    gatherFaces(pFrom, mScratchFaces);
+    size_t lShared = 0;
+    for(unsigned int f : mScratchFaces) {
+        if(faceHas(f, pTo)) { lShared++; }
+    }
+    if(lShared == 0) { return false; }
+
+    // Link condition: the vertices share no neighbors other than the
+    // ones across their common faces, or the surface would fold
+    gatherNeighbors(pFrom, mScratchLinkFrom);
+    gatherNeighbors(pTo, mScratchLinkTo);
+    size_t lCommon = 0;
+    for(size_t i=0, j=0; i<mScratchLinkFrom.size() && j<mScratchLinkTo.size(); ) {
+        if(mScratchLinkFrom[i] < mScratchLinkTo[j]) { i++; }
+        else if(mScratchLinkFrom[i] > mScratchLinkTo[j]) { j++; }
+        else { lCommon++; i++; j++; }
+    }
+    if(lCommon != lShared) { return false; }
+
+    // Keep the valence of pTo down, as long fans make slivers
+    size_t lValence = mScratchLinkFrom.size() + mScratchLinkTo.size() - lCommon - 2;
+    if(lValence > MAX_VALENCE) { return false; }
+
+    // The faces that keep pFrom must not flip over (or turn too far) once it moves to pTo
+    const float* lTo = position(pTo);
+    for(unsigned int f : mScratchFaces) {
+        if(faceHas(f, pTo)) { continue; }
+
+        const unsigned int* lIdx = &mFaces[f*3];
+        const float* lOld[3];
+        const float* lNew[3];
+        for(int k=0; k<3; k++) {
+            lOld[k] = position(lIdx[k]);
+            lNew[k] = (lIdx[k] == pFrom ? lTo : lOld[k]);
+        }
+
+        double lOldNormal[3], lNewNormal[3];
+        triangleNormal(lOld[0], lOld[1], lOld[2], lOldNormal);
+        triangleNormal(lNew[0], lNew[1], lNew[2], lNewNormal);
+        double lOldLength2 = lOldNormal[0]*lOldNormal[0] + lOldNormal[1]*lOldNormal[1] + lOldNormal[2]*lOldNormal[2];
+        double lNewLength2 = lNewNormal[0]*lNewNormal[0] + lNewNormal[1]*lNewNormal[1] + lNewNormal[2]*lNewNormal[2];
+        double lDot = lOldNormal[0]*lNewNormal[0] + lOldNormal[1]*lNewNormal[1] + lOldNormal[2]*lNewNormal[2];
+        if(lOldLength2 > 0.0 && (lDot <= 0.0 || lDot*lDot < MIN_FACE_TURN_COSINE*MIN_FACE_TURN_COSINE*lOldLength2*lNewLength2)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void MeshSimplifier::queueBestCollapse(unsigned int pVertex, bool pCheck) {
+    // Any collapse of this vertex still in the queue is now out of date
+    mStamp[pVertex]++;
+    if(mBestTarget[pVertex] != NO_VERTEX) {
+        mBestTarget[pVertex] = NO_VERTEX;
+        mQueuedCount--;
+    }
+    if(mLocked[pVertex] || !mAlive[pVertex]) { return; }
+
+    // Find the cheapest neighbor to move onto
+    gatherNeighbors(pVertex, mScratchCandidates);
+    const float* lFrom = position(pVertex);
+    unsigned int lBest = NO_VERTEX;
+    double lBestCost = 0.0;
+    for(unsigned int lTarget : mScratchCandidates) {
+        Quadric lSum = mQuadrics[pVertex];
+        lSum.add(mQuadrics[lTarget]);
+        const float* p = position(lTarget);
+        double lLength2 = 0.0;
+        for(int k=0; k<3; k++) {
+            lLength2 += ((double)p[k] - lFrom[k])*((double)p[k] - lFrom[k]);
+        }
+        double lCost = std::max(lSum.evaluate(p[0], p[1], p[2]), 0.0) + EDGE_LENGTH_WEIGHT*lSum.mArea*lLength2;
+        if((lBest == NO_VERTEX || lCost < lBestCost) && (!pCheck || canCollapse(pVertex, lTarget))) {
+            lBest = lTarget;
+            lBestCost = lCost;
+        }
+    }
+
+    if(lBest != NO_VERTEX) {
+        mBestTarget[pVertex] = lBest;
+        mBestCost[pVertex] = (float)lBestCost;
+        mQueuedCount++;
+        QueuedCollapse lEntry = { (float)lBestCost, pVertex, mStamp[pVertex] };
+        mQueue.push(lEntry);
+    }
+}
+
+void MeshSimplifier::collapse(unsigned int pFrom, unsigned int pTo) {
+    // Faces on the collapsed edge disappear, the other faces of pFrom move to pTo
+    gatherFaces(pFrom, mScratchFaces);
+    std::vector<unsigned int>& lMerged = mMergedFaces[pTo];
+    gatherFaces(pTo, mScratchUpdates);
+    lMerged.assign(mScratchUpdates.begin(), mScratchUpdates.end());
+    for(unsigned int f : mScratchFaces) {
+        if(faceHas(f, pTo)) {
+            mFaceAlive[f] = 0;
+            mLiveFaces--;
+        } else {
+            unsigned int* lIdx = &mFaces[f*3];
+            for(int k=0; k<3; k++) {
+                if(lIdx[k] == pFrom) { lIdx[k] = pTo; }
+            }
+            lMerged.push_back(f);
+        }
+    }
+    lMerged.erase(std::remove_if(lMerged.begin(), lMerged.end(),
+                                 [this](unsigned int f) { return !mFaceAlive[f]; }), lMerged.end());
+    std::vector<unsigned int>().swap(mMergedFaces[pFrom]);
+
+    // pTo now stands for the surface of both vertices; the error is the
+    // root mean square distance from its position to their planes
+    mQuadrics[pTo].add(mQuadrics[pFrom]);
+    const Quadric& lSum = mQuadrics[pTo];
+    if(lSum.mArea > 0.0) {
+        const float* p = position(pTo);
+        double lError = std::sqrt(std::max(lSum.evaluate(p[0], p[1], p[2]), 0.0) / lSum.mArea);
+        mMaxError = std::max(mMaxError, (float)lError);
+    }
+    mAlive[pFrom] = 0;
+    queueBestCollapse(pFrom, false);
+
+    // The costs around pTo have changed
+    queueBestCollapse(pTo, false);
+    gatherNeighbors(pTo, mScratchUpdates);
+    for(unsigned int lNeighbor : mScratchUpdates) {
+        queueBestCollapse(lNeighbor, false);
+    }
+}
+
+void MeshSimplifier::compactQueue() {
+    // Rebuild the queue from the current collapses once stale entries dominate it
+    if(mQueue.size() < 4*mQueuedCount + 1024) { return; }
+
+    std::vector<QueuedCollapse> lEntries;
+    lEntries.reserve(mQueuedCount);
+    for(size_t v=0; v<mVertexCount; v++) {
+        if(mBestTarget[v] != NO_VERTEX) {
+            QueuedCollapse lEntry = { mBestCost[v], (unsigned int)v, mStamp[v] };
+            lEntries.push_back(lEntry);
+        }
+    }
+    mQueue = std::priority_queue<QueuedCollapse, std::vector<QueuedCollapse>, std::greater<QueuedCollapse> >(
+                std::greater<QueuedCollapse>(), std::move(lEntries));
+}
+
+MeshLOD MeshSimplifier::currentLOD() const {
+    MeshLOD lLOD;
+    lLOD.mIndices.reserve(mLiveFaces*3);
+    for(size_t f=0; f<mFaceCount; f++) {
+        if(mFaceAlive[f]) {
+            lLOD.mIndices.insert(lLOD.mIndices.end(), &mFaces[f*3], &mFaces[f*3] + 3);
+        }
+    }
+    lLOD.mError = mMaxError;
+    return lLOD;
+}
+
+std::vector<MeshLOD> MeshSimplifier::buildLODs(std::vector<size_t> pTargets, const std::atomic<bool>* pCancel) {
+    // The flag is only read every so often, so checking it costs next to nothing
+    size_t lSteps = 0;
+    auto lCanceled = [pCancel, &lSteps]() {
+        return pCancel != nullptr && ++lSteps % CANCEL_CHECK_INTERVAL == 0 && pCancel->load(std::memory_order_relaxed);
+    };
+
+    // Queue the cheapest collapse of every vertex
+    for(size_t v=0; v<mVertexCount; v++) {
+        if(lCanceled()) { return std::vector<MeshLOD>(); }
+        queueBestCollapse((unsigned int)v, false);
+    }
+
+    // Collapse the cheapest edges, taking a snapshot as each target is reached
+    std::sort(pTargets.begin(), pTargets.end(), std::greater<size_t>());
+    std::vector<MeshLOD> lLODs;
+    for(size_t lTarget : pTargets) {
+        while(mLiveFaces > lTarget && !mQueue.empty()) {
+            if(lCanceled()) { return std::vector<MeshLOD>(); }
+            QueuedCollapse lTop = mQueue.top();
+            mQueue.pop();
+
+            unsigned int lFrom = lTop.mVertex;
+            if(!mAlive[lFrom] || mStamp[lFrom] != lTop.mStamp) { continue; }
+
+            // Collapses are only checked once they come up; when the cheapest one
+            // is invalid, the cheapest valid one goes back in the queue
+            unsigned int lTo = mBestTarget[lFrom];
+            if(!canCollapse(lFrom, lTo)) {
+                queueBestCollapse(lFrom, true);
+                continue;
+            }
+
+            collapse(lFrom, lTo);
+            compactQueue();
+        }
+        lLODs.push_back(currentLOD());
+    }
+    return lLODs;
+}
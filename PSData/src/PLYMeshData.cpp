@@ -1,9 +1,23 @@
+#include <algorithm>
 #include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <memory>
 
 #include "PLYMeshData.h"
 
 #include <quazip/quazipfile.h>
+#include <QFile>
+#include <QSaveFile>
 #include <QVector3D>
+#include <QtConcurrent>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PLY_MESH_SSE2
+#include <emmintrin.h>
+#endif
 #include <QOpenGLFunctions>
 
 // Defining the property names used by our PLY files
@@ -40,6 +54,9 @@ namespace PLY {
 #endif
 
 #include <io.h>
+#include <column.h>
+#include <probe.h>
+#include <readahead.h>
 
 #ifdef _WIN32
 #pragma warning(pop)
@@ -65,9 +82,172 @@ struct PackedVertex {
     float tu, tv, tn;
 };
 
+// Compact form of a PackedVertex (see PLYMeshData::LAYOUT_COMPACT)
+struct CompactVertex {
+    unsigned short x, y, z, pad;    // Position relative to the bounding box (unsigned normalized)
+    short nu, nv;                   // Octahedral normal (signed normalized)
+    unsigned char r, g, b, a;       // Color (unsigned normalized)
+    unsigned short tu, tv;          // Texture coordinates (half float)
+};
+
+#ifndef GL_HALF_FLOAT
+#define GL_HALF_FLOAT 0x140B
+#endif
+
+// Convert to a half float, rounding to nearest (tiny values become zero)
+static unsigned short toHalfFloat(float pValue) {
+    unsigned int lBits;
+    memcpy(&lBits, &pValue, sizeof(lBits));
+    unsigned short lSign = (unsigned short)((lBits >> 16) & 0x8000);
+    int lExp = (int)((lBits >> 23) & 0xFF) - 127 + 15;
+    unsigned int lMant = lBits & 0x7FFFFF;
+
+    if (((lBits >> 23) & 0xFF) == 0xFF) {
+        return lSign | (lMant ? 0x7E00 : 0x7C00);
+    } else if (lExp >= 31) {
+        return lSign | 0x7C00;
+    } else if (lExp <= 0) {
+        if (lExp < -10) { return lSign; }
+        lMant |= 0x800000;
+        int lShift = 14 - lExp;
+        return (unsigned short)(lSign | ((lMant >> lShift) + ((lMant >> (lShift - 1)) & 1)));
+    }
+    // A carry out of the mantissa correctly bumps the exponent
+    return (unsigned short)((lSign | (lExp << 10) | (lMant >> 13)) + ((lMant >> 12) & 1));
+}
+
+// Quantize a value in [0, 1] to an unsigned normalized integer
+static unsigned int toUnorm(float pValue, float pMax) {
+    pValue = std::min(std::max(pValue, 0.0f), 1.0f);
+    return (unsigned int)(pValue * pMax + 0.5f);
+}
+
+// Quantize a value in [-1, 1] to a 16-bit signed normalized integer
+static short toSnorm16(float pValue) {
+    pValue = std::min(std::max(pValue, -1.0f), 1.0f);
+    return (short)std::lround(pValue * 32767.0f);
+}
+
+// Pack a vertex into the compact layout
+static void compactVertex(const PackedVertex& pIn, const float pMin[3], const float pBBox[3], CompactVertex& pOut) {
+    // Positions span the bounding box in 16 bits
+    const float* lPos = &pIn.x;
+    unsigned short* lOut = &pOut.x;
+    for(int i=0; i<3; i++) {
+        lOut[i] = (pBBox[i] > 0.0f ? (unsigned short)toUnorm((lPos[i] - pMin[i])/pBBox[i], 65535.0f) : 0);
+    }
+    pOut.pad = 0;
+
+    // Project the normal onto the octahedron and unfold the lower half
+    float lSum = std::fabs(pIn.nx) + std::fabs(pIn.ny) + std::fabs(pIn.nz);
+    float lU = (lSum > 0.0f ? pIn.nx/lSum : 0.0f);
+    float lV = (lSum > 0.0f ? pIn.ny/lSum : 0.0f);
+    if (pIn.nz < 0.0f) {
+        float lFoldU = (1.0f - std::fabs(lV)) * (lU >= 0.0f ? 1.0f : -1.0f);
+        float lFoldV = (1.0f - std::fabs(lU)) * (lV >= 0.0f ? 1.0f : -1.0f);
+        lU = lFoldU;
+        lV = lFoldV;
+    }
+    pOut.nu = toSnorm16(lU);
+    pOut.nv = toSnorm16(lV);
+
+    pOut.r = (unsigned char)toUnorm(pIn.r, 255.0f);
+    pOut.g = (unsigned char)toUnorm(pIn.g, 255.0f);
+    pOut.b = (unsigned char)toUnorm(pIn.b, 255.0f);
+    pOut.a = (unsigned char)toUnorm(pIn.a, 255.0f);
+
+    pOut.tu = toHalfFloat(pIn.tu);
+    pOut.tv = toHalfFloat(pIn.tv);
+}
+
+// Face counts of the levels of detail built by simplify
+static const size_t LOD_FACE_TARGETS[] = { 1000000, 250000, 50000 };
+
+// The levels of detail worth building for a mesh: each one at least halves the face count
+static std::vector<size_t> lodTargets(size_t pFaceCount) {
+    std::vector<size_t> lTargets;
+    for(size_t lTarget : LOD_FACE_TARGETS) {
+        if(lTarget <= pFaceCount/2) {
+            lTargets.push_back(lTarget);
+        }
+    }
+    return lTargets;
+}
+
+// Cells along the longest side of the bounding box when subsampling a preview (one point per cell)
+static const int PREVIEW_GRID = 128;
+
+// A range of items processed by one QtConcurrent task, with its partial statistics
+struct Chunk {
+    size_t mFirst, mLast;       // The items [mFirst, mLast)
+    float mMin[3], mMax[3];     // Bounding box of the positions
+    double mSum[3];             // Sum of the positions
+    float mRadius2;             // Largest squared distance from the bounding box center
+    size_t mCount;              // Degenerate faces or unreferenced vertices
+};
+
+// Split the items [0, pCount) into chunks for QtConcurrent
+static std::vector<Chunk> makeChunks(size_t pCount, size_t pChunkSize = 65536) {
+    std::vector<Chunk> lChunks;
+    for(size_t lFirst=0; lFirst<pCount; lFirst+=pChunkSize) {
+        Chunk lChunk;
+        lChunk.mFirst = lFirst;
+        lChunk.mLast = std::min(pCount, lFirst + pChunkSize);
+        for(int i=0; i<3; i++) {
+            lChunk.mMin[i] = FLT_MAX;
+            lChunk.mMax[i] = -FLT_MAX;
+            lChunk.mSum[i] = 0.0;
+        }
+        lChunk.mRadius2 = 0.0f;
+        lChunk.mCount = 0;
+        lChunks.push_back(lChunk);
+    }
+    return lChunks;
+}
+
+// Find the min, max and sum of a range of coordinates (NaNs are left out of min and max)
+static void reduceCoordinates(const float* pValues, size_t pFirst, size_t pLast,
+                              float& pMin, float& pMax, double& pSum) {
+    size_t i = pFirst;
+#ifdef PLY_MESH_SSE2
+    // Four lanes at a time; the sums are kept in doubles
+    __m128 lMin = _mm_set1_ps(pMin), lMax = _mm_set1_ps(pMax);
+    __m128d lSumLo = _mm_setzero_pd(), lSumHi = _mm_setzero_pd();
+    for(; i + 4 <= pLast; i += 4) {
+        __m128 lV = _mm_loadu_ps(pValues + i);
+        lMin = _mm_min_ps(lV, lMin);
+        lMax = _mm_max_ps(lV, lMax);
+        lSumLo = _mm_add_pd(lSumLo, _mm_cvtps_pd(lV));
+        lSumHi = _mm_add_pd(lSumHi, _mm_cvtps_pd(_mm_movehl_ps(lV, lV)));
+    }
+
+    float lMins[4], lMaxs[4];
+    double lSums[4];
+    _mm_storeu_ps(lMins, lMin);
+    _mm_storeu_ps(lMaxs, lMax);
+    _mm_storeu_pd(lSums, lSumLo);
+    _mm_storeu_pd(lSums + 2, lSumHi);
+    for(int k=0; k<4; k++) {
+        if(lMins[k] < pMin) pMin = lMins[k];
+        if(lMaxs[k] > pMax) pMax = lMaxs[k];
+        pSum += lSums[k];
+    }
+#endif
+    for(; i<pLast; i++) {
+        if(pValues[i] < pMin) pMin = pValues[i];
+        if(pValues[i] > pMax) pMax = pValues[i];
+        pSum += pValues[i];
+    }
+}
+
 PLYMeshData::PLYMeshData() {
     mVertexBuffer = nullptr;
+    mIndexBuffer = nullptr;
     mPackedData = nullptr;
+    mIndexData = nullptr;
+    mCacheFile = nullptr;
+    mCacheMap = nullptr;
+    mUseCache = false;
     mVAO = nullptr;
     mGLTexture[0] = mGLTexture[1] = mGLTexture[2] = mGLTexture[3] = nullptr;
     initMembers();
@@ -75,8 +255,9 @@ PLYMeshData::PLYMeshData() {
 
 PLYMeshData::~PLYMeshData() {
     destroyBuffers();
-    free(mPackedData);
+    releaseMeshData();
     delete mVertexBuffer;
+    delete mIndexBuffer;
     for(int i=0; i<4; i++) {
         delete mGLTexture[i];
     }
@@ -86,32 +267,40 @@ PLYMeshData::~PLYMeshData() {
 void PLYMeshData::initMembers() {
     // Free any dynamic memory
     destroyBuffers();
-    free(mPackedData);
-    mPackedData = nullptr;
+    releaseMeshData();
 
     for(int i=0; i<4; i++) {
         delete mGLTexture[i];
         mGLTexture[i] = nullptr;
     }
 
-    mPLYVertCollection.clear();
-    mPLYFaceCollection.clear();
-
     // Allocate buffer structures
     if (mVertexBuffer == nullptr) {
         mVertexBuffer = new QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
     }
 
+    if (mIndexBuffer == nullptr) {
+        mIndexBuffer = new QOpenGLBuffer(QOpenGLBuffer::IndexBuffer);
+    }
+
     if (mVAO == nullptr) {
         mVAO = new QOpenGLVertexArrayObject();
     }
 
     // Set mesh properties and metrics back to initial values
-    mVertexCount = mFaceCount = 0;
+    mVertexCount = mFaceCount = mPackedCount = 0;
+    mIndexType = GL_UNSIGNED_INT;
+    mVertexLayout = mBufferLayout = LAYOUT_FULL;
+    mLODs.clear();
     mHasNormals = mHasColors = mHasMultiTex = mHasTexCoords = false;
 
-    mVertexMax[0] = mVertexMax[1] = mVertexMax[2] = -FLT_MAX;
-    mVertexMin[0] = mVertexMin[1] = mVertexMin[2] = FLT_MAX;
+    for(int i=0; i<3; i++) {
+        mStats.mMin[i] = FLT_MAX;
+        mStats.mMax[i] = -FLT_MAX;
+        mStats.mCentroid[i] = mStats.mSphereCenter[i] = 0.0f;
+    }
+    mStats.mSphereRadius = 0.0f;
+    mStats.mDegenerateFaces = mStats.mUnreferencedVertices = 0;
     mVertexBBox[0] = mVertexBBox[1] = mVertexBBox[2] = 0.0f;
     mVertexCenter[0] = mVertexCenter[1] = mVertexCenter[2] = 0.0f;
     mVertexScale = 1.0f;
@@ -126,6 +315,37 @@ void PLYMeshData::bindTextures(QOpenGLFunctions* GL) {
     }
 }
 
+bool PLYMeshData::probePLYFile(QFileInfo pProjectFile, QString pFilename,
+                               size_t& pVertexCount, size_t& pFaceCount) {
+    // Only the header is read, so this is cheap even for huge meshes
+    PLY::Probe lProbe;
+    if (pProjectFile.filePath() != "") {
+        QuaZipFile lInsideFile(pProjectFile.filePath(), pFilename);
+        if(!lInsideFile.open(QIODevice::ReadOnly) || !lProbe.open_io_device(&lInsideFile)) {
+            qWarning("Failed to probe '%s' in '%s'.", pFilename.toLocal8Bit().data(),
+                     pProjectFile.filePath().toLocal8Bit().data());
+            return false;
+        }
+    } else if (!lProbe.open_file(pFilename)) {
+        qWarning("Failed to probe '%s'.", pFilename.toLocal8Bit().data());
+        return false;
+    }
+
+    pVertexCount = lProbe.count(PLY::Vertex::name);
+    pFaceCount = lProbe.count(PLY::Face::name);
+    return true;
+}
+
+size_t PLYMeshData::estimateBufferBytes(size_t pVertexCount, size_t pFaceCount) {
+    // Texture seams add a few vertices on top of these
+    size_t lIndexBytes = (pVertexCount <= 65536 ? sizeof(unsigned short) : sizeof(unsigned int));
+    size_t lIndexCount = pFaceCount * 3;
+    for(size_t lTarget : lodTargets(pFaceCount)) {
+        lIndexCount += lTarget * 3;
+    }
+    return pVertexCount * sizeof(PackedVertex) + lIndexCount * lIndexBytes;
+}
+
 bool PLYMeshData::readPLYFile(QFileInfo pProjectFile, QString pFilename, QFileInfo pTextureFile) {
     // Extract the PLY file from the archive if there is one
     QuaZipFile* lInsideFile = nullptr;
@@ -140,10 +360,38 @@ bool PLYMeshData::readPLYFile(QFileInfo pProjectFile, QString pFilename, QFileIn
         }
     }
 
-    // Attempt to parse the PLY file
-    if (!parsePLYFileStream(pFilename, lInsideFile)) {
-        qWarning("Could not parse PLY file");
-        return false;
+    // The cache is keyed by the source path, its time and size, and the CRC of the archive entry
+    QString lCacheFile, lCacheKey;
+    quint32 lCRC = 0;
+    qint64 lMTime = 0, lSize = 0;
+    if (mUseCache) {
+        QFileInfo lSource = (lInsideFile != nullptr ? pProjectFile : QFileInfo(pFilename));
+        lCacheFile = cacheFileName(pProjectFile, pFilename);
+        lCacheKey = lSource.absoluteFilePath();
+        lMTime = lSource.lastModified().toMSecsSinceEpoch();
+        lSize = lSource.size();
+        if (lInsideFile != nullptr) {
+            QuaZipFileInfo lInfo;
+            lCacheKey += "/" + pFilename;
+            lCRC = (lInsideFile->getFileInfo(&lInfo) ? lInfo.crc : 0);
+        }
+    }
+
+    if (mUseCache && readCache(lCacheFile, lCacheKey, lCRC, lMTime, lSize)) {
+        // The processed mesh is mapped, so the PLY file is not needed
+        qInfo("Using the cached mesh '%s'", lCacheFile.toLocal8Bit().data());
+        delete lInsideFile;
+    } else {
+        // Attempt to parse the PLY file
+        if (!parsePLYFileStream(pFilename, lInsideFile)) {
+            qWarning("Could not parse PLY file");
+            return false;
+        }
+
+        // A cache that cannot be written only costs time on the next read
+        if (mUseCache && !writeCache(lCacheFile, lCacheKey, lCRC, lMTime, lSize)) {
+            qWarning("Could not write the mesh cache '%s'", lCacheFile.toLocal8Bit().data());
+        }
     }
 
     // Remember texture/archive file for later loading when OpenGL is active
@@ -156,113 +404,500 @@ bool PLYMeshData::readPLYFile(QFileInfo pProjectFile, QString pFilename, QFileIn
     return true;
 }
 
-void PLYMeshData::processRawData() {
+// Layout of a processed mesh cache: this header, the key (UTF-8), then the
+// packed vertices and the indices, each aligned to MESH_CACHE_ALIGN bytes.
+// The cache is only read on the machine that wrote it, so it is in native byte order.
+static const char MESH_CACHE_MAGIC[8] = { 'P', 'S', 'H', 'M', 'E', 'S', 'H', '\0' };
+static const quint32 MESH_CACHE_VERSION = 1;
+static const quint64 MESH_CACHE_ALIGN = 16;
+
+struct MeshCacheHeader {
+    char mMagic[8];                     // MESH_CACHE_MAGIC
+    quint32 mVersion;                   // MESH_CACHE_VERSION
+    quint32 mHeaderBytes;               // sizeof(MeshCacheHeader)
+    quint32 mVertexBytes;               // sizeof(PackedVertex)
+    quint32 mKeyBytes;                  // Size of the key following the header
+
+    // Source of the mesh
+    quint32 mCRC;                       // CRC of the archive entry (0 for a plain file)
+    quint32 mIndexType;                 // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    qint64 mMTime;                      // Modification time of the source, in ms since the epoch
+    qint64 mSize;                       // Size of the source
+
+    // Processed mesh
+    quint64 mVertexCount, mFaceCount, mPackedCount;
+    quint64 mPackedOffset, mIndexOffset, mFileBytes;
+    quint32 mHasNormals, mHasColors, mHasTexCoords, mHasMultiTex;
+    PLYMeshData::MeshStats mStats;
+    float mBBox[3], mCenter[3], mScale;
+};
+
+// Round up to the alignment of the cached arrays
+static quint64 alignCache(quint64 pOffset) {
+    return (pOffset + MESH_CACHE_ALIGN - 1) / MESH_CACHE_ALIGN * MESH_CACHE_ALIGN;
+}
+
+QString PLYMeshData::cacheFileName(QFileInfo pProjectFile, QString pFilename) {
+    // The cache sits next to the archive or PLY file it was made from
+    if (pProjectFile.filePath() != "") {
+        return pProjectFile.absoluteFilePath() + "." + QFileInfo(pFilename).completeBaseName() + ".meshcache";
+    }
+    return QFileInfo(pFilename).absoluteFilePath() + ".meshcache";
+}
+
+bool PLYMeshData::readCache(QString pCacheFile, QString pKey, quint32 pCRC, qint64 pMTime, qint64 pSize) {
+    QFile* lFile = new QFile(pCacheFile);
+    if (!lFile->open(QIODevice::ReadOnly) || lFile->size() < (qint64)sizeof(MeshCacheHeader)) {
+        delete lFile;
+        return false;
+    }
+
+    // Map the whole cache, so the packed data goes straight to the GPU
+    qint64 lFileBytes = lFile->size();
+    unsigned char* lMap = lFile->map(0, lFileBytes);
+    if (lMap == nullptr) {
+        delete lFile;
+        return false;
+    }
+
+    // Check that the cache is complete and made from this source
+    MeshCacheHeader lHeader;
+    memcpy(&lHeader, lMap, sizeof(lHeader));
+    QByteArray lKey = pKey.toUtf8();
+    size_t lIndexBytes = 0;
+    if (lHeader.mIndexType == GL_UNSIGNED_SHORT) {
+        lIndexBytes = sizeof(unsigned short);
+    } else if (lHeader.mIndexType == GL_UNSIGNED_INT) {
+        lIndexBytes = sizeof(unsigned int);
+    }
+
+    // The counts are bounded by the file size before they are multiplied, so the products cannot overflow,
+    // and the indices must fill the cache up to its end
+    bool lValid = lIndexBytes > 0 && memcmp(lHeader.mMagic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) == 0 &&
+            lHeader.mVersion == MESH_CACHE_VERSION && lHeader.mHeaderBytes == sizeof(MeshCacheHeader) &&
+            lHeader.mVertexBytes == sizeof(PackedVertex) && lHeader.mFileBytes == (quint64)lFileBytes &&
+            lHeader.mKeyBytes == (quint32)lKey.size() && lHeader.mCRC == pCRC &&
+            lHeader.mMTime == pMTime && lHeader.mSize == pSize &&
+            sizeof(MeshCacheHeader) + lHeader.mKeyBytes <= (quint64)lFileBytes &&
+            memcmp(lMap + sizeof(MeshCacheHeader), lKey.constData(), lKey.size()) == 0 &&
+            lHeader.mPackedCount <= (quint64)lFileBytes / sizeof(PackedVertex) &&
+            lHeader.mPackedOffset <= (quint64)lFileBytes - lHeader.mPackedCount * sizeof(PackedVertex) &&
+            lHeader.mFaceCount <= (quint64)lFileBytes / (3 * lIndexBytes) &&
+            lHeader.mIndexOffset <= (quint64)lFileBytes &&
+            (quint64)lFileBytes - lHeader.mIndexOffset == lHeader.mFaceCount * 3 * lIndexBytes;
+    if (!lValid) {
+        lFile->unmap(lMap);
+        delete lFile;
+        return false;
+    }
+
+    // Use the mapped arrays in place of allocated ones
+    releaseMeshData();
+    mCacheFile = lFile;
+    mCacheMap = lMap;
+    mPackedData = lMap + lHeader.mPackedOffset;
+    mIndexData = lMap + lHeader.mIndexOffset;
+
+    mVertexCount = lHeader.mVertexCount;
+    mFaceCount = lHeader.mFaceCount;
+    mPackedCount = lHeader.mPackedCount;
+    mIndexType = lHeader.mIndexType;
+    mHasNormals = (lHeader.mHasNormals != 0);
+    mHasColors = (lHeader.mHasColors != 0);
+    mHasTexCoords = (lHeader.mHasTexCoords != 0);
+    mHasMultiTex = (lHeader.mHasMultiTex != 0);
+    mStats = lHeader.mStats;
+    for(int i=0; i<3; i++) {
+        mVertexBBox[i] = lHeader.mBBox[i];
+        mVertexCenter[i] = lHeader.mCenter[i];
+    }
+    mVertexScale = lHeader.mScale;
+    return true;
+}
+
+bool PLYMeshData::writeCache(QString pCacheFile, QString pKey, quint32 pCRC, qint64 pMTime, qint64 pSize) const {
+    if (mPackedData == nullptr || mIndexData == nullptr) {
+        return false;
+    }
+
+    // Lay out the arrays after the header and key
+    MeshCacheHeader lHeader;
+    memset(&lHeader, 0, sizeof(lHeader));
+    QByteArray lKey = pKey.toUtf8();
+    size_t lIndexBytes = (mIndexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int));
+    memcpy(lHeader.mMagic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+    lHeader.mVersion = MESH_CACHE_VERSION;
+    lHeader.mHeaderBytes = sizeof(MeshCacheHeader);
+    lHeader.mVertexBytes = sizeof(PackedVertex);
+    lHeader.mKeyBytes = (quint32)lKey.size();
+    lHeader.mCRC = pCRC;
+    lHeader.mIndexType = mIndexType;
+    lHeader.mMTime = pMTime;
+    lHeader.mSize = pSize;
+    lHeader.mVertexCount = mVertexCount;
+    lHeader.mFaceCount = mFaceCount;
+    lHeader.mPackedCount = mPackedCount;
+    lHeader.mPackedOffset = alignCache(sizeof(MeshCacheHeader) + lKey.size());
+    lHeader.mIndexOffset = alignCache(lHeader.mPackedOffset + mPackedCount * sizeof(PackedVertex));
+    lHeader.mFileBytes = lHeader.mIndexOffset + mFaceCount * 3 * lIndexBytes;
+    lHeader.mHasNormals = mHasNormals;
+    lHeader.mHasColors = mHasColors;
+    lHeader.mHasTexCoords = mHasTexCoords;
+    lHeader.mHasMultiTex = mHasMultiTex;
+    lHeader.mStats = mStats;
+    for(int i=0; i<3; i++) {
+        lHeader.mBBox[i] = mVertexBBox[i];
+        lHeader.mCenter[i] = mVertexCenter[i];
+    }
+    lHeader.mScale = mVertexScale;
+
+    // Write a new file and only then replace the old one, so a reader never sees part of it
+    QSaveFile lFile(pCacheFile);
+    if (!lFile.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    const char lPadding[MESH_CACHE_ALIGN] = { 0 };
+    quint64 lKeyEnd = sizeof(MeshCacheHeader) + lKey.size();
+    quint64 lPackedEnd = lHeader.mPackedOffset + mPackedCount * sizeof(PackedVertex);
+    lFile.write((const char*)&lHeader, sizeof(lHeader));
+    lFile.write(lKey);
+    lFile.write(lPadding, (qint64)(lHeader.mPackedOffset - lKeyEnd));
+    lFile.write((const char*)mPackedData, (qint64)(mPackedCount * sizeof(PackedVertex)));
+    lFile.write(lPadding, (qint64)(lHeader.mIndexOffset - lPackedEnd));
+    lFile.write((const char*)mIndexData, (qint64)(mFaceCount * 3 * lIndexBytes));
+    return lFile.commit();
+}
+
+void PLYMeshData::releaseMeshData() {
+    if (mCacheFile != nullptr) {
+        mCacheFile->unmap(mCacheMap);
+        delete mCacheFile;
+        mCacheFile = nullptr;
+        mCacheMap = nullptr;
+    } else {
+        free(mPackedData);
+        free(mIndexData);
+    }
+    mPackedData = nullptr;
+    mIndexData = nullptr;
+}
+
+void PLYMeshData::processRawData(PLY::ColumnArray& pVertices, PLY::ColumnArray& pFaces) {
     // Setup mesh metrics
-    mVertexCount = mPLYVertCollection.size();
-    mFaceCount = mPLYFaceCollection.size();
+    mVertexCount = pVertices.size();
+    mFaceCount = pFaces.size();
 
     // Is there anything to process?
-    if (mVertexCount  == 0 || mFaceCount == 0) {
-        mPLYVertCollection.clear();
-        mPLYFaceCollection.clear();
+    const float* lX = pVertices.data<float>("x");
+    const float* lY = pVertices.data<float>("y");
+    const float* lZ = pVertices.data<float>("z");
+    const PLY::Column* lIndices = pFaces.find(PLY::Face::prop_ind.name.c_str());
+    if (mVertexCount  == 0 || mFaceCount == 0 || !lX || !lY || !lZ ||
+        !lIndices || !lIndices->data<unsigned int>()) {
+        mVertexCount = mFaceCount = 0;
         return;
     }
 
-    // Build the min/max bounding box
-    for(PLY::VertexNCT& lVC : mPLYVertCollection) {
-        if(lVC.value_x.val < mVertexMin[0]) mVertexMin[0] = lVC.value_x.val;
-        if(lVC.value_y.val < mVertexMin[1]) mVertexMin[1] = lVC.value_y.val;
-        if(lVC.value_z.val < mVertexMin[2]) mVertexMin[2] = lVC.value_z.val;
+    // Optional vertex colors and face texture coordinates
+    const float* lColors[4] = {
+        pVertices.data<float>("red"), pVertices.data<float>("green"),
+        pVertices.data<float>("blue"), pVertices.data<float>("alpha")
+    };
+    const PLY::Column* lTexCoords = pFaces.find(PLY::FaceTex::prop_tex.name.c_str());
+    if (lTexCoords && !lTexCoords->data<float>()) { lTexCoords = nullptr; }
+
+    // Compute the bounding box, center, and scale
+    const float* lPos[3] = { lX, lY, lZ };
+    computeBounds(lPos, mVertexCount);
+    std::vector<Chunk> lVertexChunks = makeChunks(mVertexCount);
+
+    // Faces with fewer than three indices are left out and counted as degenerate. Face f
+    // is row lRows[f] of the face element, or row f when no face is left out, so every
+    // later pass can read three indices (and check the texcoords of the same row).
+    std::vector<unsigned int> lRows;
+    size_t lShortFaces = 0, lShortTexCoords = 0;
+    for(size_t r=0; r<mFaceCount; r++) {
+        if (lIndices->size(r) < 3) {
+            if (lShortFaces == 0) {
+                lRows.reserve(mFaceCount);
+                for(size_t k=0; k<r; k++) { lRows.push_back((unsigned int)k); }
+            }
+            lShortFaces++;
+            continue;
+        }
+        if (lShortFaces > 0) { lRows.push_back((unsigned int)r); }
+        if (lTexCoords && lTexCoords->size(r) < 6) { lShortTexCoords++; }
+    }
+    if (lShortFaces > 0) {
+        qWarning("Leaving out %zu faces with fewer than three vertices", lShortFaces);
+        mFaceCount = lRows.size();
+        mStats.mDegenerateFaces += lShortFaces;
+        if (mFaceCount == 0) {
+            mVertexCount = 0;
+            return;
+        }
+    }
+    if (lShortTexCoords > 0) {
+        qWarning("%zu faces have incomplete texture coordinates and are drawn without them", lShortTexCoords);
+    }
+    auto lRow = [&lRows](size_t pFace) { return lRows.empty() ? pFace : (size_t)lRows[pFace]; };
 
-        if(lVC.value_x.val > mVertexMax[0]) mVertexMax[0] = lVC.value_x.val;
-        if(lVC.value_y.val > mVertexMax[1]) mVertexMax[1] = lVC.value_y.val;
-        if(lVC.value_z.val > mVertexMax[2]) mVertexMax[2] = lVC.value_z.val;
+    // Vertex to face adjacency in compressed sparse row form: the faces around
+    // vertex v are lAdjFaces[lAdjStart[v]] up to lAdjFaces[lAdjStart[v+1]]
+    std::vector<unsigned int> lAdjStart(mVertexCount + 1, 0);
+    for(size_t f=0; f<mFaceCount; f++) {
+        const unsigned int* lF = lIndices->items<unsigned int>(lRow(f));
+        for(int i=0; i<3; i++) {
+            if (lF[i] >= mVertexCount) {
+                qWarning("Face %zu refers to missing vertex %u", lRow(f), lF[i]);
+                mVertexCount = mFaceCount = 0;
+                return;
+            }
+            lAdjStart[lF[i] + 1]++;
+        }
+    }
+    for(size_t v=0; v<mVertexCount; v++) {
+        lAdjStart[v + 1] += lAdjStart[v];
     }
 
-    // Compute the bounding box, center, and scale
-    for(unsigned char i = 0; i<3; i++) {
-        mVertexBBox[i] = mVertexMax[i] - mVertexMin[i];
-        mVertexCenter[i] = (mVertexMax[i] + mVertexMin[i])/2.0f;
+    // Faces are filled in in order, so each vertex sums its faces in order
+    std::vector<unsigned int> lAdjFaces(mFaceCount * 3);
+    std::vector<unsigned int> lAdjFill(lAdjStart.begin(), lAdjStart.end() - 1);
+    for(size_t f=0; f<mFaceCount; f++) {
+        const unsigned int* lF = lIndices->items<unsigned int>(lRow(f));
+        for(int i=0; i<3; i++) {
+            lAdjFaces[lAdjFill[lF[i]]++] = (unsigned int)f;
+        }
     }
+    std::vector<unsigned int>().swap(lAdjFill);
+
+    // Compute flat face normals (their length is twice the face area)
+    // and count the faces without an area
+    std::vector<QVector3D> lFaceNorms(mFaceCount);
+    std::vector<Chunk> lFaceChunks = makeChunks(mFaceCount);
+    QtConcurrent::blockingMap(lFaceChunks, [&](Chunk& pChunk) {
+        for(size_t i=pChunk.mFirst; i<pChunk.mLast; i++) {
+            const unsigned int* lF = lIndices->items<unsigned int>(lRow(i));
+            unsigned int A = lF[0];
+            unsigned int B = lF[1];
+            unsigned int C = lF[2];
+
+            QVector3D Av(lX[A], lY[A], lZ[A]);
+            QVector3D Bv(lX[B], lY[B], lZ[B]);
+            QVector3D Cv(lX[C], lY[C], lZ[C]);
+            lFaceNorms[i] = QVector3D::crossProduct(Bv-Av, Cv-Av);
+            if (A == B || B == C || C == A || lFaceNorms[i].lengthSquared() == 0.0f) {
+                pChunk.mCount++;
+            }
+        }
+    });
+
+    // Create smooth, area weighted per-vertex normals, while finding
+    // the bounding sphere and the vertices no face uses
+    std::vector<QVector3D> lVertNorms(mVertexCount);
+    QVector3D lSphereCenter(mVertexCenter[0], mVertexCenter[1], mVertexCenter[2]);
+    QtConcurrent::blockingMap(lVertexChunks, [&](Chunk& pChunk) {
+        for(size_t i=pChunk.mFirst; i<pChunk.mLast; i++) {
+            // Sum of adjacent face cross products
+            QVector3D lSum(0, 0, 0);
+            for(unsigned int a=lAdjStart[i]; a<lAdjStart[i + 1]; a++) {
+                lSum += lFaceNorms[lAdjFaces[a]];
+            }
 
-    mVertexScale = 2.0/std::max(mVertexBBox[0], std::max(mVertexBBox[1], mVertexBBox[2]));
+            // Normalize and assign to this vertex
+            lSum.normalize();
+            lVertNorms[i] = lSum;
 
-    // Vertex and face computed info
-    std::vector<unsigned int>* lFaceLookup = new std::vector<unsigned int>[mPLYVertCollection.size()];
-    std::vector<QVector3D> lFaceNorms;
-    lFaceNorms.reserve(mPLYFaceCollection.size());
-
-    // Prepare to compute smoothed normals
-    unsigned int i = 0;
-    for(PLY::FaceTex& lF : mPLYFaceCollection) {
-        // Extract the face indices
-        unsigned int A = (unsigned int)lF.vertex(0);
-        unsigned int B = (unsigned int)lF.vertex(1);
-        unsigned int C = (unsigned int)lF.vertex(2);
-
-        // Update vertex reverse lookup table
-        lFaceLookup[A].push_back(i);
-        lFaceLookup[B].push_back(i);
-        lFaceLookup[C].push_back(i);
-        i++;
-
-        // Compute a flat face normal
-        QVector3D Av(mPLYVertCollection[A].value_x.val, mPLYVertCollection[A].value_y.val, mPLYVertCollection[A].value_z.val);
-        QVector3D Bv(mPLYVertCollection[B].value_x.val, mPLYVertCollection[B].value_y.val, mPLYVertCollection[B].value_z.val);
-        QVector3D Cv(mPLYVertCollection[C].value_x.val, mPLYVertCollection[C].value_y.val, mPLYVertCollection[C].value_z.val);
-        lFaceNorms.push_back(QVector3D::crossProduct(Bv-Av, Cv-Av));
-    }
-
-    // Create smooth, per-vertex normals
-    for(size_t i=0; i<mPLYVertCollection.size(); i++) {
-        // Sum of adjacent face cross products
-        QVector3D lSum(0, 0, 0);
-        for(auto lFIndex : lFaceLookup[i]) {
-            lSum += lFaceNorms[lFIndex];
-        }
-
-        // Normalize and assign to this vertex
-        lSum.normalize();
-        mPLYVertCollection[i].value_nx.val = lSum.x();
-        mPLYVertCollection[i].value_ny.val = lSum.y();
-        mPLYVertCollection[i].value_nz.val = lSum.z();
-    }
-
-    // Clean up dynamic memory
-    delete [] lFaceLookup;
-
-    // Allocate space for a direct-indexed vertex buffer
-    if (mPackedData != nullptr) { free(mPackedData); }
-    mPackedData = malloc(mFaceCount * 3 * sizeof(PackedVertex));
-
-    // Create a final direct-indexed list of triangles
-    PackedVertex* lCur = static_cast<PackedVertex*>(mPackedData);
-    for(PLY::FaceTex& lF : mPLYFaceCollection) {
+            if (lAdjStart[i] == lAdjStart[i + 1]) {
+                pChunk.mCount++;
+            }
+            float lDist2 = (QVector3D(lX[i], lY[i], lZ[i]) - lSphereCenter).lengthSquared();
+            if (lDist2 > pChunk.mRadius2) {
+                pChunk.mRadius2 = lDist2;
+            }
+        }
+    });
+
+    // Gather the statistics of the chunks
+    for(const Chunk& lChunk : lFaceChunks) {
+        mStats.mDegenerateFaces += lChunk.mCount;
+    }
+    float lRadius2 = 0.0f;
+    for(const Chunk& lChunk : lVertexChunks) {
+        mStats.mUnreferencedVertices += lChunk.mCount;
+        lRadius2 = std::max(lRadius2, lChunk.mRadius2);
+    }
+    mStats.mSphereRadius = std::sqrt(lRadius2);
+
+    // Clean up the adjacency before welding
+    std::vector<unsigned int>().swap(lAdjStart);
+    std::vector<unsigned int>().swap(lAdjFaces);
+    std::vector<QVector3D>().swap(lFaceNorms);
+
+    // Weld the face corners into shared vertices. Position, normal and color
+    // come from the PLY vertex, so the corners of one vertex only differ in
+    // their texture coordinates: each PLY vertex keeps a chain of the packed
+    // vertices made from it, one for each distinct (tu, tv).
+    const unsigned int lNone = UINT_MAX;
+    std::vector<unsigned int> lFirst(mVertexCount, lNone);
+    std::vector<unsigned int> lNext;
+    std::vector<PackedVertex> lPacked;
+    lNext.reserve(mVertexCount);
+    lPacked.reserve(mVertexCount);
+
+    releaseMeshData();
+    mIndexData = malloc(mFaceCount * 3 * sizeof(unsigned int));
+    unsigned int* lIndexList = static_cast<unsigned int*>(mIndexData);
+    for(size_t f=0; f<mFaceCount; f++) {
+        size_t lR = lRow(f);
+        const unsigned int* lF = lIndices->items<unsigned int>(lR);
+        // A face without a full (tu, tv) pair for each corner gets no texture coordinates
+        const float* lTex = (lTexCoords && lTexCoords->size(lR) >= 6 ? lTexCoords->items<float>(lR) : nullptr);
         for(int i=0; i<3; i++) {
-            // Get current vertex index
-            unsigned int idx = (unsigned int)lF.vertex(i);
+            // Get current vertex index and texture coordinates
+            unsigned int idx = lF[i];
+            float lTU = (lTex ? lTex[i*2 + 0] : 0.0f);
+            float lTV = (lTex ? lTex[i*2 + 1] : 0.0f);
+
+            // Look for a packed vertex of this vertex with the same coordinates
+            unsigned int lWeld = lFirst[idx];
+            while (lWeld != lNone && (lPacked[lWeld].tu != lTU || lPacked[lWeld].tv != lTV)) {
+                lWeld = lNext[lWeld];
+            }
 
-            // Copy the raw vertex information
-            lCur[i].x = mPLYVertCollection[idx].value_x.val;
-            lCur[i].y = mPLYVertCollection[idx].value_y.val;
-            lCur[i].z = mPLYVertCollection[idx].value_z.val;
-            lCur[i].nx = mPLYVertCollection[idx].value_nx.val;
-            lCur[i].ny = mPLYVertCollection[idx].value_ny.val;
-            lCur[i].nz = mPLYVertCollection[idx].value_nz.val;
-            lCur[i].r = mPLYVertCollection[idx].value_r.val/255.0;
-            lCur[i].g = mPLYVertCollection[idx].value_g.val/255.0;
-            lCur[i].b = mPLYVertCollection[idx].value_b.val/255.0;
-            lCur[i].a = mPLYVertCollection[idx].value_a.val/255.0;
+            if (lWeld == lNone) {
+                // Copy the raw vertex information
+                PackedVertex lVert;
+                lVert.x = lX[idx];
+                lVert.y = lY[idx];
+                lVert.z = lZ[idx];
+                lVert.nx = lVertNorms[idx].x();
+                lVert.ny = lVertNorms[idx].y();
+                lVert.nz = lVertNorms[idx].z();
+                lVert.r = (lColors[0] ? lColors[0][idx] : 1.0f)/255.0;
+                lVert.g = (lColors[1] ? lColors[1][idx] : 1.0f)/255.0;
+                lVert.b = (lColors[2] ? lColors[2][idx] : 1.0f)/255.0;
+                lVert.a = (lColors[3] ? lColors[3][idx] : 1.0f)/255.0;
+
+                // Assign proper texture coordinates
+                lVert.tu = lTU;
+                lVert.tv = lTV;
+                lVert.tn = 0.0f;
+
+                lWeld = (unsigned int)lPacked.size();
+                lPacked.push_back(lVert);
+                lNext.push_back(lFirst[idx]);
+                lFirst[idx] = lWeld;
+            }
+            lIndexList[f*3 + i] = lWeld;
+        }
+    }
+
+    // Copy the welded vertices into a compact vertex buffer
+    mPackedCount = lPacked.size();
+    mPackedData = malloc(mPackedCount * sizeof(PackedVertex));
+    memcpy(mPackedData, lPacked.data(), mPackedCount * sizeof(PackedVertex));
+
+    // Small meshes get 16-bit indices, narrowed in place (each one moves to a lower address)
+    if (mPackedCount <= 65536) {
+        unsigned short* lShortList = static_cast<unsigned short*>(mIndexData);
+        for(size_t i=0; i<mFaceCount*3; i++) {
+            lShortList[i] = (unsigned short)lIndexList[i];
+        }
+        mIndexData = realloc(mIndexData, mFaceCount * 3 * sizeof(unsigned short));
+        mIndexType = GL_UNSIGNED_SHORT;
+    } else {
+        mIndexType = GL_UNSIGNED_INT;
+    }
+}
 
-            // Assign proper texture coordinates
-            lCur[i].tu = lF.texcoord(i*2 + 0);
-            lCur[i].tv = lF.texcoord(i*2 + 1);
-            lCur[i].tn = 0.0f;
+void PLYMeshData::computeBounds(const float* const pPos[3], size_t pCount) {
+    // Build the min/max bounding box and the centroid, chunk by chunk
+    std::vector<Chunk> lChunks = makeChunks(pCount);
+    QtConcurrent::blockingMap(lChunks, [&](Chunk& pChunk) {
+        for(int c=0; c<3; c++) {
+            reduceCoordinates(pPos[c], pChunk.mFirst, pChunk.mLast, pChunk.mMin[c], pChunk.mMax[c], pChunk.mSum[c]);
+        }
+    });
+
+    double lSum[3] = { 0.0, 0.0, 0.0 };
+    for(const Chunk& lChunk : lChunks) {
+        for(int c=0; c<3; c++) {
+            if(lChunk.mMin[c] < mStats.mMin[c]) mStats.mMin[c] = lChunk.mMin[c];
+            if(lChunk.mMax[c] > mStats.mMax[c]) mStats.mMax[c] = lChunk.mMax[c];
+            lSum[c] += lChunk.mSum[c];
         }
+    }
 
-        // Move forward three vertices (one triangle)
-        lCur += 3;
+    for(unsigned char i = 0; i<3; i++) {
+        mVertexBBox[i] = mStats.mMax[i] - mStats.mMin[i];
+        mVertexCenter[i] = (mStats.mMax[i] + mStats.mMin[i])/2.0f;
+        mStats.mCentroid[i] = (float)(lSum[i]/pCount);
+        mStats.mSphereCenter[i] = mVertexCenter[i];
     }
+
+    mVertexScale = 2.0/std::max(mVertexBBox[0], std::max(mVertexBBox[1], mVertexBBox[2]));
+}
+
+PLYMeshData* PLYMeshData::makePreview(PLY::ColumnArray& pVertices) {
+    size_t lCount = pVertices.size();
+    const float* lPos[3] = { pVertices.data<float>("x"), pVertices.data<float>("y"), pVertices.data<float>("z") };
+    if (lCount == 0 || !lPos[0] || !lPos[1] || !lPos[2]) {
+        return nullptr;
+    }
+    const float* lColors[4] = {
+        pVertices.data<float>("red"), pVertices.data<float>("green"),
+        pVertices.data<float>("blue"), pVertices.data<float>("alpha")
+    };
+
+    // The bounds of every vertex frame the preview just like the full mesh
+    PLYMeshData* lPreview = new PLYMeshData();
+    lPreview->computeBounds(lPos, lCount);
+
+    // Keep the first vertex in each cell of a grid of cubes over the bounding box
+    const float* lMin = lPreview->mStats.mMin;
+    const float* lBBox = lPreview->mVertexBBox;
+    float lCellSize = std::max(lBBox[0], std::max(lBBox[1], lBBox[2]))/PREVIEW_GRID;
+    if (!(lCellSize > 0.0f)) { lCellSize = 1.0f; }
+    size_t lCells[3];
+    for(int c=0; c<3; c++) {
+        lCells[c] = (size_t)std::min(std::max(0.0f, lBBox[c]/lCellSize), (float)PREVIEW_GRID - 1.0f) + 1;
+    }
+
+    std::vector<char> lTaken(lCells[0]*lCells[1]*lCells[2], 0);
+    std::vector<PackedVertex> lPoints;
+    for(size_t v=0; v<lCount; v++) {
+        size_t lCell = 0;
+        bool lInside = true;
+        for(int c=0; c<3; c++) {
+            float lT = (lPos[c][v] - lMin[c])/lCellSize;
+            if (!(lT >= 0.0f)) { lInside = false; break; }     // NaNs are left out
+            lCell = lCell*lCells[c] + (size_t)std::min(lT, (float)(lCells[c] - 1));
+        }
+        if (!lInside || lTaken[lCell]) {
+            continue;
+        }
+        lTaken[lCell] = 1;
+
+        PackedVertex lVert;
+        lVert.x = lPos[0][v];
+        lVert.y = lPos[1][v];
+        lVert.z = lPos[2][v];
+        lVert.nx = lVert.ny = lVert.nz = 0.0f;
+        lVert.r = (lColors[0] ? lColors[0][v] : 1.0f)/255.0;
+        lVert.g = (lColors[1] ? lColors[1][v] : 1.0f)/255.0;
+        lVert.b = (lColors[2] ? lColors[2][v] : 1.0f)/255.0;
+        lVert.a = (lColors[3] ? lColors[3][v] : 1.0f)/255.0;
+        lVert.tu = lVert.tv = lVert.tn = 0.0f;
+        lPoints.push_back(lVert);
+    }
+
+    // Points only: no faces, normals or texture coordinates
+    lPreview->mVertexCount = lPreview->mPackedCount = lPoints.size();
+    lPreview->mPackedData = malloc(lPoints.size() * sizeof(PackedVertex));
+    memcpy(lPreview->mPackedData, lPoints.data(), lPoints.size() * sizeof(PackedVertex));
+    lPreview->mHasColors = (lColors[0] && lColors[1] && lColors[2]);
+    return lPreview;
 }
 
 void PLYMeshData::buildBuffers(QOpenGLContext* pGLContext) {
@@ -285,18 +920,53 @@ void PLYMeshData::buildBuffers(QOpenGLContext* pGLContext) {
     QOpenGLVertexArrayObject::Binder vaoBinder(mVAO);
 
     // This will only work if we have a current opengl context
-    mVertexBuffer = new QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
     if(!mVertexBuffer->create()) {
         qWarning("Could not create vertex buffer");
         return;
     }
     mVertexBuffer->bind();
 
-    // Copy data to video memory
-    mVertexBuffer->allocate(mPackedData, (int)(mFaceCount*3*sizeof(PackedVertex)));
+    // Copy data to video memory (packing it first for the compact layout)
+    mBufferLayout = mVertexLayout;
+    if(mBufferLayout == LAYOUT_COMPACT) {
+        std::vector<CompactVertex> lCompact(mPackedCount);
+        const PackedVertex* lFull = static_cast<const PackedVertex*>(mPackedData);
+        for(size_t i=0; i<mPackedCount; i++) {
+            compactVertex(lFull[i], mStats.mMin, mVertexBBox, lCompact[i]);
+        }
+        mVertexBuffer->allocate(lCompact.data(), (int)(mPackedCount*sizeof(CompactVertex)));
+    } else {
+        mVertexBuffer->allocate(mPackedData, (int)(mPackedCount*sizeof(PackedVertex)));
+    }
+
+    // The index buffer binding is part of the VAO state
+    if(!uploadIndices()) {
+        return;
+    }
 
     // Setup VAO data layout
     mVertexBuffer->bind();
+    if(mBufferLayout == LAYOUT_COMPACT) {
+        // Integer attributes are normalized; the shader decodes position and normal
+        GLsizei lStride = sizeof(CompactVertex);
+        GL->glEnableVertexAttribArray(ATTRIB_LOC_VERTEX);
+        GL->glVertexAttribPointer(ATTRIB_LOC_VERTEX, 3, GL_UNSIGNED_SHORT, GL_TRUE, lStride, (void*)offsetof(CompactVertex, x));
+        if(mHasNormals) {
+            GL->glEnableVertexAttribArray(ATTRIB_LOC_NORMAL);
+            GL->glVertexAttribPointer(ATTRIB_LOC_NORMAL, 2, GL_SHORT, GL_TRUE, lStride, (void*)offsetof(CompactVertex, nu));
+        }
+        if(mHasColors) {
+            GL->glEnableVertexAttribArray(ATTRIB_LOC_COLORS);
+            GL->glVertexAttribPointer(ATTRIB_LOC_COLORS, 4, GL_UNSIGNED_BYTE, GL_TRUE, lStride, (void*)offsetof(CompactVertex, r));
+        }
+        if(mHasTexCoords) {
+            GL->glEnableVertexAttribArray(ATTRIB_LOC_TEXCOR);
+            GL->glVertexAttribPointer(ATTRIB_LOC_TEXCOR, 2, GL_HALF_FLOAT, GL_FALSE, lStride, (void*)offsetof(CompactVertex, tu));
+        }
+        mVertexBuffer->release();
+        return;
+    }
+
     GL->glEnableVertexAttribArray(ATTRIB_LOC_VERTEX);
     GL->glVertexAttribPointer(ATTRIB_LOC_VERTEX, 3, GL_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)0);
     size_t lOffset4Byte = 3;
@@ -318,6 +988,104 @@ void PLYMeshData::buildBuffers(QOpenGLContext* pGLContext) {
     mVertexBuffer->release();
 }
 
+void PLYMeshData::rebuildIndexBuffer() {
+    if (!mVAO->isCreated()) {
+        return;
+    }
+    QOpenGLVertexArrayObject::Binder vaoBinder(mVAO);
+    uploadIndices();
+}
+
+bool PLYMeshData::uploadIndices() {
+    if(!mIndexBuffer->create()) {
+        qWarning("Could not create index buffer");
+        return false;
+    }
+    mIndexBuffer->bind();
+    size_t lIndexBytes = (mIndexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int));
+
+    // Room for the full mesh and every level of detail (the offset of one past the last level)
+    mIndexBuffer->allocate((int)(getIndexOffset((int)mLODs.size())));
+    mIndexBuffer->write(0, mIndexData, (int)(mFaceCount*3*lIndexBytes));
+
+    // The levels of detail follow the full mesh, in the same index type
+    for(int l=0; l<(int)mLODs.size(); l++) {
+        const std::vector<unsigned int>& lIndices = mLODs[l].mIndices;
+        if(mIndexType == GL_UNSIGNED_SHORT) {
+            std::vector<unsigned short> lShortList(lIndices.begin(), lIndices.end());
+            mIndexBuffer->write((int)getIndexOffset(l), lShortList.data(), (int)(lShortList.size()*lIndexBytes));
+        } else {
+            mIndexBuffer->write((int)getIndexOffset(l), lIndices.data(), (int)(lIndices.size()*lIndexBytes));
+        }
+    }
+
+    return true;
+}
+
+void PLYMeshData::getPositionDecode(float pOffset[3], float pScale[3]) const {
+    // Compact positions are normalized over the bounding box
+    bool lCompact = (mBufferLayout == LAYOUT_COMPACT);
+    for(int i=0; i<3; i++) {
+        pOffset[i] = (lCompact ? mStats.mMin[i] : 0.0f);
+        pScale[i] = (lCompact ? mVertexBBox[i] : 1.0f);
+    }
+}
+
+std::vector<MeshLOD> PLYMeshData::simplify(const std::atomic<bool>* pCancel) const {
+    std::vector<size_t> lTargets = lodTargets(mFaceCount);
+    if(lTargets.empty() || mPackedData == nullptr) {
+        return std::vector<MeshLOD>();
+    }
+
+    // The simplifier works on 32-bit indices
+    std::vector<unsigned int> lIndices(mFaceCount*3);
+    if(mIndexType == GL_UNSIGNED_SHORT) {
+        const unsigned short* lShortList = static_cast<const unsigned short*>(mIndexData);
+        std::copy(lShortList, lShortList + mFaceCount*3, lIndices.begin());
+    } else {
+        std::memcpy(lIndices.data(), mIndexData, mFaceCount*3*sizeof(unsigned int));
+    }
+
+    MeshSimplifier lSimplifier(static_cast<const float*>(mPackedData), sizeof(PackedVertex)/sizeof(float),
+                               mPackedCount, lIndices.data(), mFaceCount);
+    std::vector<MeshLOD> lLODs = lSimplifier.buildLODs(lTargets, pCancel);
+    if(lLODs.empty()) {
+        return lLODs;
+    }
+
+    // Levels stuck well above their target (too many locked vertices) save too little to keep
+    size_t lPrevious = mFaceCount;
+    for(size_t l=0; l<lLODs.size(); ) {
+        size_t lFaces = lLODs[l].mIndices.size()/3;
+        if(lFaces > lPrevious*3/4) {
+            lLODs.erase(lLODs.begin() + l);
+        } else {
+            lPrevious = lFaces;
+            l++;
+        }
+    }
+    qInfo("Built %d levels of detail (%d vertices locked on borders and seams)",
+          (int)lLODs.size(), (int)lSimplifier.getLockedCount());
+    return lLODs;
+}
+
+size_t PLYMeshData::getIndexCount(int pLOD) const {
+    return (pLOD < 0 ? mFaceCount*3 : mLODs[pLOD].mIndices.size());
+}
+
+size_t PLYMeshData::getIndexOffset(int pLOD) const {
+    // The full mesh comes first, then each level of detail
+    size_t lIndexBytes = (mIndexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int));
+    size_t lOffset = 0;
+    if(pLOD >= 0) {
+        lOffset = mFaceCount*3;
+        for(int l=0; l<pLOD; l++) {
+            lOffset += mLODs[l].mIndices.size();
+        }
+    }
+    return lOffset * lIndexBytes;
+}
+
 void PLYMeshData::buildTextures() {
     if (mTextureFile[0].filePath() == "") {
         return;
@@ -358,6 +1126,14 @@ void PLYMeshData::buildTextures() {
     }
 }
 
+void PLYMeshData::buildTextures(const QImage pImages[4]) {
+    // Null images leave their texture out
+    for(int i=0; i<4; i++) {
+        delete mGLTexture[i];
+        mGLTexture[i] = (pImages[i].isNull() ? nullptr : new QOpenGLTexture(pImages[i].mirrored()));
+    }
+}
+
 void PLYMeshData::releaseBuffers() {
     if (mVAO != nullptr && mVAO->isCreated()) {
         mVAO->release();
@@ -366,6 +1142,10 @@ void PLYMeshData::releaseBuffers() {
     if (mVertexBuffer != nullptr && mVertexBuffer->isCreated()) {
         mVertexBuffer->release();
     }
+
+    if (mIndexBuffer != nullptr && mIndexBuffer->isCreated()) {
+        mIndexBuffer->release();
+    }
 }
 
 void PLYMeshData::destroyBuffers() {
@@ -376,26 +1156,35 @@ void PLYMeshData::destroyBuffers() {
     if (mVertexBuffer != nullptr && mVertexBuffer->isCreated()) {
         mVertexBuffer->destroy();
     }
+
+    if (mIndexBuffer != nullptr && mIndexBuffer->isCreated()) {
+        mIndexBuffer->destroy();
+    }
 }
 
 bool PLYMeshData::parsePLYFileStream(QString pFilename, QuaZipFile* pInsideFile) { // throws IOException {
     // Open file and read header info
     PLY::Header header;
     PLY::Reader reader(header);
+
+    // Archive data is inflated ahead on another thread while the previous block is parsed
+    std::unique_ptr<PLY::ReadAheadDevice> lReadAhead;
     if (pInsideFile != nullptr) {
-        if (!reader.use_io_device(pInsideFile)) {
+        lReadAhead.reset(new PLY::ReadAheadDevice(pInsideFile, true));
+        if (!lReadAhead->open(QIODevice::ReadOnly) || !reader.use_io_device(lReadAhead.get())) {
             qWarning("Failed to use archive stream");
             return false;
         }
     } else {
-        if (!reader.open_file(pFilename)) {
+        // Local files are mapped so their data is decoded without copying
+        if (!reader.map_file(pFilename)) {
             qWarning("Failed to open '%s'", pFilename.toLocal8Bit().data());
             return false;
         }
     }
 
-    // Prepare storage
-    PLY::Storage store(header);
+    // Prepare columnar storage (one contiguous array per property)
+    PLY::ColumnStorage store(header);
     PLY::Element& vertex = *header.find_element(PLY::Vertex::name);
     PLY::Element& face = *header.find_element(PLY::Face::name);
 
@@ -416,32 +1205,44 @@ bool PLYMeshData::parsePLYFileStream(QString pFilename, QuaZipFile* pInsideFile)
     mHasNormals = true;
     mHasTexCoords = (face.props.size() > 1);
 
-    // Prepare external arrays
-    mPLYVertCollection.clear();
-    PLY::VNCTExternal vertices(mPLYVertCollection);
-    store.set_collection(header, vertex, vertices);
-
-    mPLYFaceCollection.clear();
-    PLY::FTExternal faces(mPLYFaceCollection);
-    store.set_collection(header, face, faces);
+    // Store everything we use as float, and indices as unsigned int
+    PLY::ColumnArray& vertices = *store.get_columns(PLY::Vertex::name);
+    PLY::ColumnArray& faces = *store.get_columns(PLY::Face::name);
+    for(auto curProp: vertex.props) {
+        if (curProp.type == PLY::SCALAR) {
+            vertices.set_type(curProp.name.c_str(), PLY::Float32);
+        }
+    }
+    faces.set_type(PLY::Face::prop_ind.name.c_str(), PLY::Uint32);
+    faces.set_type(PLY::FaceTex::prop_tex.name.c_str(), PLY::Float32);
+
+    // Pass on a preview as soon as the vertices are read, before the faces are
+    if (mPreviewHandler) {
+        reader.element_read = [&](const PLY::Element& pElem) {
+            if (pElem.name != PLY::Vertex::name) { return; }
+            PLYMeshData* lPreview = makePreview(vertices);
+            if (lPreview != nullptr) {
+                qInfo("Preview of %zu points ready", lPreview->getPackedCount());
+                mPreviewHandler(lPreview);
+            }
+        };
+    }
 
-    // Read the data in the file into the storage.
+    // Read the data in the file into the storage (ASCII and binary data are split over all cores)
+    reader.threads = 0;
     bool ok = reader.read_data(&store);
-    // TODO: Investigate possible memory leak from line below.
-    //reader.close_file();
+    // The archive stream is closed and released with lReadAhead
+    if (pInsideFile == nullptr) {
+        // Release the local file and its memory map
+        reader.close_file();
+    }
     if (!ok) {
         qWarning("Error reading data from PLY file");
         return false;
     }
 
     // Process the raw data for display with OpenGL
-    mPLYVertCollection.shrink_to_fit();
-    mPLYFaceCollection.shrink_to_fit();
-    processRawData();
-
-    // Free up the raw PLY data
-    mPLYVertCollection.clear();
-    mPLYFaceCollection.clear();
+    processRawData(vertices, faces);
 
     // Inidicate success
     return true;
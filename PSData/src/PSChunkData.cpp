@@ -83,6 +83,7 @@ void PSChunkData::parseXMLChunk(QXmlStreamReader* reader) {
         mTempFileStack.push(mSourceFile);
     }
 
+    QXmlStreamReader* preChunkReader = reader;
     try { reader = explodeTag(reader, mTempFileStack); }
     catch (...) {
         qWarning("Error exploding chunk tag");
@@ -121,6 +122,11 @@ void PSChunkData::parseXMLChunk(QXmlStreamReader* reader) {
     } catch (...) {
         qWarning("XML parsing error in chunk tag.\n");
     }
+
+    // Done with the chunk's own file
+    if(reader != preChunkReader) {
+        deleteXMLStream(reader);
+    }
 }
 
 void PSChunkData::processArrayElement(QXmlStreamReader* reader, QString elem) {
@@ -213,8 +219,8 @@ void PSChunkData::parseXMLFrame(QXmlStreamReader* reader) {
                     // Return to old stream
                     if(reader != preModelReader) {
                         mTempFileStack.pop();
-                        delete reader;
-                        reader = preFrameReader;
+                        deleteXMLStream(reader);
+                        reader = preModelReader;
                     }
                 } else if (elem == "property") {
                     QString lPropertyName = reader->attributes().value(nullptr, "name").toString();
@@ -226,8 +232,7 @@ void PSChunkData::parseXMLFrame(QXmlStreamReader* reader) {
 
         // Return to old stream
         if(preFrameReader != reader) {
-            delete reader->device();
-            delete reader;
+            deleteXMLStream(reader);
             reader = preFrameReader;
         }
     } catch (...) {
@@ -1,6 +1,7 @@
 #include "PSModelData.h"
 
 #include "PSChunkData.h"
+#include "PLYMeshData.h"
 
 #include <QXmlStreamReader>
 #include <QFile>
@@ -43,6 +44,17 @@ void PSModelData::addTextureFile(int pId, QString pFilepath) {
     textureFiles.insert(pId, pFilepath);
 }
 
+bool PSModelData::probeMeshCounts() {
+    size_t lVertexCount, lFaceCount;
+    if (!PLYMeshData::probePLYFile(mZipFile, mMeshFilepath, lVertexCount, lFaceCount)) {
+        return false;
+    }
+
+    mVertexCount = (long)lVertexCount;
+    mFaceCount = (long)lFaceCount;
+    return true;
+}
+
 QFileInfo PSModelData::getArchiveFile() const { return mZipFile; }
 
 long PSModelData::getFaceCount() const { return mFaceCount; }
@@ -59,7 +59,7 @@ bool PSProjectFileData::parseProjectFile() {
                     QXmlStreamReader* oldReader = reader;
                     reader = explodeTag(reader, mPathStack);
                     if(oldReader != reader) {
-                        delete oldReader;
+                        deleteXMLStream(oldReader);
                     }
                 }
 
@@ -74,12 +74,12 @@ bool PSProjectFileData::parseProjectFile() {
         qWarning("XML Parsing encountered an error\n");
 
         // Finish and return failure
-        delete reader;
+        deleteXMLStream(reader);
         return false;
     }
 
     // Finish and return success
-    delete reader;
+    deleteXMLStream(reader);
     return true;
 }
 
@@ -251,6 +251,11 @@ void PSSessionData::parseProjectXMLAndCache() {
 
     PSModelData* lModel = lActiveChunk->getModelData();
     if (lModel != nullptr) {
+        // Older projects do not list all counts, but the PLY header does
+        if (lModel->getFaceCount() <= 0 || lModel->getVertexCount() <= 0) {
+            lModel->probeMeshCounts();
+        }
+
         mHasMesh = true;
         mMeshFaces = lModel->getFaceCount();
         mMeshVerts = lModel->getVertexCount();
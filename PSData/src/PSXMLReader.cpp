@@ -7,6 +7,8 @@
 
 #include <quazip/quazipfile.h>
 
+#include <readahead.h>
+
 // This looks for a 'path' attribute in the current element.
 // Sometimes a portion of the XML file is stripped out and placed
 // in it's own file under the .files directory. This function will
@@ -70,7 +72,10 @@ QXmlStreamReader* PSXMLReader::getXMLStreamFromFile(QFileInfo pFile) {
             qWarning("Failed to open zip file: %d.", lInsideFile->getZipError());
             delete lInsideFile;
         } else if(lInsideFile->pos() >= 0) {
-            lXMLFileStream = new QXmlStreamReader(lInsideFile);
+            // Inflate ahead on another thread while the XML is parsed
+            PLY::ReadAheadDevice* lReadAhead = new PLY::ReadAheadDevice(lInsideFile, true);
+            lReadAhead->open(QIODevice::ReadOnly);
+            lXMLFileStream = new QXmlStreamReader(lReadAhead);
         }
     } else if(ext == "psx" || ext == "xml") {
         // A raw PS xml QFile (probably to be accompanied by a .files directory)
@@ -88,6 +93,15 @@ QXmlStreamReader* PSXMLReader::getXMLStreamFromFile(QFileInfo pFile) {
     return lXMLFileStream;
 }
 
+// Delete a stream made by getXMLStreamFromFile along with its device.
+// The parser stops at the end of the root tag, so a read-ahead device would
+// otherwise keep its buffers (and its thread, when the file is only partly read).
+void PSXMLReader::deleteXMLStream(QXmlStreamReader* reader) {
+    if(reader == nullptr) { return; }
+    delete reader->device();
+    delete reader;
+}
+
 // Function to read arrays encoded in XML (a la Agisoft's XML File format)
 void PSXMLReader::readElementArray(QXmlStreamReader* reader, QString arrayName, QString elementName) {
     // Loop over all elements till the end of the array is reached
@@ -49,3 +49,8 @@ else:macx: LIBS += -L$$OUT_PWD/../QPLY/ -lQPLY
 
 INCLUDEPATH += $$PWD/../QPLY/include
 DEPENDPATH += $$PWD/../QPLY/include
+
+# QPLY reads and writes .ply.gz files through zlib
+macx: LIBS += -lz
+win32:CONFIG(debug, debug|release): LIBS += -lzlibd
+else:win32: LIBS += -lzlib
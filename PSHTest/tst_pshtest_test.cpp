@@ -1,10 +1,14 @@
 #include <QString>
 #include <QFileInfo>
+#include <QTemporaryDir>
 #include <QXmlStreamReader>
 #include <QtTest>
 
 #include <fstream>
 #include <exception>
+#include <cmath>
+#include <set>
+#include <vector>
 
 #include <quazip/quazipfile.h>
 
@@ -57,6 +61,7 @@ namespace PLY {
 #include <PSImageData.h>
 #include <PSModelData.h>
 #include <PSChunkData.h>
+#include <MeshSimplifier.h>
 
 // So we can put these in as data rows
 Q_DECLARE_METATYPE(PSSensorData*)
@@ -98,6 +103,12 @@ private slots:
     void fullXMLParsing_data();
     void fullXMLParsing();
 
+    void meshSimplification_data();
+    void meshSimplification();
+
+    void plyRoundTrip_data();
+    void plyRoundTrip();
+
     void cleanupTestCase();
 
 private:
@@ -848,6 +859,293 @@ void PSHTest_Test::fullXMLParsing()
     delete data;
 }
 
+void PSHTest_Test::meshSimplification_data()
+{
+    QTest::addColumn<float>("height");
+
+    QTest::newRow("Flat grid") << 0.0f;
+    QTest::newRow("Wavy grid") << 0.05f;
+}
+
+void PSHTest_Test::meshSimplification()
+{
+    QFETCH(float, height);
+
+    // A 40x40 grid of quads, with a UV seam down the middle column
+    // (its vertices are doubled, as welding leaves them)
+    const unsigned int N = 40, SEAM = N/2, SEAM_START = (N+1)*(N+1);
+    vector<float> positions;
+    for(unsigned int v=0; v<(N+1)*(N+2); v++) {
+        unsigned int i = (v < SEAM_START ? v % (N+1) : SEAM);
+        unsigned int j = (v < SEAM_START ? v / (N+1) : v - SEAM_START);
+        float x = i/(float)N, y = j/(float)N;
+        positions.push_back(x);
+        positions.push_back(y);
+        positions.push_back(height*sin(x*12.0f)*cos(y*9.0f));
+    }
+
+    vector<unsigned int> indices;
+    for(unsigned int j=0; j<N; j++) {
+        for(unsigned int i=0; i<N; i++) {
+            unsigned int lCorners[4] = { j*(N+1) + i, j*(N+1) + i+1, (j+1)*(N+1) + i+1, (j+1)*(N+1) + i };
+            if(i == SEAM) { lCorners[0] = SEAM_START + j; lCorners[3] = SEAM_START + j+1; }
+            unsigned int lFaces[6] = { lCorners[0], lCorners[1], lCorners[2], lCorners[0], lCorners[2], lCorners[3] };
+            indices.insert(indices.end(), lFaces, lFaces + 6);
+        }
+    }
+    size_t vertexCount = positions.size()/3, faceCount = indices.size()/3;
+
+    vector<size_t> targets;
+    targets.push_back(faceCount/2);
+    targets.push_back(faceCount/5);
+    MeshSimplifier simplifier(positions.data(), 3, vertexCount, indices.data(), faceCount);
+    vector<MeshLOD> lods = simplifier.buildLODs(targets);
+    QCOMPARE(lods.size(), targets.size());
+
+    float lastError = 0.0f;
+    for(size_t l=0; l<lods.size(); l++) {
+        const vector<unsigned int>& lodIndices = lods[l].mIndices;
+        QCOMPARE(lodIndices.size() % 3, (size_t)0);
+        QVERIFY(lodIndices.size()/3 <= targets[l]);
+
+        // Valid triangles over the original vertices
+        for(size_t f=0; f<lodIndices.size(); f+=3) {
+            QVERIFY(lodIndices[f] < vertexCount && lodIndices[f+1] < vertexCount && lodIndices[f+2] < vertexCount);
+            QVERIFY(lodIndices[f] != lodIndices[f+1] && lodIndices[f+1] != lodIndices[f+2] && lodIndices[f] != lodIndices[f+2]);
+        }
+
+        // Both sides of the seam are kept, so the texture mapping holds
+        set<unsigned int> used(lodIndices.begin(), lodIndices.end());
+        for(unsigned int j=0; j<=N; j++) {
+            QVERIFY(used.count(j*(N+1) + SEAM) == 1);
+            QVERIFY(used.count(SEAM_START + j) == 1);
+        }
+
+        // Coarser levels are never more accurate
+        QVERIFY(lods[l].mError >= lastError);
+        lastError = lods[l].mError;
+    }
+}
+
+// The sizes of the face lists, which cycle over the rows
+static const size_t ROUND_TRIP_FACE_SIZES[] = { 3, 4, 0, 5, 3, 1 };
+
+// Describe the mesh written by plyRoundTrip: vertices of a fixed size,
+// faces with lists of mixed lengths (some empty) and edges with lists of one length
+static void makeRoundTripHeader(PLY::Header& pHeader) {
+    PLY::Element lVertex("vertex");
+    lVertex.add_property(PLY::Property("x", PLY::SCALAR, PLY::Float32));
+    lVertex.add_property(PLY::Property("y", PLY::SCALAR, PLY::Float32));
+    lVertex.add_property(PLY::Property("z", PLY::SCALAR, PLY::Float32));
+    lVertex.add_property(PLY::Property("red", PLY::SCALAR, PLY::Uint8));
+    lVertex.add_property(PLY::Property("quality", PLY::SCALAR, PLY::Float64));
+    lVertex.add_property(PLY::Property("id", PLY::SCALAR, PLY::Int16));
+    lVertex.num = 40000;
+    pHeader.add_element(lVertex);
+
+    PLY::Element lFace("face");
+    lFace.add_property(PLY::Property("vertex_indices", PLY::LIST, PLY::Uint32, PLY::Uint8));
+    lFace.add_property(PLY::Property("texcoord", PLY::LIST, PLY::Float32, PLY::Uint8));
+    lFace.add_property(PLY::Property("flags", PLY::SCALAR, PLY::Int32));
+    lFace.num = 30000;
+    pHeader.add_element(lFace);
+
+    PLY::Element lEdge("edge");
+    lEdge.add_property(PLY::Property("vertex_indices", PLY::LIST, PLY::Int32, PLY::Uint16));
+    lEdge.add_property(PLY::Property("crease", PLY::SCALAR, PLY::Uint8));
+    lEdge.num = 20000;
+    pHeader.add_element(lEdge);
+}
+
+// The number of items of a list in the round trip mesh
+static size_t roundTripSize(const PLY::Element& pElem, const PLY::Property& pProp, size_t pRow) {
+    if (pElem.name == "edge") { return 2; }
+    size_t lSize = ROUND_TRIP_FACE_SIZES[pRow % 6];
+    if (pProp.name == "texcoord") { return (pRow % 11 == 0 ? 0 : 2*lSize); }
+    return lSize;
+}
+
+// A value of the round trip mesh, which is exact in every type and in ASCII
+static double roundTripValue(const PLY::Property& pProp, size_t pIndex, size_t pRow, size_t pItem) {
+    int lValue = (int)((pRow*31 + pItem*7 + pIndex*13) % 20000);
+    switch (pProp.data_type) {
+        case PLY::Float32: case PLY::Float64: return (lValue - 10000) * 0.25;
+        case PLY::Int8: case PLY::Int16: case PLY::Int32: return lValue % 200 - 100;
+        default: return lValue % 200;
+    }
+}
+
+// Fill the columns of the round trip mesh
+static void fillRoundTrip(const PLY::Header& pHeader, PLY::ColumnStorage& pStore) {
+    for (const PLY::Element& lElem : pHeader.elements) {
+        PLY::ColumnArray* lRows = pStore.get_columns(lElem.name.c_str());
+        lRows->prepare(lElem.num);
+        for (size_t p = 0; p < lRows->columns.size(); p++) {
+            PLY::Column& lColumn = lRows->columns[p];
+            for (size_t r = 0; r < lElem.num; r++) {
+                if (lColumn.scalar()) {
+                    lColumn.set(r, roundTripValue(lColumn.prop, p, r, 0));
+                    continue;
+                }
+                lColumn.set_size(r, roundTripSize(lElem, lColumn.prop, r));
+                for (size_t i = 0; i < lColumn.size(r); i++) {
+                    lColumn.set(lColumn.offsets[r] + i, roundTripValue(lColumn.prop, p, r, i));
+                }
+            }
+        }
+    }
+}
+
+// Compare rows read back with the round trip mesh, starting at row pFirst of the element
+// (an empty result means every stored value matches, and properties not stored are empty)
+static QString compareRoundTrip(PLY::ColumnArray& pRows, size_t pFirst) {
+    for (size_t p = 0; p < pRows.columns.size(); p++) {
+        const PLY::Column& lColumn = pRows.columns[p];
+        QString lName = QString("%1.%2").arg(pRows.elem.name.c_str()).arg(lColumn.prop.name.c_str());
+        if (!lColumn.prop.store) {
+            if (!lColumn.values.empty()) { return lName + " was read although it was not selected"; }
+            continue;
+        }
+        if (lColumn.rows() != pRows.size()) {
+            return QString("%1 has %2 rows").arg(lName).arg(lColumn.rows());
+        }
+        for (size_t r = 0; r < lColumn.rows(); r++) {
+            if (lColumn.scalar()) {
+                if (lColumn.get(r) != roundTripValue(lColumn.prop, p, pFirst + r, 0)) {
+                    return QString("%1 differs in row %2").arg(lName).arg(pFirst + r);
+                }
+                continue;
+            }
+            if (lColumn.size(r) != roundTripSize(pRows.elem, lColumn.prop, pFirst + r)) {
+                return QString("%1 has the wrong size in row %2").arg(lName).arg(pFirst + r);
+            }
+            for (size_t i = 0; i < lColumn.size(r); i++) {
+                if (lColumn.get(lColumn.offsets[r] + i) != roundTripValue(lColumn.prop, p, pFirst + r, i)) {
+                    return QString("%1 differs in row %2, item %3").arg(lName).arg(pFirst + r).arg(i);
+                }
+            }
+        }
+    }
+    return QString();
+}
+
+void PSHTest_Test::plyRoundTrip_data()
+{
+    QTest::addColumn<int>("format");
+    QTest::addColumn<bool>("compressed");
+    QTest::addColumn<int>("threads");
+    QTest::addColumn<bool>("mapped");
+
+    const int lFormats[] = { PLY::ASCII, PLY::BINARY_LE, PLY::BINARY_BE };
+    const char* lFormatNames[] = { "ASCII", "Binary LE", "Binary BE" };
+    for (int f = 0; f < 3; f++) {
+        for (int c = 0; c < 2; c++) {
+            for (int t = 0; t < 2; t++) {
+                for (int m = 0; m < 2; m++) {
+                    QString lName = QString("%1%2, %3, %4").arg(lFormatNames[f]).arg(c ? " gz" : "")
+                            .arg(t ? "all threads" : "1 thread").arg(m ? "mapped" : "opened");
+                    QTest::newRow(lName.toLocal8Bit().data()) << lFormats[f] << (c == 1) << (t ? 0 : 1) << (m == 1);
+                }
+            }
+        }
+    }
+}
+
+void PSHTest_Test::plyRoundTrip()
+{
+    QFETCH(int, format);
+    QFETCH(bool, compressed);
+    QFETCH(int, threads);
+    QFETCH(bool, mapped);
+
+    QTemporaryDir lDir;
+    QVERIFY(lDir.isValid());
+    QString lFile = lDir.path() + (compressed ? "/roundtrip.ply.gz" : "/roundtrip.ply");
+
+    // Write the mesh in the format of this row
+    {
+        PLY::Header lHeader;
+        makeRoundTripHeader(lHeader);
+        PLY::ColumnStorage lStore(lHeader);
+        fillRoundTrip(lHeader, lStore);
+
+        PLY::Writer lWriter(lHeader, lFile.toLocal8Bit().data(), (PLY::Stream_type)format);
+        lWriter.threads = threads;
+        QVERIFY(lWriter.source != nullptr);
+        QVERIFY(lWriter.write_data(&lStore));
+        QVERIFY(lWriter.close_file());
+    }
+
+    // Read all of it at once
+    {
+        PLY::Header lHeader;
+        PLY::Reader lReader(lHeader);
+        lReader.threads = threads;
+        QVERIFY(mapped ? lReader.map_file(lFile) : lReader.open_file(lFile));
+        QCOMPARE((int)lHeader.stream_type, format);
+
+        PLY::ColumnStorage lStore(lHeader);
+        bool lOK = lReader.read_data(&lStore);
+        lReader.close_file();
+        QVERIFY(lOK);
+        for (const PLY::Element& lElem : lHeader.elements) {
+            PLY::ColumnArray* lRows = lStore.get_columns(lElem.name.c_str());
+            QCOMPARE(lRows->size(), lElem.num);
+            QString lError = compareRoundTrip(*lRows, 0);
+            QVERIFY2(lError.isEmpty(), lError.toLocal8Bit().data());
+        }
+    }
+
+    // Read it batch by batch, in batches that do not line up with the blocks
+    {
+        PLY::Header lHeader;
+        PLY::Reader lReader(lHeader);
+        lReader.threads = threads;
+        QVERIFY(mapped ? lReader.map_file(lFile) : lReader.open_file(lFile));
+        QVERIFY(lReader.start_batches(5000));
+
+        std::vector<size_t> lRead(lHeader.elements.size(), 0);
+        PLY::Batch lBatch;
+        while (lReader.next_batch(lBatch)) {
+            size_t lIndex;
+            QVERIFY(lHeader.find_index(lBatch.elem->name.c_str(), lIndex));
+            QCOMPARE(lBatch.first, lRead[lIndex]);
+            QString lError = compareRoundTrip(*lBatch.rows, lBatch.first);
+            QVERIFY2(lError.isEmpty(), lError.toLocal8Bit().data());
+            lRead[lIndex] += lBatch.rows->size();
+        }
+        bool lDone = lReader.batches_done();
+        lReader.close_file();
+        QVERIFY(lDone);
+        for (size_t e = 0; e < lHeader.elements.size(); e++) {
+            QCOMPARE(lRead[e], lHeader.elements[e].num);
+        }
+    }
+
+    // Read only some properties, skipping fixed rows, lists and a whole element
+    {
+        PLY::Header lHeader;
+        PLY::Reader lReader(lHeader);
+        lReader.threads = threads;
+        QVERIFY(mapped ? lReader.map_file(lFile) : lReader.open_file(lFile));
+        lHeader.select_none();
+        QVERIFY(lHeader.select("vertex", std::vector<std::string>{ "y", "quality" }));
+        QVERIFY(lHeader.select("face", std::vector<std::string>{ "texcoord", "flags" }));
+
+        PLY::ColumnStorage lStore(lHeader);
+        bool lOK = lReader.read_data(&lStore);
+        lReader.close_file();
+        QVERIFY(lOK);
+        QCOMPARE(lStore.get_columns("edge")->size(), (size_t)0);
+        QVERIFY(lStore.get_columns("vertex")->find("y")->rows() == lHeader.find_element("vertex")->num);
+        QVERIFY(lStore.get_columns("face")->find("texcoord")->rows() == lHeader.find_element("face")->num);
+        for (const char* lName : { "vertex", "face" }) {
+            QString lError = compareRoundTrip(*lStore.get_columns(lName), 0);
+            QVERIFY2(lError.isEmpty(), lError.toLocal8Bit().data());
+        }
+    }
+}
+
 void PSHTest_Test::cleanupTestCase() {
     delete s0;
     delete s1;
@@ -4,8 +4,12 @@ SUBDIRS += \
     PSHTest \
     PhotoscanHelper \
     PSData \
-    QPLY
+    QPLY \
+    QPLYBench \
+    PLYConvert
 
 PSData.depends = QPLY
 PhotoscanHelper.depends = PSData
 PHTest.depends = PSData
+QPLYBench.depends = PSData
+PLYConvert.depends = QPLY
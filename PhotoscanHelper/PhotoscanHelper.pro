@@ -140,3 +140,6 @@ else:win32-g++:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../QPLY
 else:win32:!win32-g++:CONFIG(release, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../QPLY/release/QPLY.lib
 else:win32:!win32-g++:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../QPLY/debug/QPLY.lib
 else:macx: PRE_TARGETDEPS += $$OUT_PWD/../QPLY/libQPLY.a
+
+# QPLY reads and writes .ply.gz files through zlib (linked with exiv2 on windows)
+macx: LIBS += -lz
@@ -3,7 +3,9 @@
 
 #include <QWidget>
 #include <QFileInfo>
+#include <QImage>
 #include <QString>
+#include <QVector>
 
 template <class T>
 class QFutureWatcher;
@@ -29,22 +31,40 @@ public:
     void loadNewModel(const PSSessionData* pSession);
     void loadNewModel(const PSModelData* pModel);
 
-    bool loadAllData(const PSModelData* pModel);
+    bool loadAllData(const PSModelData* pModel, int pLoad);
+
+signals:
+    // The stages of loading a model, in order, each emitted once it is shown
+    void previewReady();            // Points subsampled from the vertices
+    void meshReady();               // The full mesh, without textures
+    void texturesReady();           // The textures of the mesh
+    void levelsOfDetailReady();     // The levels of detail drawn while the view moves
 
 public slots:
     void on_renderModeComboBox_currentIndexChanged(int index);
+    void on_compactVerticesCheckBox_toggled(bool checked);
+
+private slots:
+    // Stages passed on from the loading thread (pLoad tells the current load from older ones)
+    void previewLoaded(int pLoad, PLYMeshData* pPreview);
+    void meshLoaded(int pLoad, PLYMeshData* pMesh);
+    void texturesLoaded(int pLoad, QVector<QImage> pTextures);
 
 private:
     Ui::GLModelViewer* mGUI;
 
     PSModelData* mModelData;
     PLYMeshData* mPlyMesh;
+    PLYMeshData* mPreviewMesh;
     QString mName;
 
     QImage mPngTextures[4];
     QFutureWatcher<bool>* mDataLoading;
+    int mLoadCount;
 
     void initMembers();
+    void replacePreview(PLYMeshData* pPreview);
+    void replaceMesh(PLYMeshData* pMesh);
 
     QImage readTexture(QString pTextureFilename, QFileInfo pArchiveFile = QFileInfo());
     void dataLoadingFinished();
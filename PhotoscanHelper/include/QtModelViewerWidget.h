@@ -3,12 +3,18 @@
 
 #include <EnumFactory.h>
 
+#include <QElapsedTimer>
+#include <QFutureWatcher>
 #include <QMatrix4x4>
 #include <QOpenGLWidget>
 #include <QOpenGLFunctions>
 #include <QPointF>
 
+#include <atomic>
+#include <vector>
+
 class PLYMeshData;
+struct MeshLOD;
 class QtTrackball;
 class QOpenGLShaderProgram;
 class QOpenGLBuffer;
@@ -37,12 +43,24 @@ public:
     QtModelViewerWidget(QWidget* parent = nullptr);
     virtual ~QtModelViewerWidget();
 
+    // Set the mesh to draw and its textures (nullptr: the mesh reads its own texture files)
     void setModelData(QImage mColorTexture[], PLYMeshData* pMeshData);
+
+    // Stop building levels of detail in the background, so their mesh can be deleted
+    void cancelLevelsOfDetail();
+    void setTextures(QImage pColorTexture[]);
     void setRenderMode(int index);
 
+    // Switch between full and compact (quantized) vertex buffers
+    void setCompactVertices(bool pCompact);
+
     void setFlatColor(QColor newColor);
     QColor getFlatColor() const;
 
+signals:
+    // The levels of detail of the current mesh are ready to draw while the view moves
+    void levelsOfDetailReady();
+
 protected:
     // Overriding mouse event methods
     void mousePressEvent(QMouseEvent* event);
@@ -58,6 +76,9 @@ protected slots:
     // A special update slot for the timer only
     void updateGLFromTimer();
 
+    // Upload the levels of detail built in the background
+    void lodsFinished();
+
     // Core QOpenGLWidget Actions
     void initializeGL();
     void resizeGL(int w, int h);
@@ -70,6 +91,7 @@ private:
 
     int mPerspLoc, mModelLoc, mViewLoc, mNormalMatLoc, mColorUniformLoc;
     int mRenderModeLoc, mLightPositionLoc;
+    int mPositionOffsetLoc, mPositionScaleLoc, mOctNormalsLoc;
 
     int mColorTexLoc[4];
     int mColorTextureID[4];
@@ -79,6 +101,14 @@ private:
     QColor mUniformColor;
     QTimer* mIdleTimer;
     RenderMode mRenderMode;
+    bool mCompactVertices;
+
+    // Levels of detail, built in the background and drawn while the view moves
+    QFutureWatcher<std::vector<MeshLOD> >* mLODBuilding;
+    PLYMeshData* mLODMesh;
+    std::atomic<bool> mLODCancel;
+    QElapsedTimer mLastInteraction;
+    Qt::MouseButtons mButtonsDown;
 
     // Cube example object
     QOpenGLBuffer *mCubeVBuffer, *mCubeElemBuffer;
@@ -94,6 +124,7 @@ private:
 
     void drawExampleCube();
     void drawMesh();
+    int pickLOD() const;
 
     static const float EXAMPLE_CUBE_PACKED_DATA[];
     static const int EXAMPLE_CUBE_TRI_FACES[];
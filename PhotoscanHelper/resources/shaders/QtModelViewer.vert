@@ -27,11 +27,30 @@ uniform mat4 modelMatrix;
 uniform mat4 viewMatrix;
 uniform mat3 normalMatrix;
 
+// Decoding of compact vertices (identity for float vertices)
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+uniform bool octahedralNormals;
+
+// Unfold a normal from the octahedron
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += (n.x >= 0.0) ? -t : t;
+    n.y += (n.y >= 0.0) ? -t : t;
+    return normalize(n);
+}
+
 void main(void)
 {
+    // Decode the vertex position and normal
+    vec4 vertex = vec4(vertexAttrib.xyz * positionScale + positionOffset, 1.0);
+    vec3 normal = octahedralNormals ? decodeOctahedral(normalAttrib.xy) : normalAttrib;
+
     // Pass through unmodified for visualization
-    baseVertexAttribFrag = vertexAttrib.xyz;
-    baseNormalAttribFrag = normalAttrib;
+    baseVertexAttribFrag = vertex.xyz;
+    baseNormalAttribFrag = normal;
     
     // Pass through for interpolation
     colorAttribFrag = colorAttrib;
@@ -39,7 +58,7 @@ void main(void)
     
     // Transform and pass through for lighting
     lightPositionFrag = viewMatrix * lightPosition;
-    camNormalFrag = normalMatrix * normalAttrib;
-    camVertexFrag = viewMatrix * modelMatrix * vertexAttrib;
+    camNormalFrag = normalMatrix * normal;
+    camVertexFrag = viewMatrix * modelMatrix * vertex;
     gl_Position = perspectiveMatrix * camVertexFrag;
 }
@@ -17,6 +17,9 @@
 #include "ui_GLModelWidget.h"
 #include "QtModelViewerWidget.h"
 
+// Passed from the loading thread through queued calls
+Q_DECLARE_METATYPE(PLYMeshData*)
+
 GLModelWidget::GLModelWidget(QWidget* parent) : QWidget(parent) {
     initMembers();
 }
@@ -43,6 +46,13 @@ void GLModelWidget::initMembers() {
     mGUI = new Ui::GLModelViewer();
     mGUI->setupUi(this);
 
+    mPlyMesh = mPreviewMesh = nullptr;
+    mDataLoading = nullptr;
+    mLoadCount = 0;
+    qRegisterMetaType<PLYMeshData*>();
+    qRegisterMetaType<QVector<QImage> >();
+    connect(mGUI->modelViewer, &QtModelViewerWidget::levelsOfDetailReady, this, &GLModelWidget::levelsOfDetailReady);
+
     // Rebuild the combobox
     mGUI->renderModeComboBox->clear();
     for(int i=0; i<QtModelViewerWidget::RENDER_COUNT; i++) {
@@ -70,9 +80,14 @@ void GLModelWidget::loadNewModel(const PSSessionData* pSession) {
 }
 
 void GLModelWidget::loadNewModel(const PSModelData* pModel) {
+    // Whatever an older load still passes on is dropped
+    mLoadCount++;
+    delete mDataLoading;
+    mDataLoading = nullptr;
+
     if(pModel == nullptr) {
-        mPlyMesh = nullptr;
-        mGUI->modelViewer->setModelData(nullptr, nullptr);
+        replaceMesh(nullptr);
+        replacePreview(nullptr);
         mGUI->statusLabel->setText("Please load a model.");
     } else {
         if (pModel->getArchiveFile().filePath() == "") {
@@ -80,30 +95,140 @@ void GLModelWidget::loadNewModel(const PSModelData* pModel) {
         } else {
             mName = pModel->getArchiveFile().baseName();
         }
-        mGUI->statusLabel->setText(QString::asprintf("Loading mesh for '%s' ...", mName.toLocal8Bit().data()));
+        // The header alone gives the size of the mesh before it is loaded
+        size_t lVertexCount, lFaceCount;
+        if (PLYMeshData::probePLYFile(pModel->getArchiveFile(), pModel->getMeshFilename(), lVertexCount, lFaceCount)) {
+            mGUI->statusLabel->setText(QString::asprintf("Loading mesh for '%s' (%s vertices, %s faces, ~%.1f MB) ...",
+                    mName.toLocal8Bit().data(),
+                    QLocale::system().toString((long long)lVertexCount).toLocal8Bit().data(),
+                    QLocale::system().toString((long long)lFaceCount).toLocal8Bit().data(),
+                    PLYMeshData::estimateBufferBytes(lVertexCount, lFaceCount) / (1024.0 * 1024.0)));
+        } else {
+            mGUI->statusLabel->setText(QString::asprintf("Loading mesh for '%s' ...", mName.toLocal8Bit().data()));
+        }
         mDataLoading = new QFutureWatcher<bool>();
         connect(mDataLoading, &QFutureWatcher<bool>::canceled, this, &GLModelWidget::dataLoadingFinished);
         connect(mDataLoading, &QFutureWatcher<bool>::finished, this, &GLModelWidget::dataLoadingFinished);
 
-        // Read the mesh and texture data in a separate thread
-        QFuture<bool> loadingFuture = QtConcurrent::run(this, &GLModelWidget::loadAllData, pModel);
+        // Read the mesh and texture data in a separate thread, showing each stage as it is ready
+        QFuture<bool> loadingFuture = QtConcurrent::run(this, &GLModelWidget::loadAllData, pModel, mLoadCount);
         mDataLoading->setFuture(loadingFuture);
     }
 }
 
-bool GLModelWidget::loadAllData(const PSModelData* pModel) { //throws IOException {
+bool GLModelWidget::loadAllData(const PSModelData* pModel, int pLoad) { //throws IOException {
 
-    // Read all the texture files
-    mPngTextures[0] = mPngTextures[1] = mPngTextures[2] = mPngTextures[3] = QImage();
+    // Read the model, passing on a preview as soon as its vertices are read
+    qInfo("Reading model %s\n", pModel->getMeshFilename().toLocal8Bit().data());
+    PLYMeshData* lMesh = new PLYMeshData();
+    lMesh->setUseCache(true);
+    lMesh->setPreviewHandler([this, pLoad](PLYMeshData* pPreview) {
+        QMetaObject::invokeMethod(this, "previewLoaded", Qt::QueuedConnection,
+                                  Q_ARG(int, pLoad), Q_ARG(PLYMeshData*, pPreview));
+    });
+    if (!lMesh->readPLYFile(pModel->getArchiveFile(), pModel->getMeshFilename())) {
+        delete lMesh;
+        return false;
+    }
+    QMetaObject::invokeMethod(this, "meshLoaded", Qt::QueuedConnection,
+                              Q_ARG(int, pLoad), Q_ARG(PLYMeshData*, lMesh));
+
+    // Read the texture files last, as the mesh is worth a look without them
+    QVector<QImage> lTextures(4);
     for(int texID : pModel->getTextureFiles().keys()) {
+        if (texID < 0 || texID >= lTextures.size()) {
+            qWarning("Skipping texture %d, only 4 textures are supported", texID);
+            continue;
+        }
         qInfo("Reading texture %s\n", pModel->getTextureFile(texID).toLocal8Bit().data());
-        mPngTextures[texID] = readTexture(pModel->getTextureFile(texID), pModel->getArchiveFile());
+        lTextures[texID] = readTexture(pModel->getTextureFile(texID), pModel->getArchiveFile());
+    }
+    QMetaObject::invokeMethod(this, "texturesLoaded", Qt::QueuedConnection,
+                              Q_ARG(int, pLoad), Q_ARG(QVector<QImage>, lTextures));
+    return true;
+}
+
+void GLModelWidget::previewLoaded(int pLoad, PLYMeshData* pPreview) {
+    if (pLoad != mLoadCount) {
+        delete pPreview;
+        return;
     }
 
-    // Read the model
-    qInfo("Reading model %s\n", pModel->getMeshFilename().toLocal8Bit().data());
-    mPlyMesh = new PLYMeshData();
-    return mPlyMesh->readPLYFile(pModel->getArchiveFile(), pModel->getMeshFilename());
+    mGUI->modelViewer->setModelData(nullptr, pPreview);
+    replacePreview(pPreview);
+    mGUI->statusLabel->setText(QString::asprintf("Preview of '%s' (%s points), loading the full mesh ...",
+            mName.toLocal8Bit().data(),
+            QLocale::system().toString((long long)pPreview->getPackedCount()).toLocal8Bit().data()));
+    emit previewReady();
+}
+
+void GLModelWidget::meshLoaded(int pLoad, PLYMeshData* pMesh) {
+    if (pLoad != mLoadCount) {
+        delete pMesh;
+        return;
+    }
+
+    // The textures are set once they are read
+    mPngTextures[0] = mPngTextures[1] = mPngTextures[2] = mPngTextures[3] = QImage();
+    replaceMesh(pMesh);
+    replacePreview(nullptr);
+
+    QString modelInfo = QString::asprintf("'%s' (%s vertices, %s faces)", mName.toLocal8Bit().data(),
+            QLocale::system().toString((long long)mPlyMesh->getVertexCount()).toLocal8Bit().data(),
+            QLocale::system().toString((long long)mPlyMesh->getFaceCount()).toLocal8Bit().data());
+
+    if(mPlyMesh->isMissingData()) {
+        modelInfo += QString::asprintf(" - Missing: %s%s%s",
+                    (mPlyMesh->withNormals()?"":"surface normals, "),
+                    (mPlyMesh->withColors()?"":"vertex colors, "),
+                    (mPlyMesh->withTexCoords()?"":"texture coords, "));
+        modelInfo = modelInfo.left(modelInfo.length() - 3);
+    }
+
+    // Report faces and vertices that do not add to the surface
+    const PLYMeshData::MeshStats& lStats = mPlyMesh->getStats();
+    if(lStats.mDegenerateFaces > 0 || lStats.mUnreferencedVertices > 0) {
+        modelInfo += QString::asprintf(" - %s degenerate faces, %s unreferenced vertices",
+                    QLocale::system().toString((long long)lStats.mDegenerateFaces).toLocal8Bit().data(),
+                    QLocale::system().toString((long long)lStats.mUnreferencedVertices).toLocal8Bit().data());
+    }
+
+    mGUI->statusLabel->setText(modelInfo);
+    emit meshReady();
+}
+
+void GLModelWidget::texturesLoaded(int pLoad, QVector<QImage> pTextures) {
+    if (pLoad != mLoadCount) { return; }
+
+    for(int i=0; i<4; i++) {
+        mPngTextures[i] = pTextures[i];
+    }
+    mGUI->modelViewer->setTextures(mPngTextures);
+    emit texturesReady();
+}
+
+void GLModelWidget::replacePreview(PLYMeshData* pPreview) {
+    // The old preview is no longer drawn, so its buffers can go
+    if (mPreviewMesh != nullptr) {
+        mGUI->modelViewer->makeCurrent();
+        delete mPreviewMesh;
+    }
+    mPreviewMesh = pPreview;
+}
+
+void GLModelWidget::replaceMesh(PLYMeshData* pMesh) {
+    // Setting a mesh starts building its levels of detail, so the build for the old
+    // mesh is stopped first, and the old mesh goes once the new one is drawn
+    PLYMeshData* lOldMesh = mPlyMesh;
+    if (lOldMesh != nullptr) {
+        mGUI->modelViewer->cancelLevelsOfDetail();
+    }
+    mPlyMesh = pMesh;
+    mGUI->modelViewer->setModelData(pMesh != nullptr ? mPngTextures : nullptr, pMesh);
+    if (lOldMesh != nullptr && lOldMesh != pMesh) {
+        mGUI->modelViewer->makeCurrent();
+        delete lOldMesh;
+    }
 }
 
 void GLModelWidget::on_renderModeComboBox_currentIndexChanged(int index) {
@@ -113,6 +238,10 @@ void GLModelWidget::on_renderModeComboBox_currentIndexChanged(int index) {
     else { mGUI->modelViewer->setRenderMode(index-2); }
 }
 
+void GLModelWidget::on_compactVerticesCheckBox_toggled(bool checked) {
+    mGUI->modelViewer->setCompactVertices(checked);
+}
+
 QImage GLModelWidget::readTexture(QString pTextureFilename, QFileInfo pArchiveFile) {
     QIODevice* lFileDev = nullptr;
     if(pArchiveFile.filePath() != "") {
@@ -143,28 +272,10 @@ QImage GLModelWidget::readTexture(QString pTextureFilename, QFileInfo pArchiveFi
 }
 
 void GLModelWidget::dataLoadingFinished() {
-    if(!mDataLoading->future().result() || mPlyMesh == nullptr) {
+    // Each stage was shown as it was loaded, so only a failure is left to report
+    if(!mDataLoading->future().result()) {
+        replaceMesh(nullptr);
+        replacePreview(nullptr);
         mGUI->statusLabel->setText("There was an error loading the model.");
-    } else {
-
-        QString modelInfo = QString::asprintf("'%s' (%s vertices, %s faces)", mName.toLocal8Bit().data(),
-                QLocale::system().toString((long long)mPlyMesh->getVertexCount()).toLocal8Bit().data(),
-                QLocale::system().toString((long long)mPlyMesh->getFaceCount()).toLocal8Bit().data());
-
-        if(mPlyMesh->isMissingData()) {
-            modelInfo += QString::asprintf(" - Missing: %s%s%s",
-                        (mPlyMesh->withNormals()?"":"surface normals, "),
-                        (mPlyMesh->withColors()?"":"vertex colors, "),
-                        (mPlyMesh->withTexCoords()?"":"texture coords, "));
-            modelInfo = modelInfo.left(modelInfo.length() - 3);
-        }
-
-        mGUI->statusLabel->setText(modelInfo);
-//        if(mPngTextures[0] == nullptr) {
-            mGUI->modelViewer->setModelData(nullptr, mPlyMesh);
-//        } else {
-//            mGUI->modelViewer->setModelData(mPngTextures, mPlyMesh);
-//        }
-
     }
 }
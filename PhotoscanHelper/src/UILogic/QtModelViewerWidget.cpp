@@ -5,9 +5,15 @@
 #include <QOpenGLFunctions>
 
 #include <QMatrix4x4>
+#include <QVector3D>
 #include <QMouseEvent>
 #include <QWheelEvent>
 #include <QTimer>
+#include <QtConcurrent>
+#include <QtMath>
+
+#include <algorithm>
+#include <cmath>
 
 #include "QtModelViewerWidget.h"
 
@@ -15,6 +21,15 @@
 
 DEFINE_ENUM(RenderMode, RENDER_MODE_ENUM, QtModelViewerWidget)
 
+// Vertical field of view of the camera, in degrees
+static const float VIEW_ANGLE = 42.0f;
+
+// Largest error (in pixels) of a level of detail drawn while the view moves
+static const float MAX_LOD_PIXEL_ERROR = 2.0f;
+
+// The view counts as moving for this long after the last mouse event (ms)
+static const qint64 INTERACTION_MSECS = 300;
+
 QtModelViewerWidget::QtModelViewerWidget(QWidget* parent) : QOpenGLWidget(parent), mUniformColor(255, 255, 255) {
     setFormat(QSurfaceFormat::defaultFormat());
     mCamZPos = 5.0f;
@@ -22,6 +37,7 @@ QtModelViewerWidget::QtModelViewerWidget(QWidget* parent) : QOpenGLWidget(parent
 
     mMeshData = nullptr;
     mRenderMode = RENDER_SHADED;
+    mCompactVertices = false;
     mTexturedShader = nullptr;
     mCubeVBuffer = mCubeElemBuffer = nullptr;
     mCubeVAO = new QOpenGLVertexArrayObject(this);
@@ -37,9 +53,17 @@ QtModelViewerWidget::QtModelViewerWidget(QWidget* parent) : QOpenGLWidget(parent
 
     mTrackball = new QtTrackball(QtTrackball::TRACKMODE_SPHERE, 0.02f);
     mTrackballEnabled = true; mRotating = false;
+
+    // Levels of detail are built off the GUI thread
+    mLODMesh = nullptr;
+    mLODCancel = false;
+    mButtonsDown = Qt::NoButton;
+    mLODBuilding = new QFutureWatcher<std::vector<MeshLOD> >(this);
+    connect(mLODBuilding, &QFutureWatcher<std::vector<MeshLOD> >::finished, this, &QtModelViewerWidget::lodsFinished);
 }
 
 QtModelViewerWidget::~QtModelViewerWidget() {
+    cancelLevelsOfDetail();
     delete mTrackball;
 }
 
@@ -78,11 +102,52 @@ void QtModelViewerWidget::setModelData(QImage pColorTexture[], PLYMeshData *pMes
     mMeshData = pMeshData;
     if (mMeshData != nullptr) {
         makeCurrent();
+        mMeshData->setVertexLayout(mCompactVertices ? PLYMeshData::LAYOUT_COMPACT : PLYMeshData::LAYOUT_FULL);
         mMeshData->buildBuffers(QOpenGLContext::currentContext());
-        mMeshData->buildTextures();
+        if (pColorTexture != nullptr) {
+            mMeshData->buildTextures(pColorTexture);
+        } else {
+            mMeshData->buildTextures();
+        }
+
+        // Simplify in the background; full detail is drawn until the levels are ready
+        if (mMeshData->getLODCount() == 0 && !mMeshData->isPointPreview()) {
+            PLYMeshData* lMesh = mMeshData;
+            std::atomic<bool>* lCancel = &mLODCancel;
+            mLODMesh = lMesh;
+            mLODBuilding->setFuture(QtConcurrent::run([lMesh, lCancel]() { return lMesh->simplify(lCancel); }));
+        }
     }
 }
 
+void QtModelViewerWidget::cancelLevelsOfDetail() {
+    // The build checks the flag between collapses, so this wait is short
+    mLODCancel = true;
+    mLODBuilding->waitForFinished();
+    mLODCancel = false;
+    mLODMesh = nullptr;
+}
+
+void QtModelViewerWidget::lodsFinished() {
+    // The levels are dropped if another mesh was set in the meantime
+    if (mLODMesh == nullptr || mLODMesh != mMeshData) { return; }
+    mLODMesh = nullptr;
+
+    makeCurrent();
+    mMeshData->setLODs(mLODBuilding->result());
+    mMeshData->rebuildIndexBuffer();
+    qInfo("%d levels of detail ready", mMeshData->getLODCount());
+    update();
+    emit levelsOfDetailReady();
+}
+
+void QtModelViewerWidget::setTextures(QImage pColorTexture[]) {
+    if (mMeshData == nullptr) { return; }
+    makeCurrent();
+    mMeshData->buildTextures(pColorTexture);
+    update();
+}
+
 void QtModelViewerWidget::setRenderMode(int index) {
     if(index < 0 || index >= RENDER_COUNT) { return; }
     mRenderMode = (RenderMode)(RENDER_SINGLE_COLOR + index);
@@ -90,6 +155,20 @@ void QtModelViewerWidget::setRenderMode(int index) {
     update();
 }
 
+void QtModelViewerWidget::setCompactVertices(bool pCompact) {
+    mCompactVertices = pCompact;
+    qInfo("Vertex layout changed to %s", (pCompact ? "compact" : "full"));
+
+    // Rebuild the buffers of the current mesh in the new layout
+    if (mMeshData != nullptr) {
+        makeCurrent();
+        mMeshData->destroyBuffers();
+        mMeshData->setVertexLayout(pCompact ? PLYMeshData::LAYOUT_COMPACT : PLYMeshData::LAYOUT_FULL);
+        mMeshData->buildBuffers(QOpenGLContext::currentContext());
+    }
+    update();
+}
+
 void QtModelViewerWidget::setFlatColor(QColor newColor) {
     mUniformColor = newColor;
     update();
@@ -98,6 +177,9 @@ void QtModelViewerWidget::setFlatColor(QColor newColor) {
 QColor QtModelViewerWidget::getFlatColor() const { return mUniformColor; }
 
 void QtModelViewerWidget::mousePressEvent(QMouseEvent* event) {
+    mButtonsDown = event->buttons();
+    mLastInteraction.start();
+
     if(mTrackballEnabled) {
         if (event->button() == Qt::LeftButton) {
             mTrackball->push(normalizeAndCenterPixelPos(event->pos()));
@@ -110,6 +192,9 @@ void QtModelViewerWidget::mousePressEvent(QMouseEvent* event) {
 }
 
 void QtModelViewerWidget::mouseReleaseEvent(QMouseEvent* event) {
+    mButtonsDown = event->buttons();
+    mLastInteraction.start();
+
     if(mTrackballEnabled) {
         if (event->button() == Qt::LeftButton) {
             mTrackball->release(normalizeAndCenterPixelPos(event->pos()), mTrackball->rotation().conjugated());
@@ -121,6 +206,11 @@ void QtModelViewerWidget::mouseReleaseEvent(QMouseEvent* event) {
 }
 
 void QtModelViewerWidget::mouseMoveEvent(QMouseEvent* event) {
+    mButtonsDown = event->buttons();
+    if (mButtonsDown != Qt::NoButton) {
+        mLastInteraction.start();
+    }
+
     if (mTrackballEnabled) {
         if((event->buttons() & Qt::LeftButton) != 0) {
             mTrackball->move(normalizeAndCenterPixelPos(event->pos()), mTrackball->rotation().conjugated());
@@ -141,6 +231,7 @@ void QtModelViewerWidget::mouseMoveEvent(QMouseEvent* event) {
 }
 
 void QtModelViewerWidget::wheelEvent(QWheelEvent *event) {
+    mLastInteraction.start();
     adjustCameraPosition(event->delta()/1200.0f);
 }
 
@@ -279,6 +370,9 @@ void QtModelViewerWidget::initializeGL() {
         mColorTexLoc[2] = mTexturedShader->uniformLocation("colorTex2");
         mColorTexLoc[3] = mTexturedShader->uniformLocation("colorTex3");
         mRenderModeLoc = mTexturedShader->uniformLocation("renderMode");
+        mPositionOffsetLoc = mTexturedShader->uniformLocation("positionOffset");
+        mPositionScaleLoc = mTexturedShader->uniformLocation("positionScale");
+        mOctNormalsLoc = mTexturedShader->uniformLocation("octahedralNormals");
 
         // Setup default values
         mTexturedShader->setUniformValue(mColorTexLoc[0], 0);
@@ -298,7 +392,7 @@ void QtModelViewerWidget::resizeGL(int w, int h) {
     glViewport(0, 0, w-1, h-1);
 
     mPersp.setToIdentity();
-    mPersp.perspective(42.0f, w/(float)h, 0.01f, 100.0f);
+    mPersp.perspective(VIEW_ANGLE, w/(float)h, 0.01f, 100.0f);
 }
 
 void QtModelViewerWidget::paintGL() {
@@ -338,6 +432,11 @@ void QtModelViewerWidget::drawExampleCube() {
     mTexturedShader->setUniformValue(mColorUniformLoc, mUniformColor);
     mTexturedShader->setUniformValue(mRenderModeLoc, (int)mRenderMode);
 
+    // The cube is always made of floats
+    mTexturedShader->setUniformValue(mPositionOffsetLoc, QVector3D(0.0f, 0.0f, 0.0f));
+    mTexturedShader->setUniformValue(mPositionScaleLoc, QVector3D(1.0f, 1.0f, 1.0f));
+    mTexturedShader->setUniformValue(mOctNormalsLoc, false);
+
     // Enable the vertex array VBOs
     glEnableVertexAttribArray(PLYMeshData::ATTRIB_LOC_VERTEX);
     glEnableVertexAttribArray(PLYMeshData::ATTRIB_LOC_NORMAL);
@@ -375,9 +474,20 @@ void QtModelViewerWidget::drawMesh() {
     mTexturedShader->setUniformValue(mViewLoc, mView);
     mTexturedShader->setUniformValue(mNormalMatLoc, mModel.normalMatrix());
 
-    // Set other uniform values
+    // Set other uniform values (a point preview has no normals or texture coordinates to draw with)
+    RenderMode lRenderMode = mRenderMode;
+    if (mMeshData->isPointPreview()) {
+        lRenderMode = (mMeshData->withColors() ? RENDER_VERTEX_COLOR : RENDER_SINGLE_COLOR);
+    }
     mTexturedShader->setUniformValue(mColorUniformLoc, mUniformColor);
-    mTexturedShader->setUniformValue(mRenderModeLoc, (int)mRenderMode);
+    mTexturedShader->setUniformValue(mRenderModeLoc, (int)lRenderMode);
+
+    // Set the decoding of the vertex layout
+    float lOffset[3], lScale[3];
+    mMeshData->getPositionDecode(lOffset, lScale);
+    mTexturedShader->setUniformValue(mPositionOffsetLoc, QVector3D(lOffset[0], lOffset[1], lOffset[2]));
+    mTexturedShader->setUniformValue(mPositionScaleLoc, QVector3D(lScale[0], lScale[1], lScale[2]));
+    mTexturedShader->setUniformValue(mOctNormalsLoc, mMeshData->getBufferLayout() == PLYMeshData::LAYOUT_COMPACT);
 
     // Bind the color textures
 //    for(int i=0; i<4; i++) {
@@ -391,9 +501,15 @@ void QtModelViewerWidget::drawMesh() {
     if(mMeshData->withColors()) { mTexturedShader->enableAttributeArray(PLYMeshData::ATTRIB_LOC_COLORS); }
     if(mMeshData->withTexCoords()) { mTexturedShader->enableAttributeArray(PLYMeshData::ATTRIB_LOC_TEXCOR); }
 
-    // Draw the face index elements
+    // Draw the face index elements (of a level of detail while the view moves), or the preview points
     mMeshData->bindTextures(GL);
-    GL->glDrawArrays(GL_TRIANGLES, 0, (GLsizei)mMeshData->getFaceCount()*3);
+    if (mMeshData->isPointPreview()) {
+        GL->glDrawArrays(GL_POINTS, 0, (GLsizei)mMeshData->getPackedCount());
+    } else {
+        int lLOD = pickLOD();
+        GL->glDrawElements(GL_TRIANGLES, (GLsizei)mMeshData->getIndexCount(lLOD), mMeshData->getIndexType(),
+                           (void*)mMeshData->getIndexOffset(lLOD));
+    }
 
     // Disable the attribute arrays
     mTexturedShader->disableAttributeArray(PLYMeshData::ATTRIB_LOC_VERTEX);
@@ -402,6 +518,27 @@ void QtModelViewerWidget::drawMesh() {
     if(mMeshData->withTexCoords()) { mTexturedShader->disableAttributeArray(PLYMeshData::ATTRIB_LOC_TEXCOR); }
 }
 
+int QtModelViewerWidget::pickLOD() const {
+    // Full detail once the view has settled
+    bool lMoving = (mButtonsDown != Qt::NoButton) ||
+            (mLastInteraction.isValid() && mLastInteraction.elapsed() < INTERACTION_MSECS);
+    if (!lMoving || mMeshData->getLODCount() == 0) { return -1; }
+
+    // Pixels covered by one model unit at the front of the (unit sized) model
+    float lDistance = std::max(mCamZPos - 1.0f, 0.1f);
+    float lPixelsPerUnit = mMeshData->getUnitScale() * height() /
+            (2.0f * std::tan(qDegreesToRadians(VIEW_ANGLE/2.0f)) * lDistance);
+
+    // The levels go from fine to coarse; take the coarsest one that still looks right
+    int lLOD = -1;
+    for (int i=0; i<mMeshData->getLODCount(); i++) {
+        if (mMeshData->getLODError(i) * lPixelsPerUnit <= MAX_LOD_PIXEL_ERROR) {
+            lLOD = i;
+        }
+    }
+    return lLOD;
+}
+
 // Example Cube Full VBO data packed in one array
 const float QtModelViewerWidget::EXAMPLE_CUBE_PACKED_DATA[] = {
 /*	   Vertex Location		 |	   Surface Normal	 	 |	    Vertex Color	 |   Tex Coords   w/  index  */
@@ -21,6 +21,16 @@ SOURCES += \
     src/header.cpp \
     src/io.cpp \
     src/object.cpp \
+    src/plan.cpp \
+    src/layouts.cpp \
+    src/byteswap.cpp \
+    src/parallel.cpp \
+    src/probe.cpp \
+    src/readahead.cpp \
+    src/gzip.cpp \
+    src/scanner.cpp \
+    src/arena.cpp \
+    src/column.cpp \
     src/unknown.cpp \
     src/ply_impl.cpp \
 
@@ -29,5 +39,15 @@ HEADERS += \
     include/header.h \
     include/io.h \
     include/object.h \
+    include/plan.h \
+    include/layouts.h \
+    include/byteswap.h \
+    include/parallel.h \
+    include/probe.h \
+    include/readahead.h \
+    include/gzip.h \
+    include/scanner.h \
+    include/arena.h \
+    include/column.h \
     include/unknown.h \
     include/ply_impl.h \
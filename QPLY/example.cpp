@@ -131,7 +131,7 @@ void write_ply(const char* name) {
 #endif
 	
 #ifdef TOFILE
-	writer.close_file();
+	ok = writer.close_file() && ok;
 #endif
 	if (!ok)
 		exit(-1);
@@ -245,7 +245,7 @@ void copy_ply(const char* name) {
 	
 	// Store the data from the mesh.
 	ok = writer.write_data(&store);
-	writer.close_file();
+	ok = writer.close_file() && ok;
 	if (!ok)
 		exit(-1);
 
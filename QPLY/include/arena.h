@@ -0,0 +1,63 @@
+// A C++ reader/writer of .ply files.
+// Arena allocation.
+// This hands out memory from large blocks that are
+// released together, for the many small objects of
+// generic data.
+
+
+#ifndef __PLY_ARENA_H__
+#define __PLY_ARENA_H__
+
+
+#include <cstddef>
+#include <vector>
+
+namespace PLY {
+	/// A monotonic allocator that releases all its memory at once.
+	/** Memory is handed out from large blocks, so that many
+	 *  small allocations cost little more than moving a
+	 *  pointer and do not fragment the heap. Memory is never
+	 *  returned to the Arena on its own; it is all released
+	 *  together by release or the destructor. Objects made in
+	 *  the Arena are not destroyed, so they should not own
+	 *  anything outside it.
+	 */
+	struct Arena {
+		/// Default constructor (no memory).
+		Arena(): current(0), used(0), capacity(0), total(0) {}
+		~Arena() { release(); }			///< Destructor.
+
+		/// Allocate memory.
+		/** \param bytes the number of bytes.
+		 *  \param align the alignment of the memory, a power of two.
+		 *  \return the memory, which remains valid until release.
+		 */
+		void* allocate(size_t bytes, size_t align = alignof(std::max_align_t));
+
+		/// Allocate an array.
+		/** Note that the items are not initialized.
+		 *  \param count the number of items.
+		 *  \return the first item.
+		 */
+		template < class T >
+		T* allocate_array(size_t count) { return (T*)allocate(count * sizeof(T), alignof(T)); }
+
+		/// Release all memory.
+		void release();
+
+		/// Get the number of bytes handed out since the last release.
+		size_t size() const { return total; }
+
+	private:
+		Arena(const Arena&) {}			// Private copy constructor to protect the blocks.
+
+		std::vector<char*> blocks;		// The blocks of memory.
+		char* current;					// The block being handed out.
+		size_t used;					// The bytes handed out from the current block.
+		size_t capacity;				// The size of the current block.
+		size_t total;					// The bytes handed out from all blocks.
+	}; // struct Arena
+} // namespace PLY
+
+
+#endif // __PLY_ARENA_H__
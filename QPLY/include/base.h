@@ -132,6 +132,12 @@ namespace PLY {
 	/// The maximum number of characters in a line to read.
 	const int BIG_STRING = 4096;
 
+	/// The number of bytes to read at once when decoding blocks of rows.
+	const size_t BLOCK_BYTES = 1 << 20;
+
+	/// The number of rows to encode at once when writing blocks of rows.
+	const size_t BLOCK_ROWS = 1 << 14;
+
 	/// Variable types supported by PLY format.
 	enum Variable_type {SCALAR =	0,	///< Scalar value
 						LIST =  	1,	///< List of scalars
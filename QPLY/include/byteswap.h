@@ -0,0 +1,49 @@
+// A C++ reader/writer of .ply files.
+// Byte order conversion.
+// These reverse the bytes of every value in blocks
+// of fixed-size rows at once, using SSSE3 or AVX2
+// byte shuffles where the processor supports them.
+
+
+#ifndef __PLY_BYTESWAP_H__
+#define __PLY_BYTESWAP_H__
+
+
+#include <cstddef>
+#include <vector>
+
+namespace PLY {
+	/// A byte permutation that reverses every value in rows of a fixed layout.
+	/** The permutation repeats every lcm(stride, 16) bytes,
+	 *  so a block of rows is converted with one shuffle for
+	 *  each of the 16-byte groups around each output group.
+	 */
+	struct RowSwap {
+		/// Default constructor (no layout).
+		RowSwap(): stride(0), period(0) {}
+
+		/// Prepare for rows made of consecutive values.
+		/** \param sizes the number of bytes of each value in a row.
+		 */
+		void compile(const std::vector<size_t>& sizes);
+
+		/// Check whether a layout has been prepared.
+		bool valid() const { return stride != 0; }
+
+		/// Reverse the bytes of every value in a block of rows.
+		/** \param rows the raw bytes of the rows.
+		 *  \param count the number of rows.
+		 *  \param [out] out the converted rows, which must not overlap rows.
+		 */
+		void apply(const char* rows, size_t count, char* out) const;
+
+	private:
+		size_t stride;					// The number of bytes in a row.
+		std::vector<unsigned int> order;	// The source of each byte in a row.
+		size_t period;					// The length of the shuffle masks (0: no shuffles).
+		std::vector<char> masks;		// The shuffles of the previous, current and next 16 bytes.
+	}; // struct RowSwap
+} // namespace PLY
+
+
+#endif // __PLY_BYTESWAP_H__
@@ -0,0 +1,220 @@
+// A C++ reader/writer of .ply files.
+// Columnar storage.
+// These keep the values of each Property of an
+// Element in one contiguous typed array, instead
+// of one polymorphic Object per row.
+
+
+#ifndef __PLY_COLUMN_H__
+#define __PLY_COLUMN_H__
+
+
+#include "object.h"
+
+namespace PLY {
+	/// All values of one Property, stored contiguously.
+	/** Scalar values are stored as an array of type.
+	 *  List and string values are stored as the items
+	 *  of all rows after each other, where the items of
+	 *  row n are found between offsets[n] and offsets[n+1].
+	 *  The characters of a string (including the '\0')
+	 *  are stored as Int8 items.
+	 */
+	struct Column {
+		Property prop;					///< The Property described.
+		Scalar_type type;				///< How the values are stored in memory.
+		std::vector<char> values;		///< The raw values (or list items).
+		std::vector<size_t> offsets;	///< The first item of each row (lists and strings only).
+
+		/// Construct from a Property.
+		/** The values are stored using the type of the file,
+		 *  unless changed using ColumnArray::set_type.
+		 *  \param p the Property to store.
+		 */
+		Column(const Property& p): prop(p), type(p.type == STRING ? Int8 : p.data_type) {}
+
+		/// Check whether each row holds a single value.
+		bool scalar() const { return prop.type == SCALAR; }
+
+		/// Get the number of bytes of one value.
+		size_t value_bytes() const { return ply_type_bytes[type]; }
+
+		/// Get the number of rows.
+		size_t rows() const { return scalar() ? values.size() / value_bytes() : offsets.size() - 1; }
+
+		/// Prepare the Column to contain a number of rows.
+		/** Scalar values are zero-initialized; list rows
+		 *  are empty until their size is set.
+		 *  \param num the number of rows.
+		 */
+		void prepare(size_t num);
+
+		/// Remove all rows.
+		void clear();
+
+		/// Get the number of list items of a row.
+		size_t size(size_t row) const { return offsets[row+1] - offsets[row]; }
+
+		/// Set the number of list items of a row.
+		/** Rows must be sized in order, as the items of
+		 *  all rows are stored after each other.
+		 *  \param row the row to size.
+		 *  \param size the number of items.
+		 */
+		void set_size(size_t row, size_t size);
+
+		/// Get a value as double.
+		/** \param index the index of the value (or list item).
+		 *  \return the value.
+		 */
+		double get(size_t index) const;
+
+		/// Set a value from a double.
+		/** \param index the index of the value (or list item).
+		 *  \param value the value.
+		 */
+		void set(size_t index, double value);
+
+		/// Get the values as a typed array.
+		/** \return the array or nullptr if the values are
+		 *  not stored as T.
+		 */
+		template < class T >
+		T* data() { return type == scalar_type_of<T>::type ? (T*)values.data() : nullptr; }
+		template < class T >
+		const T* data() const { return type == scalar_type_of<T>::type ? (const T*)values.data() : nullptr; }
+
+		/// Get the list items of a row as a typed array.
+		/** \param row the row.
+		 *  \return the first item or nullptr if the items
+		 *  are not stored as T.
+		 */
+		template < class T >
+		const T* items(size_t row) const { const T* ptr = data<T>(); return ptr ? ptr + offsets[row] : nullptr; }
+	}; // struct Column
+
+
+	/// A Value referring to one row of a Column.
+	struct ColumnValue: public Value {
+		Column* column;					///< The Column containing the value.
+		const size_t* row;				///< The row of the value.
+
+		/// Construct for a Column.
+		/** \param c the Column.
+		 *  \param r the row, which is shared by the Values of an Object.
+		 */
+		ColumnValue(Column* c, const size_t* r): column(c), row(r) {}
+
+		bool get_scalar(const Property& prop, double& value) const;
+		bool set_scalar(const Property& prop, const double& value);
+		bool get_size(const Property& prop, size_t& size) const;
+		bool get_item(const Property& prop, const size_t& num, double& value) const;
+		bool set_size(const Property& prop, const size_t& size);
+		bool set_item(const Property& prop, const size_t& num, const double& value);
+		bool get_string(const Property& prop, char* str) const;
+		bool set_string(const Property& prop, const char* str);
+	}; // struct ColumnValue
+
+
+	/// An Object referring to one row of a ColumnArray.
+	/** This lets the Reader and Writer handle a
+	 *  ColumnArray through the generic Object interface.
+	 */
+	struct ColumnObject: public Object {
+		size_t row;						///< The row referred to.
+		std::vector<ColumnValue> values;	///< One Value for each Column.
+
+		/// Default constructor.
+		ColumnObject(): row(0), hint(0) {}
+
+		Value* get_value(const Element& elem, const Property& prop);
+
+	private:
+		size_t hint;					// The Value most likely to be requested next.
+	}; // struct ColumnObject
+
+
+	/// An Array storing the [Objects](\ref Object) of an Element by Property.
+	/** Note that this Array has a Column for each
+	 *  Property of the Element it was constructed for.
+	 *  Properties that are not stored get no values
+	 *  and no Value in the proxy Object.
+	 */
+	struct ColumnArray: public Array {
+		Element elem;					///< The Element described.
+		std::vector<Column> columns;	///< One Column for each Property.
+
+		/// Construct for an Element.
+		/** \param e the Element to store.
+		 */
+		ColumnArray(const Element& e);
+
+		size_t size() { return num; }
+		void prepare(const size_t& size);
+		void clear();
+		void restart() { incr = 0; }
+		Object& next_object();
+		bool bind(const Element& elem, ElementPlan& plan);
+		bool bind_list(const Element& elem, const Property& prop,
+			const std::vector<size_t>& sizes, Binding& dest);
+		bool bind_uniform_list(const Element& elem, const Property& prop,
+			size_t size, Binding& dest);
+		bool view(const Element& elem, ElementPlan& plan);
+
+		/// Find the Column of a Property.
+		/** \param name the name of the Property.
+		 *  \return the Column or nullptr if there is no such Property.
+		 */
+		Column* find(const char* name);
+
+		/// Change how the values of a Property are stored in memory.
+		/** This should be done before any rows are added.
+		 *  \param name the name of the Property.
+		 *  \param type the type to store the values as.
+		 *  \return true if the Property exists and is not a string.
+		 */
+		bool set_type(const char* name, Scalar_type type);
+
+		/// Get the values of a Property as a typed array.
+		/** \param name the name of the Property.
+		 *  \return the array or nullptr if there is no such Property
+		 *  or it is not stored as T.
+		 */
+		template < class T >
+		T* data(const char* name) { Column* col = find(name); return col ? col->data<T>() : nullptr; }
+
+	private:
+		ColumnArray(const ColumnArray&) {}	// Private copy constructor to protect the proxy.
+
+		ColumnObject object;			// The proxy for the current row.
+		size_t num;						// The number of rows.
+		size_t incr;					// The next row to get.
+	}; // struct ColumnArray
+
+
+	/// A Storage that keeps every Element in a ColumnArray.
+	/** This is an alternative to one Object per row,
+	 *  which costs a vtable pointer per Value and
+	 *  spreads the values of a Property over memory.
+	 */
+	struct ColumnStorage: public Storage {
+		/// Construct for a Header.
+		/** A ColumnArray is set for each Element.
+		 *  \param header the Header that describes the data.
+		 */
+		ColumnStorage(const Header& header);
+		~ColumnStorage();				///< Destructor.
+
+		/// Get the columns of an Element.
+		/** \param name the name of the Element.
+		 *  \return the ColumnArray or nullptr if there is no such Element.
+		 */
+		ColumnArray* get_columns(const char* name);
+
+	private:
+		std::vector<ColumnArray*> arrays;	// The collections owned.
+	}; // struct ColumnStorage
+} // namespace PLY
+
+
+#endif // __PLY_COLUMN_H__
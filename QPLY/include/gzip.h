@@ -0,0 +1,120 @@
+// A C++ reader/writer of .ply files.
+// Compressed devices.
+// These read and write gzip-compressed data through
+// the QIODevice interface, so that the Reader and
+// Writer can handle .ply.gz files as any other.
+
+
+#ifndef __PLY_GZIP_H__
+#define __PLY_GZIP_H__
+
+
+#include <QIODevice>
+#include <QString>
+
+#include "readahead.h"
+
+namespace PLY {
+	/// Check whether a file is gzip-compressed, judging by its name.
+	/** \param file_name the name of the file.
+	 *  \return true if the name ends in ".gz".
+	 */
+	bool is_gzip_file(const QString& file_name);
+
+
+	/// A read-only device that inflates gzip-compressed data.
+	/** The data is inflated on the read-ahead thread, so
+	 *  that inflating overlaps with parsing. Concatenated
+	 *  gzip streams are read as one, and zlib streams are
+	 *  recognized as well.
+	 */
+	class InflateDevice: public ReadAheadDevice {
+	public:
+		/// Construct for a compressed device.
+		/** \param dev the device with the compressed data.
+		 *  \param owned whether dev is deleted with this device.
+		 */
+		InflateDevice(QIODevice* dev, bool owned = false);
+		~InflateDevice();				///< Destructor.
+
+		/// Open the device and start inflating.
+		/** The compressed device is opened if it is not open yet.
+		 *  \param mode the mode, which must be ReadOnly.
+		 *  \return true if the device could be opened.
+		 */
+		bool open(OpenMode mode);
+
+		/// Stop inflating and close both devices.
+		void close();
+
+	protected:
+		qint64 fill(char* data, size_t size);
+
+	private:
+		struct Inflater;
+
+		InflateDevice(const InflateDevice&);	// Private copy constructor to protect the stream.
+
+		Inflater* inflater;				// The decompression state (nullptr: closed).
+	}; // class InflateDevice
+
+
+	/// A write-only device that deflates data to gzip.
+	/** Written data is collected in a large buffer and
+	 *  compressed a block at a time. The gzip stream is
+	 *  completed when the device is closed.
+	 */
+	class DeflateDevice: public QIODevice {
+	public:
+		/// Construct for a compressed device.
+		/** \param dev the device to write the compressed data to.
+		 *  \param owned whether dev is deleted with this device.
+		 *  \param level the compression level, from 1 (fastest)
+		 *  to 9 (smallest), or -1 for the zlib default.
+		 */
+		DeflateDevice(QIODevice* dev, bool owned = false, int level = -1);
+		~DeflateDevice();				///< Destructor.
+
+		/// Open the device.
+		/** The compressed device is opened if it is not open yet.
+		 *  \param mode the mode, which must be WriteOnly.
+		 *  \return true if the device could be opened.
+		 */
+		bool open(OpenMode mode);
+
+		/// Complete the gzip stream.
+		/** Compresses the remaining data, writes the gzip trailer
+		 *  and flushes the compressed device. Calling close()
+		 *  without finishing first does the same, but cannot
+		 *  report a failure.
+		 *  \return true if all compressed data was written.
+		 */
+		bool finish();
+
+		/// Complete the gzip stream and close both devices.
+		void close();
+
+		bool isSequential() const { return true; }
+
+	protected:
+		qint64 readData(char* data, qint64 max);
+		qint64 writeData(const char* data, qint64 len);
+
+	private:
+		struct Deflater;
+
+		DeflateDevice(const DeflateDevice&);	// Private copy constructor to protect the stream.
+
+		// Compress the collected data, finishing the stream if asked.
+		bool deflate_input(bool finish);
+
+		QIODevice* device;				// The compressed data.
+		bool owned;						// Whether to delete the compressed device.
+		int level;						// The compression level.
+		Deflater* deflater;				// The compression state (nullptr: closed).
+		bool failed;					// Whether writing the compressed data failed.
+	}; // class DeflateDevice
+} // namespace PLY
+
+
+#endif // __PLY_GZIP_H__
@@ -173,6 +173,23 @@ namespace PLY {
 		 */
 		Element* find_element(const char* name);
 
+		/// Mark all [Elements](\ref Element) and [Properties](\ref Property) as not stored.
+		/** Together with select, this limits reading to the
+		 *  data that is needed. The Reader skips the data
+		 *  that is not stored, seeking past fixed-size rows
+		 *  and reading only the sizes of unneeded lists.
+		 *  This should be done before any Storage is made.
+		 */
+		void select_none();
+
+		/// Mark an Element and some of its [Properties](\ref Property) as stored.
+		/** \param name the name of the Element.
+		 *  \param prop_names the names of the [Properties](\ref Property)
+		 *  to store, or empty to store all of them.
+		 *  \return true if the Element and all named [Properties](\ref Property) exist.
+		 */
+		bool select(const char* name, const std::vector<std::string>& prop_names = std::vector<std::string>());
+
 		/// Apply the stream mode.
 		/** This will adjust a byte-array such that it is
 		 *  read or stored correctly in binary mode.
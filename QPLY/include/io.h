@@ -41,17 +41,44 @@ class QIODevice;
 
 #include <QString>
 
-#include "object.h"
+#include <functional>
+#include <memory>
+
+#include "column.h"
+#include "scanner.h"
 
 namespace PLY {
+	/// A batch of consecutive rows of one Element.
+	/** \sa Reader::next_batch.
+	 */
+	struct Batch {
+		const Element* elem;			///< The Element of the rows.
+		size_t first;					///< The index of the first row in the Element.
+		ColumnArray* rows;				///< The values of the rows, by Property.
+
+		/// Default constructor (no rows).
+		Batch(): elem(0), first(0), rows(0) {}
+	}; // struct Batch
+
+
 	/// The reader for extracting [Objects](\ref Object) from a ply stream.
 	/** \sa Writer.
 	 */
 	struct Reader {
 		Header& header;					///< The Header of the ply file.
-        QTextStream* tStream;           ///< The stream to read from for ASCII data.
+        QTextStream* tStream;           ///< Unused; ASCII data is read through a scanner.
         QIODevice* source;              ///< The data source for binary reading.
         bool srcOwned;                  ///< Are we responsible for 'source'?
+		int threads;					///< The threads used to decode the data (1: serial, 0: all cores).
+
+		/// Called by read_data once all rows of an Element are read.
+		/** The rows of the Element are complete in the store,
+		 *  so they can be used while the next Element is read.
+		 *  It is called on the thread calling read_data, also
+		 *  when the rows are decoded on several threads, as
+		 *  each Element is decoded before the next one starts.
+		 */
+		std::function<void(const Element&)> element_read;
 
 		/// Base constructor.
 		/** In order to be able to share a Header,
@@ -60,7 +87,9 @@ namespace PLY {
 		 *  \param [in,out] h the Header to use.
 		 */
         Reader(Header& h): header(h), tStream(nullptr),
-            source(nullptr), srcOwned(false) {}
+            source(nullptr), srcOwned(false), threads(1),
+            mapped(nullptr), mapped_size(0), mapped_pos(0),
+            batch_rows(0), batch_elem(0), batch_row(0) {}
 
 		/// Construct from existing stream.
 		/** It is assumed that the stream was opened
@@ -71,7 +100,9 @@ namespace PLY {
 		 *  \param [in,out] is the stream to use.
 		 */
         Reader(Header& h, QIODevice* dev): header(h),
-            tStream(nullptr), source(nullptr), srcOwned(false) {
+            tStream(nullptr), source(nullptr), srcOwned(false), threads(1),
+            mapped(nullptr), mapped_size(0), mapped_pos(0),
+            batch_rows(0), batch_elem(0), batch_row(0) {
             use_io_device(dev);
         }
 
@@ -83,7 +114,9 @@ namespace PLY {
 		 */
         Reader(Header& h, const char* file_name):
             header(h), tStream(nullptr),
-            source(nullptr), srcOwned(true) {
+            source(nullptr), srcOwned(true), threads(1),
+            mapped(nullptr), mapped_size(0), mapped_pos(0),
+            batch_rows(0), batch_elem(0), batch_row(0) {
             if (!open_file(file_name)) close_file();
         }
 
@@ -94,12 +127,51 @@ namespace PLY {
         bool use_io_device(QIODevice* dev);
 
 		/// Open a file for reading.
-		/** \param file_name the file to open.
+		/** Files whose name ends in ".gz" are inflated
+		 *  while they are read (see InflateDevice).
+		 *  \param file_name the file to open.
 		 *  \return true if the file could be successfully
 		 *  opened.
 		 */
         bool open_file(QString file_name);
 
+		/// Open a file for reading through a memory map.
+		/** The Header is read as with open_file, after which
+		 *  the file is mapped into memory. Binary data is then
+		 *  decoded by read_data straight from the map, and
+		 *  can be viewed without any copy using span.
+		 *  If the file cannot be mapped, for example because
+		 *  it is compressed, it is read as if opened with
+		 *  open_file (see is_mapped).
+		 *  \param file_name the file to open.
+		 *  \return true if the file could be opened.
+		 */
+		bool map_file(QString file_name);
+
+		/// Check whether the data is read from a memory map.
+		bool is_mapped() const { return mapped != nullptr; }
+
+		/// Get a read-only view of the values of a Property in the memory map.
+		/** This is only possible for binary data in the byte
+		 *  order of the system, for scalar [Properties](\ref Property)
+		 *  of [Elements](\ref Element) with fixed-size rows,
+		 *  and when T matches the type of the Property.
+		 *  The view remains valid until the file is closed.
+		 *  \param elem_name the name of the Element.
+		 *  \param prop_name the name of the Property.
+		 *  \param [out] view the values of the Property.
+		 *  \return true if the view could be made.
+		 */
+		template < class T >
+		bool span(const char* elem_name, const char* prop_name, Span<T>& view) {
+			const char* data;
+			size_t stride, count;
+			if (!locate_span(elem_name, prop_name, scalar_type_of<T>::type, data, stride, count))
+				return false;
+			view = Span<T>(data, stride, count);
+			return true;
+		}
+
 		/// Close the stream.
 		/** Note that this will throw an exception
 		 *  when trying to close a standard io stream.
@@ -114,8 +186,69 @@ namespace PLY {
         /// Use the header file type to construct stream.
         bool init_stream();
 
+		/// Prepare to read the data in batches, instead of using read_data.
+		/** This keeps only one batch of rows of each Element in
+		 *  memory, so that meshes larger than the memory can
+		 *  be processed batch by batch.
+		 *  \param rows the most rows in a batch.
+		 *  \return true if the data stream could be prepared.
+		 */
+		bool start_batches(size_t rows = BLOCK_ROWS);
+
+		/// Get the columns that the batches of an Element are read into.
+		/** This can be used to change how values are stored
+		 *  (see ColumnArray::set_type) before the first batch.
+		 *  \param elem_name the name of the Element.
+		 *  \return the columns or nullptr if there is no such
+		 *  Element or the batches have not been started.
+		 */
+		ColumnArray* batch_columns(const char* elem_name);
+
+		/// Read the next batch of rows.
+		/** The batches follow the order of the data, so all
+		 *  rows of an Element come before those of the next.
+		 *  [Elements](\ref Element) that are not stored are
+		 *  read past without producing batches. The rows of a
+		 *  batch are replaced by the next batch of their Element.
+		 *  \param [out] batch the rows read.
+		 *  \return true if a batch was read, false at the end of
+		 *  the data or on failure (see batches_done).
+		 */
+		bool next_batch(Batch& batch);
+
+		/// Check whether all batches have been read.
+		bool batches_done() const { return batch_elem >= header.elements.size(); }
+
+		/// Continue the batches at the start of an Element.
+		/** This skips straight to an Element whose byte
+		 *  offset in the file is known, for example from
+		 *  a Probe. Only binary data can be skipped this way.
+		 *  \param elem_name the name of the Element.
+		 *  \param offset the byte offset of the Element in the file.
+		 *  \return true if the next batch will be of the Element.
+		 */
+		bool seek_element(const char* elem_name, size_t offset);
+
+		/// Find the byte offset of each Element in the file.
+		/** Only the sizes of lists and strings are read,
+		 *  so this is much faster than reading the data,
+		 *  which it replaces. Only binary data is supported.
+		 *  \param [out] offsets the offset of each Element,
+		 *  followed by the end of the data.
+		 *  \return true if the offsets could be found.
+		 */
+		bool element_offsets(std::vector<size_t>& offsets);
+
 		/// Read the Object data from the current stream.
-		/** \param [out] store where to store the [Objects](\ref Object).
+		/** If threads is not 1, ASCII data is split into
+		 *  ranges of lines that are decoded in parallel.
+		 *  This requires each row to be on a line of its own.
+		 *  Binary rows of a fixed size are likewise decoded
+		 *  in parallel blocks. In a mapped file, rows with
+		 *  lists are first scanned for the sizes of their
+		 *  lists, after which ranges of rows are decoded in
+		 *  parallel as well.
+		 *  \param [out] store where to store the [Objects](\ref Object).
 		 *  \return true if all the data could be successfully read.
 		 */
 		bool read_data(Storage* store);
@@ -130,6 +263,52 @@ namespace PLY {
 		bool read_binary_value(const Scalar_type& type, double& value);
 		void read(char* ptr, size_t n);
 
+		// Read raw bytes, without applying the stream type.
+		bool read_block(char* ptr, size_t n);
+
+		// Read all rows of an Element.
+		bool read_element(Element& elem, Storage* store, ElementPlan& plan);
+
+		// Read a number of rows of an Element one Object at a time.
+		bool read_objects(const Element& elem, Array* collect, size_t num);
+
+		// Read all ASCII data, decoding ranges of lines in parallel.
+		bool read_ascii_parallel(Storage* store);
+
+		// Skip raw bytes, seeking where the device allows it.
+		bool skip_block(size_t n);
+
+		// Skip raw bytes that were just peeked from the device.
+		bool skip_peeked(size_t n);
+
+		// Skip a number of binary rows, reading only the sizes of lists and strings.
+		bool skip_rows(const ElementPlan& plan, size_t num);
+
+		// Skip the value of a Property in a binary row.
+		bool skip_property(const Property& prop);
+
+		// Decode a number of fixed-size rows into their bound destinations.
+		bool read_rows(const ElementPlan& plan, size_t num);
+
+		// Decode fixed-size rows in parallel, a number of rows at a time.
+		bool read_rows_parallel(const ElementPlan& plan, size_t num, size_t rows);
+
+		// Get the sizes of the lists in the next row, without reading it.
+		bool peek_sizes(const Element& elem, std::vector<size_t>& sizes);
+
+		// Read binary rows with lists, in blocks while the lists keep the sizes of the first row.
+		bool read_uniform(const Element& elem, Array* collect, size_t num);
+
+		// Read mapped binary rows with lists, decoding ranges of rows in parallel.
+		bool read_varying(const Element& elem, Array* collect, size_t num);
+
+		// Find the values of a Property in the memory map.
+		bool locate_span(const char* elem_name, const char* prop_name, const Scalar_type& type,
+			const char*& data, size_t& stride, size_t& count);
+
+		// Find the start of each Element in the memory map.
+		bool locate_elements();
+
 		// Read a value.
 		inline bool read_value(const Scalar_type& type, double& value) {
 			if (header.stream_type == ASCII)
@@ -148,7 +327,17 @@ namespace PLY {
 		}
 
 		// Read a string from an ASCII stream.
-		void read_ascii_string(char* str);
+		bool read_ascii_string(char* str);
+
+		AsciiScanner scanner;				// The tokenizer for ASCII data.
+		const char* mapped;					// The memory map of the file (if any).
+		size_t mapped_size;					// The size of the memory map.
+		size_t mapped_pos;					// The current read position in the memory map.
+		std::vector<size_t> elem_offsets;	// The start of each Element in the memory map.
+		std::unique_ptr<ColumnStorage> batches;	// The columns of the current batch of each Element.
+		size_t batch_rows;					// The most rows in a batch.
+		size_t batch_elem;					// The Element of the next batch.
+		size_t batch_row;					// The first row of the next batch.
 	}; // struct Reader
 
 	
@@ -157,9 +346,10 @@ namespace PLY {
 	 */
 	struct Writer {
 		Header& header;					///< The Header to write.
-        QTextStream* tStream;           ///< The stream to write to for ASCII data.
+        QTextStream* tStream;           ///< Unused; all data is written through an internal buffer.
         QIODevice* source;              ///< The data source (nullptr unless we own it).
         bool srcOwned;                  ///< Are we responsible for 'source'?
+		int threads;					///< The threads used to format ASCII data (1: serial, 0: all cores).
 
 		/// Base constructor.
 		/** In order to be able to share a Header,
@@ -168,7 +358,7 @@ namespace PLY {
 		 *  \param [in,out] h the Header to use.
 		 */
         Writer(Header& h): header(h), tStream(nullptr),
-            source(nullptr), srcOwned(false) {}
+            source(nullptr), srcOwned(false), threads(1) {}
 		/// Construct from existing stream.
 		/** It is assumed that the stream was opened
 		 *  correctly. In order to be able to write any
@@ -179,7 +369,7 @@ namespace PLY {
 		 */
         Writer(Header& h, QIODevice* dev, const Stream_type& type = ASCII):
             header(h), tStream(nullptr),
-            source(nullptr), srcOwned(false) {
+            source(nullptr), srcOwned(false), threads(1) {
             use_io_device(dev, type);
         }
 
@@ -191,7 +381,7 @@ namespace PLY {
 		 */
 		Writer(Header& h, const char* file_name, const Stream_type& type = ASCII)
             : header(h), tStream(nullptr),
-              source(nullptr), srcOwned(true) {
+              source(nullptr), srcOwned(true), threads(1) {
             if (!open_file(file_name, type)) close_file();
         }
 
@@ -202,7 +392,9 @@ namespace PLY {
         bool use_io_device(QIODevice* dev, const Stream_type& type = ASCII);
 
 		/// Open a file for writing.
-		/** \param file_name the file to open.
+		/** Files whose name ends in ".gz" are deflated
+		 *  while they are written (see DeflateDevice).
+		 *  \param file_name the file to open.
 		 *  \param type the storage type to use for the data.
 		 *  \return true if the file could be successfully
 		 *  opened.
@@ -210,10 +402,13 @@ namespace PLY {
 		bool open_file(const char* file_name, const Stream_type& type = ASCII);
 
 		/// Close the stream.
-		/** Note that this will throw an exception
+		/** Any buffered data is written first, and a
+		 *  compressed stream is completed.
+		 *  Note that this will throw an exception
 		 *  when trying to close a standard io stream.
+		 *  \return true if all data was written.
 		 */
-		void close_file();
+		bool close_file();
 
 		/// Write the Header to the current stream.
 		/** Note that you should not change the num values
@@ -226,11 +421,79 @@ namespace PLY {
 		/// Write the Object data to the current stream.
 		/** Note that this method writes the Header and all
 		 *  the [Objects](\ref Object) to the stream.
+		 *  The rows of [Arrays](\ref Array) that can be
+		 *  viewed (see Array::view) are encoded in blocks.
 		 *  \param store the [Objects](\ref Object) to store.
 		 *  \return true if all the data could be successfully written.
 		 */
 		bool write_data(Storage* store);
 
+		/// Set the values of a scalar Property to write from memory.
+		/** \param elem_name the name of the Element.
+		 *  \param prop_name the name of the Property.
+		 *  \param values the value of the first row.
+		 *  \param stride the number of bytes between two rows.
+		 *  \return true if the Property exists and is a scalar.
+		 *  \sa write_sources.
+		 */
+		template < class T >
+		bool set_values(const char* elem_name, const char* prop_name, const T* values, size_t stride = sizeof(T)) {
+			return set_source(elem_name, prop_name, Source(Binding((void*)values, stride, scalar_type_of<T>::type)));
+		}
+
+		/// Set the items of a list Property to write from memory.
+		/** \param elem_name the name of the Element.
+		 *  \param prop_name the name of the Property.
+		 *  \param items the items of all rows, after each other.
+		 *  \param offsets the first item of each row, followed by
+		 *  the number of items (num+1 values).
+		 *  \return true if the Property exists and is a list.
+		 *  \sa write_sources.
+		 */
+		template < class T >
+		bool set_lists(const char* elem_name, const char* prop_name, const T* items, const size_t* offsets) {
+			return set_source(elem_name, prop_name, Source(Binding((void*)items, sizeof(T), scalar_type_of<T>::type), offsets));
+		}
+
+		/// Set the items of a list Property of which all lists have the same size.
+		/** This suits for example the indices of triangles.
+		 *  \param elem_name the name of the Element.
+		 *  \param prop_name the name of the Property.
+		 *  \param items the items of all rows, after each other.
+		 *  \param size the number of items of each row.
+		 *  \return true if the Property exists and is a list.
+		 *  \sa write_sources.
+		 */
+		template < class T >
+		bool set_fixed_lists(const char* elem_name, const char* prop_name, const T* items, size_t size) {
+			return set_source(elem_name, prop_name, Source(Binding((void*)items, sizeof(T), scalar_type_of<T>::type), 0, size));
+		}
+
+		/// Write the Header and the data set from memory.
+		/** Each stored Property must have been given its values
+		 *  using set_values, set_lists or set_fixed_lists, and
+		 *  the num of each Element must be set in the Header.
+		 *  The memory must remain valid until this returns.
+		 *  \return true if all the data could be successfully written.
+		 */
+		bool write_sources();
+
+		/// Forget all values set from memory.
+		void clear_sources() { sources.clear(); }
+
+		/// Write a batch of consecutive rows of one Element.
+		/** Together with Reader::next_batch, this converts
+		 *  files that are larger than the memory. The Header
+		 *  must have been written first, and the batches must
+		 *  follow the order of the [Elements](\ref Element),
+		 *  adding up to the num of each. The batch is written
+		 *  to the device before this returns.
+		 *  \param elem the Element of the rows.
+		 *  \param rows the rows to write.
+		 *  \return true if all the rows could be successfully written.
+		 */
+		bool write_batch(const Element& elem, Array* rows);
+
 		/// Write all [Objects](\ref Object) of one Element.
 		/** \param elem the Element of the [Objects](\ref Object).
 		 *  \param collect the [Objects](\ref Object) to write.
@@ -256,9 +519,21 @@ namespace PLY {
 		bool write_binary_value(const Scalar_type& type, const double& value);
 		void write(char* ptr, size_t n);
 
+		// Write the buffered data to the device.
+		bool flush();
+
+		// Encode a number of rows from the sources in the plan.
+		bool write_rows(const ElementPlan& plan, size_t num);
+
+		// Set where the values of a Property are taken from.
+		bool set_source(const char* elem_name, const char* prop_name, const Source& src);
+
 		// Write an element to an ASCII or binary stream.
 		bool write_ascii_object(const Element& elem, Object* obj);
 		bool write_binary_object(const Element& elem, Object* obj);
+
+		std::vector<char> buffer;					// The data waiting to be written.
+		std::vector<std::vector<Source> > sources;	// The values set from memory, per Element and Property.
 	}; // class Writer
 } // namespace PLY
 
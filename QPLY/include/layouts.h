@@ -0,0 +1,37 @@
+// A C++ reader/writer of .ply files.
+// Decoders for known row layouts.
+// These decode the rows written by PhotoScan (and
+// most other mesh exporters) in tight loops made for
+// their exact layout, instead of converting the
+// values one Property at a time.
+
+
+#ifndef __PLY_LAYOUTS_H__
+#define __PLY_LAYOUTS_H__
+
+
+#include "plan.h"
+
+namespace PLY {
+	/// Find a decoder specialized for the layout and destinations of a plan.
+	/** The known layouts are:
+	 *  - vertices of float x, y, z, optionally followed by
+	 *    uchar red, green, blue, where the colors are either
+	 *    all stored as uchar or float, or not stored at all;
+	 *  - uniform faces (see ElementPlan::compile_uniform) of
+	 *    a list uchar int (or uint) of 3 or 4 vertex indices,
+	 *    optionally followed by a list uchar float of 2 texture
+	 *    coordinates for each index.
+	 *
+	 *  The coordinates must be stored as float and the indices
+	 *  and texture coordinates as consecutive int (or uint) and
+	 *  float values. The rows must be in the byte order of the
+	 *  system when they are decoded.
+	 *  \param plan the plan, with its destinations bound.
+	 *  \return the decoder, or nullptr if the layout is not known.
+	 */
+	RowDecoder find_layout_decoder(const ElementPlan& plan);
+} // namespace PLY
+
+
+#endif // __PLY_LAYOUTS_H__
@@ -26,7 +26,9 @@
 #define __PLY_OBJECT_H__
 
 
+#include "arena.h"
 #include "header.h"
+#include "plan.h"
 
 namespace PLY {
 	/// A Value representing a Property.
@@ -113,6 +115,15 @@ namespace PLY {
 		 *  \return true if the Value could be copied.
 		 */
 		bool copy(const Property& prop, Value& to, const Property& to_prop) const;
+
+		/// Locate the scalar value in memory.
+		/** This lets a Reader write decoded values directly
+		 *  into the Value, bypassing set_scalar.
+		 *  \param prop the Property describing the Value.
+		 *  \param [out] bind the address and type of the value.
+		 *  \return true if the value has a fixed, typed location.
+		 */
+		virtual bool locate(const Property& prop, Binding& bind) {return false;}
 	}; // struct Value
 
 
@@ -189,6 +200,63 @@ namespace PLY {
 		 */
 		virtual Object& next_object() = 0;
 		
+		/// Bind typed destinations for the [Objects](\ref Object) of an Element.
+		/** An Array that can receive decoded values directly
+		 *  sets the destination of each scalar Property it
+		 *  stores in the plan, after which the Reader fills all
+		 *  rows in blocks instead of calling next_object for each row.
+		 *
+		 *  This is called after prepare. For [Elements](\ref Element)
+		 *  with lists, the Array should only succeed if it also
+		 *  implements bind_list.
+		 *  \param elem the Element to bind.
+		 *  \param [in,out] plan the compiled plan of the Element.
+		 *  \return true if the destinations were set and the
+		 *  Array holds elem.num [Objects](\ref Object).
+		 */
+		virtual bool bind(const Element& elem, ElementPlan& plan) {return false;}
+
+		/// Bind a typed destination for the items of a list Property.
+		/** This is called after bind, once the size of the list
+		 *  of each row is known. The items of all rows are
+		 *  then stored after each other in the destination.
+		 *  \param elem the Element of the list.
+		 *  \param prop the list Property.
+		 *  \param sizes the size of the list of each row.
+		 *  \param [out] dest where to store the items.
+		 *  \return true if the destination was set.
+		 */
+		virtual bool bind_list(const Element& elem, const Property& prop,
+			const std::vector<size_t>& sizes, Binding& dest) {return false;}
+
+		/// Bind a typed destination for the items of a list Property of uniform size.
+		/** This is called after bind, instead of bind_list, when
+		 *  the rows are decoded in blocks on the assumption
+		 *  that every list has the same size as the first
+		 *  (see ElementPlan::compile_uniform). The items of all
+		 *  rows are stored after each other in the destination.
+		 *  If a list of another size is found after all, the
+		 *  remaining rows are read through next_object.
+		 *  \param elem the Element of the list.
+		 *  \param prop the list Property.
+		 *  \param size the size of each list.
+		 *  \param [out] dest where to store the items.
+		 *  \return true if the destination was set.
+		 */
+		virtual bool bind_uniform_list(const Element& elem, const Property& prop,
+			size_t size, Binding& dest) {return false;}
+
+		/// View the values of the [Objects](\ref Object) of an Element.
+		/** An Array that stores its values in typed arrays
+		 *  sets the source of each Property it stores in the
+		 *  plan, after which the Writer encodes all rows in
+		 *  blocks instead of calling next_object for each row.
+		 *  \param elem the Element to view.
+		 *  \param [in,out] plan the compiled plan of the Element.
+		 *  \return true if every stored Property of elem has a source.
+		 */
+		virtual bool view(const Element& elem, ElementPlan& plan) {return false;}
+
 		/// Get the next Object as a certain type.
 		/** \return the Object.
 		 */
@@ -238,6 +306,7 @@ namespace PLY {
 
 		size_t num;						// The number of collections.
 		bool* unknown;					// The unknown Object collections.
+		Arena arena;					// Where the unknown Objects are allocated.
 	}; // struct Storage
 } // namespace PLY
 
@@ -0,0 +1,35 @@
+// A C++ reader/writer of .ply files.
+// Parallel loops.
+// These spread independent pieces of work, such
+// as ranges of rows, over the global QThreadPool.
+
+
+#ifndef __PLY_PARALLEL_H__
+#define __PLY_PARALLEL_H__
+
+
+#include <cstddef>
+#include <functional>
+
+namespace PLY {
+	/// Run a task for each index in [0, count) on the global QThreadPool.
+	/** The calling thread takes part in the work and only
+	 *  idle pool threads are used, so this is safe to call
+	 *  from a pool thread, even when the pool is busy.
+	 *  The tasks must be independent of each other.
+	 *  \param count the number of tasks.
+	 *  \param task the work to do for one index.
+	 *  \param threads the maximum number of threads to use,
+	 *  including the calling thread (0: as many as possible).
+	 */
+	void parallel_for(size_t count, const std::function<void(size_t)>& task, int threads = 0);
+
+	/// Get the most threads parallel_for uses.
+	/** \param threads the maximum number of threads asked for (0: as many as possible).
+	 *  \return the number of threads, including the calling thread.
+	 */
+	int parallel_threads(int threads);
+} // namespace PLY
+
+
+#endif // __PLY_PARALLEL_H__
@@ -0,0 +1,306 @@
+// A C++ reader/writer of .ply files.
+// Decode plans.
+// These flatten the description of an Element into
+// byte offsets and types, so that whole blocks of
+// rows can be converted without going through the
+// per-value Object interface.
+
+
+#ifndef __PLY_PLAN_H__
+#define __PLY_PLAN_H__
+
+
+#include "byteswap.h"
+#include "header.h"
+#include <cstring>
+
+namespace PLY {
+	/// The Scalar_type matching a C++ type.
+	/** Only the types that can be stored in a ply
+	 *  file have a specialization.
+	 */
+	template < class T > struct scalar_type_of {};
+	template <> struct scalar_type_of<char>				{ static constexpr Scalar_type type = Int8; };
+	template <> struct scalar_type_of<signed char>		{ static constexpr Scalar_type type = Int8; };
+	template <> struct scalar_type_of<short>			{ static constexpr Scalar_type type = Int16; };
+	template <> struct scalar_type_of<int>				{ static constexpr Scalar_type type = Int32; };
+	template <> struct scalar_type_of<unsigned char>	{ static constexpr Scalar_type type = Uint8; };
+	template <> struct scalar_type_of<unsigned short>	{ static constexpr Scalar_type type = Uint16; };
+	template <> struct scalar_type_of<unsigned int>		{ static constexpr Scalar_type type = Uint32; };
+	template <> struct scalar_type_of<float>			{ static constexpr Scalar_type type = Float32; };
+	template <> struct scalar_type_of<double>			{ static constexpr Scalar_type type = Float64; };
+
+
+	/// A typed location in memory for the values of one Property.
+	/** The value of row n is stored at data + n*stride
+	 *  using the in-memory representation of type.
+	 */
+	struct Binding {
+		char* data;			///< The location of the value of the first row.
+		size_t stride;		///< The number of bytes between two rows.
+		Scalar_type type;	///< How the value is stored in memory.
+
+		/// Default constructor (unbound).
+		Binding(): data(0), stride(0), type(StartType) {}
+		/// Instantiated constructor.
+		/** \param d the location of the first value.
+		 *  \param s the number of bytes between two rows.
+		 *  \param t the type of the values.
+		 */
+		Binding(void* d, size_t s, Scalar_type t): data((char*)d), stride(s), type(t) {}
+
+		/// Whether the Binding refers to any memory.
+		bool bound() const { return data != 0; }
+
+		/// Store a value in a row.
+		/** \param row the index of the row.
+		 *  \param value the value, converted to type.
+		 */
+		void set(size_t row, double value) const;
+	}; // struct Binding
+
+
+	/// Where the values of one Property are taken from when writing.
+	/** Scalar values are read from values, one per row.
+	 *  The items of all lists are read from values as well,
+	 *  where the items of row n start at offsets[n] and end
+	 *  at offsets[n+1], or, if there are no offsets, every
+	 *  list has list_size items.
+	 */
+	struct Source {
+		Binding values;			///< The values (or list items) of the rows.
+		const size_t* offsets;	///< The first item of each row (lists only).
+		size_t list_size;		///< The number of items in each list (without offsets).
+
+		/// Default constructor (unbound).
+		Source(): offsets(0), list_size(0) {}
+		/// Instantiated constructor.
+		/** \param v the values.
+		 *  \param o the first item of each row (lists only).
+		 *  \param l the number of items in each list (without offsets).
+		 */
+		Source(const Binding& v, const size_t* o = 0, size_t l = 0): values(v), offsets(o), list_size(l) {}
+
+		/// Whether the Source refers to any values.
+		bool bound() const { return values.type != StartType; }
+
+		/// Whether the Source describes lists.
+		bool list() const { return offsets != 0 || list_size != 0; }
+
+		/// Get the number of items of a row.
+		size_t size(size_t row) const { return offsets ? offsets[row+1] - offsets[row] : list_size; }
+
+		/// Get the index of the first item of a row.
+		size_t first(size_t row) const { return offsets ? offsets[row] : row * list_size; }
+	}; // struct Source
+
+
+	/// A read-only view of the values of one Property in raw row data.
+	/** The values are stored in the file type, without
+	 *  any alignment, so they are loaded through a copy.
+	 */
+	template < class T >
+	struct Span {
+		const char* data;	///< The location of the value of the first row.
+		size_t stride;		///< The number of bytes between two rows.
+		size_t count;		///< The number of rows.
+
+		/// Default constructor (empty).
+		Span(): data(0), stride(0), count(0) {}
+		/// Instantiated constructor.
+		Span(const char* d, size_t s, size_t c): data(d), stride(s), count(c) {}
+
+		/// Get the number of values.
+		size_t size() const { return count; }
+
+		/// Get a value.
+		T operator[](size_t n) const { T value; std::memcpy(&value, data + n*stride, sizeof(T)); return value; }
+	}; // struct Span
+
+
+	/// The layout of one Property inside a row.
+	struct PropertyPlan {
+		size_t offset;		///< Byte offset of the value inside a fixed-size row.
+		Variable_type kind;	///< Whether the Property is a scalar, list or string.
+		Scalar_type type;	///< How the value (or list item) is stored in the file.
+		Scalar_type size_type;	///< How the size of a list is stored in the file.
+		size_t items;		///< The number of items of each list (only in uniform rows).
+		Binding dest;		///< Where the decoded values (or list items) should go.
+		Source source;		///< Where the values to encode come from.
+
+		PropertyPlan(): offset(0), kind(SCALAR), type(StartType), size_type(StartType), items(0) {}
+	}; // struct PropertyPlan
+
+
+	struct ElementPlan;
+
+	/// A function that decodes a block of rows of one known layout.
+	/** \param plan the plan of the rows, with its destinations bound.
+	 *  \param rows the raw bytes of the rows, in the byte order of the system.
+	 *  \param count the number of rows.
+	 *  \param first the index of the first row in the destinations.
+	 *  \sa find_layout_decoder.
+	 */
+	typedef void (*RowDecoder)(const ElementPlan& plan, const char* rows, size_t count, size_t first);
+
+
+	/// A flat description of how the rows of an Element are stored.
+	/** The plan is compiled once from the Element in the
+	 *  Header. An Array that can receive values directly
+	 *  fills in the destinations (see Array::bind), after
+	 *  which blocks of rows can be decoded in one call.
+	 *  Likewise, blocks of rows can be encoded in one call
+	 *  once the sources are filled in (see Array::view).
+	 *  \sa Element and Array.
+	 */
+	struct ElementPlan {
+		bool fixed;							///< Whether all rows have the same size.
+		size_t stride;						///< The size of a row in bytes (only if fixed).
+		std::vector<PropertyPlan> props;	///< One plan for each Property of the Element.
+		RowSwap swap;						///< Reverses the byte order of whole rows (only if fixed).
+		RowDecoder decoder;					///< Decodes rows of a known layout (nullptr: none).
+
+		/// Default constructor.
+		ElementPlan(): fixed(false), stride(0), decoder(nullptr) {}
+
+		/// Compile the plan for an Element.
+		/** Any previous destinations and decoder are cleared.
+		 *  \param elem the Element to describe.
+		 *  \return true if the rows of the Element have a fixed size.
+		 */
+		bool compile(const Element& elem);
+
+		/// Compile the plan for rows whose lists all have the same size.
+		/** Such rows, like the faces of a mesh of triangles,
+		 *  are stored as fixed-size rows in which the size of
+		 *  each list is just another value. They are decoded
+		 *  in blocks, after checking those sizes (see uniform_rows).
+		 *  The items of list n of row r go to item r*items+n
+		 *  of the destination.
+		 *  \param elem the Element to describe.
+		 *  \param sizes the number of items of each list Property
+		 *  (one for each Property, ignored for scalars).
+		 *  \return false if the rows contain strings.
+		 */
+		bool compile_uniform(const Element& elem, const std::vector<size_t>& sizes);
+
+		/// Count the leading rows of a block whose lists have the uniform sizes.
+		/** \param rows the raw bytes of the rows.
+		 *  \param count the number of rows.
+		 *  \param swap whether the bytes of each value must be reversed.
+		 *  \return the number of rows before the first list of another size.
+		 */
+		size_t uniform_rows(const char* rows, size_t count, bool swap) const;
+
+		/// Check whether any Property has a destination.
+		bool any_bound() const;
+
+		/// Select a decoder specialized for the layout of the rows.
+		/** This should be called once the destinations are
+		 *  bound. Rows of a known layout (see layouts.h) are
+		 *  then decoded by a loop made for that layout, while
+		 *  other rows keep going through the generic conversion.
+		 *  \return true if a specialized decoder was found.
+		 */
+		bool specialize();
+
+		/// Decode a block of consecutive fixed-size (or uniform) rows.
+		/** \param rows the raw bytes of the rows.
+		 *  \param count the number of rows.
+		 *  \param first the index of the first row in the destinations.
+		 *  \param swap whether the bytes of each value must be reversed.
+		 */
+		void decode(const char* rows, size_t count, size_t first, bool swap) const;
+
+		/// Decode a block of consecutive rows that vary in size.
+		/** The items of the lists of each Property go to
+		 *  consecutive items of its destination. Strings are
+		 *  skipped. The rows must fit in the available data
+		 *  (see measure).
+		 *  \param rows the raw bytes of the rows.
+		 *  \param count the number of rows.
+		 *  \param first the index of the first row in the destinations.
+		 *  \param [in,out] items the index in the destination of the next
+		 *  list item of each Property (one for each Property, ignored for scalars).
+		 *  \param swap whether the bytes of each value must be reversed.
+		 *  \return the size of the rows in bytes.
+		 */
+		size_t decode_varying(const char* rows, size_t count, size_t first,
+			std::vector<size_t>& items, bool swap) const;
+
+		/// Measure the size of a number of consecutive rows.
+		/** This also works for rows that vary in size,
+		 *  by reading the size of each list and string.
+		 *  \param rows the raw bytes of the rows.
+		 *  \param available the number of bytes available.
+		 *  \param count the number of rows.
+		 *  \param swap whether the bytes of each value must be reversed.
+		 *  \param [out] bytes the size of the rows in bytes.
+		 *  \return true if the rows fit in the available bytes.
+		 */
+		bool measure(const char* rows, size_t available, size_t count, bool swap, size_t& bytes) const;
+
+		/// Encode a block of consecutive rows from their sources.
+		/** Only the [Properties](\ref Property) with a source are written.
+		 *  \param first the index of the first row in the sources.
+		 *  \param count the number of rows.
+		 *  \param swap whether the bytes of each value must be reversed.
+		 *  \param [in,out] out the buffer to append the rows to.
+		 */
+		void encode(size_t first, size_t count, bool swap, std::vector<char>& out) const;
+
+		/// Format a block of consecutive rows from their sources as ASCII.
+		/** Only the [Properties](\ref Property) with a source are written.
+		 *  Each row ends with a newline.
+		 *  \param first the index of the first row in the sources.
+		 *  \param count the number of rows.
+		 *  \param [in,out] out the buffer to append the text to.
+		 */
+		void format(size_t first, size_t count, std::vector<char>& out) const;
+	}; // struct ElementPlan
+
+
+	/// Convert a strided run of values from one type to another.
+	/** \param src the first source value.
+	 *  \param src_stride the number of bytes between two source values.
+	 *  \param src_type the type of the source values.
+	 *  \param [out] dst the first destination value.
+	 *  \param dst_stride the number of bytes between two destination values.
+	 *  \param dst_type the type of the destination values.
+	 *  \param count the number of values to convert.
+	 *  \param swap whether the bytes of each source value must be reversed.
+	 *  \return true if both types are valid.
+	 */
+	bool convert(const char* src, size_t src_stride, Scalar_type src_type,
+		char* dst, size_t dst_stride, Scalar_type dst_type,
+		size_t count, bool swap);
+
+
+	/// Reverse the bytes of a strided run of values.
+	/** \param [in,out] data the first value.
+	 *  \param stride the number of bytes between two values.
+	 *  \param type the type of the values.
+	 *  \param count the number of values.
+	 */
+	void swap_values(char* data, size_t stride, Scalar_type type, size_t count);
+
+
+	/// The most characters written by format_value.
+	const size_t VALUE_CHARS = 32;
+
+	/// Format a value as ASCII text.
+	/** The value is first converted to the type in the file,
+	 *  after which it is written as an integer or as the
+	 *  shortest text that reads back as the same number.
+	 *  A '.' is always used as decimal point.
+	 *  \param src the value.
+	 *  \param src_type the type of the value.
+	 *  \param type the type in the file.
+	 *  \param [out] str the text, of at most VALUE_CHARS characters (no '\0').
+	 *  \return the number of characters written.
+	 */
+	size_t format_value(const char* src, Scalar_type src_type, Scalar_type type, char* str);
+} // namespace PLY
+
+
+#endif // __PLY_PLAN_H__
@@ -14,6 +14,9 @@ struct ScalarValue: public Value {
     bool get_scalar(const Property& prop, double& value) const;
     bool set_scalar(const Property& prop, const double& value);
 
+    // Direct access for block decoding
+    bool locate(const Property& prop, Binding& bind);
+
     // Single value member
     T val;
 };
@@ -26,6 +29,34 @@ typedef ScalarValue<int> IntValue;
 typedef ScalarValue<float> FloatValue;
 typedef ScalarValue<double> DoubleValue;
 
+// List of items that keeps up to N items inside the value itself, so that
+// the short lists of faces do not need a memory allocation each
+template <class T, size_t N>
+struct ListValue: public Value {
+    ListValue();
+
+    // Accessors and mutators
+    bool get_size(const Property& prop, size_t& size) const;
+    bool get_item(const Property& prop, const size_t& num, double& value) const;
+    bool set_size(const Property& prop, const size_t& size);
+    bool set_item(const Property& prop, const size_t& num, const double& value);
+
+    // Direct access to the items
+    size_t size() const { return count; }
+    void resize(size_t size);
+    T* data() { return count <= N ? items : spill.data(); }
+    const T* data() const { return count <= N ? items : spill.data(); }
+
+private:
+    size_t count;           // The number of items.
+    T items[N];             // The items of short lists.
+    std::vector<T> spill;   // The items of lists longer than N.
+};
+
+// Template instantations
+typedef ListValue<unsigned int, 4> IndexList;
+typedef ListValue<float, 8> TexCoordList;
+
 // Vertex with 3d Float32 coordinates (and nothing else)
 struct Vertex: public Object {
     Vertex();
@@ -172,7 +203,7 @@ struct VertexNCT: public VertexNC {
 
 // Face with a list of vertex indices
 struct Face: public Object {
-    AnyValue indices;
+    IndexList indices;
 
     Face();
     Face(const size_t& size);
@@ -192,7 +223,7 @@ struct Face: public Object {
 }; // struct Face
 
 struct FaceTex: public Face {
-    AnyValue texcoords;
+    TexCoordList texcoords;
 
     FaceTex();
     FaceTex(const size_t& size);
@@ -232,6 +263,9 @@ struct ObjExternal: public Array {
 
     // Get the next Object.
     Object& next_object();
+
+    // Bind the values of all objects for block decoding
+    bool bind(const Element& elem, ElementPlan& plan);
 };
 
 // Typedefs for some template instantiations
@@ -0,0 +1,103 @@
+// A C++ reader/writer of .ply files.
+// Header probes.
+// These describe a ply file by reading only its
+// Header, and keep the byte offsets of its Elements
+// in a small index file next to it.
+
+
+#ifndef __PLY_PROBE_H__
+#define __PLY_PROBE_H__
+
+
+#include "header.h"
+
+#include <QString>
+
+class QIODevice;
+
+namespace PLY {
+	/// A description of a ply file, made without reading its data.
+	/** The byte offset of each Element in a binary file is
+	 *  known from the Header, up to the first Element with
+	 *  lists or strings. The other offsets are found once by
+	 *  index, which reads only the sizes of the lists, and are
+	 *  kept in an index file next to the ply file. Later
+	 *  probes read the index file, so that any Element can be
+	 *  read straight away (see Reader::seek_element).
+	 *  \sa Header.
+	 */
+	struct Probe {
+		static const size_t NO_OFFSET = (size_t)-1;	///< An offset that is not known.
+
+		Header header;					///< The Header of the file.
+		size_t file_size;				///< The size of the file in bytes (NO_OFFSET if not known).
+		qint64 file_time;				///< The modification time of the file in ms since the epoch (-1 if not known).
+		std::vector<size_t> offsets;	///< The byte offset of each Element, followed by the end of the data.
+
+		/// Default constructor (no file).
+		Probe(): file_size(NO_OFFSET), file_time(-1) {}
+
+		/// Probe a file.
+		/** The Header is read, as well as the index file
+		 *  if it matches the file. Compressed files are
+		 *  inflated, but never indexed.
+		 *  \param file_name the file to probe.
+		 *  \return true if the Header could be read.
+		 */
+		bool open_file(QString file_name);
+
+		/// Probe a device, which is left positioned at the start of the data.
+		/** \param dev the device to read the Header from.
+		 *  \return true if the Header could be read.
+		 */
+		bool open_io_device(QIODevice* dev);
+
+		/// Find all offsets of a binary file and write its index file.
+		/** Compressed files cannot be indexed, as they cannot seek.
+		 *  \param file_name the file to index.
+		 *  \return true if the offsets could be found and written.
+		 */
+		bool index(QString file_name);
+
+		/// Check whether the offsets of all [Elements](\ref Element) are known.
+		bool complete() const;
+
+		/// Get the number of rows of an Element.
+		/** \param name the name of the Element.
+		 *  \return the number of rows, or 0 if there is no such Element.
+		 */
+		size_t count(const char* name) const;
+
+		/// Get the byte offset of an Element.
+		/** \param name the name of the Element.
+		 *  \return the offset, or NO_OFFSET if it is not known.
+		 */
+		size_t offset(const char* name) const;
+
+		/// Get the size of the data of an Element in bytes.
+		/** \param name the name of the Element.
+		 *  \return the size, or NO_OFFSET if it is not known.
+		 */
+		size_t data_bytes(const char* name) const;
+
+		/// Get the name of the index file of a ply file.
+		static QString index_name(QString file_name) { return file_name + ".plyidx"; }
+
+		/// Read the offsets from an index file.
+		/** The index is only used if it describes the same
+		 *  Header, file size and modification time.
+		 *  \param file_name the index file.
+		 *  \return true if the index matches.
+		 */
+		bool load_index(QString file_name);
+
+		/// Write the offsets to an index file.
+		/** \param file_name the index file.
+		 *  \return true if all offsets are known and the file could be written.
+		 */
+		bool save_index(QString file_name) const;
+	}; // struct Probe
+} // namespace PLY
+
+
+#endif // __PLY_PROBE_H__
@@ -0,0 +1,92 @@
+// A C++ reader/writer of .ply files.
+// Read-ahead devices.
+// These read large blocks of a device on a thread of
+// their own, so that reading (and inflating) the data
+// overlaps with parsing it.
+
+
+#ifndef __PLY_READAHEAD_H__
+#define __PLY_READAHEAD_H__
+
+
+#include <cstddef>
+
+#include <QIODevice>
+
+#include "base.h"
+
+namespace PLY {
+	/// A read-only device that reads another device ahead on a thread of its own.
+	/** The data is read into one of two large buffers, while
+	 *  the other is being read, so a slow device (for example
+	 *  a file inside a zip archive) is read while the previous
+	 *  block is being parsed. The device is sequential, so
+	 *  it cannot seek or be mapped. Once all data has been
+	 *  read, the thread and its buffers are released.
+	 *
+	 *  Note that the wrapped device should not be used
+	 *  directly while this device is open.
+	 */
+	class ReadAheadDevice: public QIODevice {
+	public:
+		/// Construct for a device.
+		/** \param dev the device to read ahead of.
+		 *  \param owned whether dev is deleted with this device.
+		 *  \param block the number of bytes in each buffer.
+		 */
+		ReadAheadDevice(QIODevice* dev, bool owned = false, size_t block = BLOCK_BYTES);
+		~ReadAheadDevice();				///< Destructor.
+
+		/// Open the device and start reading ahead.
+		/** The wrapped device is opened if it is not open yet.
+		 *  \param mode the mode, which must be ReadOnly.
+		 *  \return true if the device could be opened.
+		 */
+		bool open(OpenMode mode);
+
+		/// Stop reading ahead and close both devices.
+		void close();
+
+		bool isSequential() const { return true; }
+		bool atEnd() const;
+		qint64 bytesAvailable() const;
+
+	protected:
+		QIODevice* device;				///< The device read ahead of.
+
+		/// Fill a buffer with the next data.
+		/** This is called on the read-ahead thread, once for
+		 *  each buffer. The default reads the wrapped device.
+		 *  \param data the buffer.
+		 *  \param size the size of the buffer.
+		 *  \return the number of bytes in the buffer, 0 at
+		 *  the end of the data or -1 on failure.
+		 */
+		virtual qint64 fill(char* data, size_t size);
+
+		/// Stop the read-ahead thread.
+		/** Classes that override fill must call this (or close)
+		 *  in their destructor, before their state is destroyed.
+		 */
+		void stop();
+
+		qint64 readData(char* data, qint64 max);
+		qint64 writeData(const char* data, qint64 len);
+
+	private:
+		struct Worker;
+
+		ReadAheadDevice(const ReadAheadDevice&);	// Private copy constructor to protect the thread.
+
+		bool owned;						// Whether to delete the wrapped device.
+		size_t block;					// The size of each buffer.
+		Worker* worker;					// The read-ahead thread (nullptr: closed or done).
+		int turn;						// The buffer to read next.
+		int current;					// The buffer being read (-1: none).
+		size_t pos;						// The next byte to read from the current buffer.
+		bool failed;					// Whether the data ended in a failure.
+	}; // class ReadAheadDevice
+} // namespace PLY
+
+
+#endif // __PLY_READAHEAD_H__
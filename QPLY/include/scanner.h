@@ -0,0 +1,85 @@
+// A C++ reader/writer of .ply files.
+// ASCII scanner.
+// This splits the data section of an ASCII ply
+// stream into words, reading the stream in large
+// blocks instead of one value at a time.
+
+
+#ifndef __PLY_SCANNER_H__
+#define __PLY_SCANNER_H__
+
+
+#include "base.h"
+#include <vector>
+
+class QIODevice;
+
+namespace PLY {
+	/// A buffered tokenizer for ASCII ply data.
+	/** Numbers are parsed without regard to the locale,
+	 *  as the ply format always uses a '.' as decimal point.
+	 */
+	struct AsciiScanner {
+		/// Default constructor (nothing to scan).
+		AsciiScanner(): source(0), pos(0), end(0), eof(true) {}
+
+		/// Scan a device, reading it in blocks of BLOCK_BYTES.
+		/** \param dev the device, positioned at the start of the data.
+		 */
+		void use_io_device(QIODevice* dev);
+
+		/// Scan a range of memory, such as a memory map.
+		/** \param data the first character.
+		 *  \param size the number of characters.
+		 */
+		void use_memory(const char* data, size_t size);
+
+		/// Get the next word.
+		/** A word is a run of characters without white-space.
+		 *  \param [out] word the first character of the word.
+		 *  This remains valid until the next call.
+		 *  \param [out] len the number of characters in the word.
+		 *  \return true if there was a word left.
+		 */
+		bool next_word(const char*& word, size_t& len);
+
+		/// Get the next value.
+		/** Integers are parsed exactly.
+		 *  \param [out] value the value.
+		 *  \return true if a valid number was read.
+		 */
+		bool next_value(double& value);
+
+		/// Get the next string.
+		/** A string is either a word or a quoted run of
+		 *  characters, in which case the quotes are removed.
+		 *  \param [out] str the string, of at most BIG_STRING characters.
+		 *  \return true if there was a string left.
+		 */
+		bool next_string(char* str);
+
+		/// Parse a number.
+		/** \param first the first character of the number.
+		 *  \param last one past the last character of the number.
+		 *  \param [out] value the value.
+		 *  \return true if all characters form one valid number.
+		 */
+		static bool parse(const char* first, const char* last, double& value);
+
+	private:
+		// Keep the unscanned characters and read the next block.
+		bool refill();
+
+		// Find the end of the token starting at pos.
+		const char* token_end(bool quoted);
+
+		QIODevice* source;				// The device to read from (if any).
+		std::vector<char> buffer;		// The characters read from the device.
+		const char* pos;				// The next character to scan.
+		const char* end;				// One past the last character available.
+		bool eof;						// Whether all characters have been made available.
+	}; // struct AsciiScanner
+} // namespace PLY
+
+
+#endif // __PLY_SCANNER_H__
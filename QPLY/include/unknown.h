@@ -26,14 +26,21 @@
 #define __PLY_UNKNOWN_H__
 
 
+#include "arena.h"
 #include "object.h"
 
 namespace PLY {
 	/// A Value representing a generic Property.
+	/** The data can be allocated in an Arena, in which case
+	 *  it is released together with the Arena instead.
+	 */
 	struct AnyValue: public Value {
 		char* data;					///< The data value.
 
-		AnyValue(): data(0) {}		///< Constructor.
+		/// Constructor.
+		/** \param a the Arena to allocate the data in (nullptr: the heap).
+		 */
+		AnyValue(Arena* a = 0): data(0), bytes(0), arena(a) {}
 		~AnyValue() { deinit(); }	///< Destructor.
 	
 		bool get_scalar(const Property& prop, double& value) const;
@@ -49,7 +56,10 @@ namespace PLY {
 		AnyValue(const AnyValue&) {} ///< Private copy constructor to protect the data.
 
 		/// Deinitialize the data.
-		void deinit() { if (data) { delete[] data; data = 0; } }
+		void deinit() { if (data && !arena) delete[] data; data = 0; bytes = 0; }
+
+		/// Make room for a number of bytes, reusing the data if it is large enough.
+		void reserve(size_t len);
 
 		/// Convert a pointer to a value.
 		/** \param ptr the pointer.
@@ -71,6 +81,9 @@ namespace PLY {
 		
 		/// Copy bytes from one array to another.
 		void copy(const char* from, char* to, const size_t& num) const;
+
+		size_t bytes;					// The number of bytes the data can hold.
+		Arena* arena;					// Where the data is allocated (nullptr: the heap).
 	}; // struct AnyValue
 	
 
@@ -79,7 +92,9 @@ namespace PLY {
 		Value** values;					///< The Values of the Object.
 
 		/// Default constructor.
-		AnyObject(): values(0) {}
+		/** \param a the Arena to allocate the Values in (nullptr: the heap).
+		 */
+		AnyObject(Arena* a = 0): values(0), num(0), arena(a) {}
 		~AnyObject() { deinit(); }		///< Destructor.
 
 		void prepare(const Element& elem);
@@ -92,16 +107,23 @@ namespace PLY {
 		void deinit();					// Deinitialize the objects.
 		
 		size_t num;						// The number of values.
+		Arena* arena;					// Where the Values are allocated (nullptr: the heap).
 	}; // struct AnyObject
 
 	
 	/// An Array representing a generic Element.
+	/** If the Array is given an Arena, all its [Objects](\ref Object)
+	 *  and their [Values](\ref Value) are allocated in it, and
+	 *  clearing the Array simply forgets them.
+	 */
 	struct AnyArray: public Array {
 		Object** objects;				///< The [Objects](\ref Object) in the array.
 		size_t incr;					///< Indicator for the Object to get.
 	
 		/// Default constructor.
-		AnyArray(): objects(0), incr(0), num(0) {}
+		/** \param a the Arena to allocate the [Objects](\ref Object) in (nullptr: the heap).
+		 */
+		AnyArray(Arena* a = 0): objects(0), incr(0), num(0), arena(a) {}
 		virtual ~AnyArray() { deinit(); }	///< Destructor.
 	
 		virtual size_t size() { return num; }
@@ -117,6 +139,7 @@ namespace PLY {
 		void deinit();					// Deinitialize the objects.
 
 		size_t num;						// The number of objects.
+		Arena* arena;					// Where the objects are allocated (nullptr: the heap).
 	}; // struct AnyArray
 } // namespace PLY
 
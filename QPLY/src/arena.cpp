@@ -0,0 +1,48 @@
+// A C++ reader/writer of .ply files.
+// Arena allocation.
+
+
+#include "arena.h"
+#include <algorithm>
+
+namespace PLY {
+	namespace {
+		// The sizes of the first and the largest shared blocks.
+		const size_t FIRST_BLOCK = 1 << 16;
+		const size_t LAST_BLOCK = 1 << 24;
+	} // namespace
+
+
+	// Allocate memory.
+	void* Arena::allocate(size_t bytes, size_t align) {
+		size_t start = current ? used + (align - (size_t)(current + used) % align) % align : 0;
+		if (current == 0 || start + bytes > capacity) {
+			// Large allocations get a block of their own, so the current block stays in use.
+			size_t next = std::min(LAST_BLOCK, std::max(FIRST_BLOCK, 2 * capacity));
+			if (bytes + align > next / 4) {
+				char* block = new char[bytes + align];
+				blocks.insert(blocks.begin(), block);
+				total += bytes;
+				size_t skip = (align - (size_t)block % align) % align;
+				return block + skip;
+			}
+			current = new char[next];
+			blocks.push_back(current);
+			capacity = next;
+			used = 0;
+			start = (align - (size_t)current % align) % align;
+		}
+		used = start + bytes;
+		total += bytes;
+		return current + start;
+	}
+
+	// Release all memory.
+	void Arena::release() {
+		for (size_t n = 0; n < blocks.size(); ++n)
+			delete[] blocks[n];
+		blocks.clear();
+		current = 0;
+		used = capacity = total = 0;
+	}
+} // namespace PLY
@@ -0,0 +1,163 @@
+// A C++ reader/writer of .ply files.
+// Byte order conversion.
+
+
+#include "byteswap.h"
+#include <algorithm>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define PLY_SIMD_X86
+#define PLY_TARGET(t) __attribute__((target(t)))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define PLY_SIMD_X86
+#define PLY_TARGET(t)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace PLY {
+	namespace {
+		// The largest repeating permutation worth keeping masks for.
+		const size_t MAX_PERIOD = 4096;
+
+		size_t gcd(size_t a, size_t b) {
+			while (b != 0) {
+				size_t t = a % b;
+				a = b;
+				b = t;
+			}
+			return a;
+		}
+
+		// Convert single bytes, for the edges of a block.
+		inline void apply_bytes(const char* rows, char* out, size_t first, size_t last,
+			size_t stride, const unsigned int* order) {
+			for (size_t b = first; b < last; ++b) {
+				size_t r = b % stride;
+				out[b] = rows[b - r + order[r]];
+			}
+		}
+
+#ifdef PLY_SIMD_X86
+		// The instruction sets to choose from.
+		enum Simd_level { SCALAR_ONLY, SSSE3, AVX2 };
+
+		// Find the best instruction set of the processor.
+		Simd_level detect() {
+#if defined(_MSC_VER)
+			int info[4];
+			__cpuid(info, 0);
+			int ids = info[0];
+			__cpuid(info, 1);
+			bool ssse3 = (info[2] & (1 << 9)) != 0;
+			bool osxsave = (info[2] & (1 << 27)) != 0;
+			bool avx2 = false;
+			if (ids >= 7 && osxsave && (_xgetbv(0) & 6) == 6) {
+				__cpuidex(info, 7, 0);
+				avx2 = (info[1] & (1 << 5)) != 0;
+			}
+#else
+			__builtin_cpu_init();
+			bool ssse3 = __builtin_cpu_supports("ssse3") != 0;
+			bool avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+			return avx2 ? AVX2 : (ssse3 ? SSSE3 : SCALAR_ONLY);
+		}
+
+		// Convert the 16-byte groups starting at first, while the next group is available.
+		PLY_TARGET("ssse3")
+		size_t apply_ssse3(const char* rows, char* out, size_t first, size_t bytes,
+			size_t period, const char* masks) {
+			const char* prev = masks;
+			const char* cur = masks + period + 16;
+			const char* next = masks + 2*(period + 16);
+			size_t j = first % period;
+			size_t b = first;
+			for (; b + 32 <= bytes; b += 16) {
+				__m128i r = _mm_or_si128(
+					_mm_or_si128(
+						_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(rows + b - 16)), _mm_loadu_si128((const __m128i*)(prev + j))),
+						_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(rows + b)), _mm_loadu_si128((const __m128i*)(cur + j)))),
+					_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(rows + b + 16)), _mm_loadu_si128((const __m128i*)(next + j))));
+				_mm_storeu_si128((__m128i*)(out + b), r);
+				j = (j + 16) % period;
+			}
+			return b;
+		}
+
+		// Convert the 32-byte groups starting at first, while the next 16 bytes are available.
+		PLY_TARGET("avx2")
+		size_t apply_avx2(const char* rows, char* out, size_t first, size_t bytes,
+			size_t period, const char* masks) {
+			// Each 128-bit lane shuffles its own previous, current and next 16 bytes.
+			const char* prev = masks;
+			const char* cur = masks + period + 16;
+			const char* next = masks + 2*(period + 16);
+			size_t j = first % period;
+			size_t b = first;
+			for (; b + 48 <= bytes; b += 32) {
+				__m256i r = _mm256_or_si256(
+					_mm256_or_si256(
+						_mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(rows + b - 16)), _mm256_loadu_si256((const __m256i*)(prev + j))),
+						_mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(rows + b)), _mm256_loadu_si256((const __m256i*)(cur + j)))),
+					_mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(rows + b + 16)), _mm256_loadu_si256((const __m256i*)(next + j))));
+				_mm256_storeu_si256((__m256i*)(out + b), r);
+				j = (j + 32) % period;
+			}
+			return b;
+		}
+#endif // PLY_SIMD_X86
+	} // namespace
+
+
+	// Prepare for rows made of consecutive values.
+	void RowSwap::compile(const std::vector<size_t>& sizes) {
+		order.clear();
+		for (size_t v = 0; v < sizes.size(); ++v) {
+			size_t start = order.size();
+			for (size_t i = 0; i < sizes[v]; ++i)
+				order.push_back((unsigned int)(start + sizes[v] - i - 1));
+		}
+		stride = order.size();
+		period = 0;
+		masks.clear();
+		if (stride == 0) return;
+
+		// Each output byte comes from the previous, current or next 16 bytes.
+		// The masks of each are stored with their first 16 bytes repeated at
+		// the end, so that groups of 32 bytes can wrap around the period.
+		size_t len = stride / gcd(stride, 16) * 16;
+		if (len > MAX_PERIOD) return;
+		period = len;
+		masks.assign(3 * (period + 16), (char)0x80);
+		for (size_t b = 0; b < period + 16; ++b) {
+			size_t a = b % period;
+			size_t r = a % stride;
+			size_t s = a - r + order[r];
+			size_t group = s / 16 + 1 - a / 16;
+			masks[group * (period + 16) + b] = (char)(s % 16);
+		}
+	}
+
+	// Reverse the bytes of every value in a block of rows.
+	void RowSwap::apply(const char* rows, size_t count, char* out) const {
+		const size_t bytes = count * stride;
+#ifdef PLY_SIMD_X86
+		static const Simd_level level = detect();
+		if (period != 0 && level != SCALAR_ONLY && bytes >= 48) {
+			// The first 16 bytes have no previous group.
+			apply_bytes(rows, out, 0, 16, stride, order.data());
+			size_t b = 16;
+			if (level == AVX2)
+				b = apply_avx2(rows, out, b, bytes, period, masks.data());
+			b = apply_ssse3(rows, out, b, bytes, period, masks.data());
+			apply_bytes(rows, out, b, bytes, stride, order.data());
+			return;
+		}
+#endif
+		for (size_t n = 0; n < count; ++n, rows += stride, out += stride)
+			for (size_t i = 0; i < stride; ++i)
+				out[i] = rows[order[i]];
+	}
+} // namespace PLY
@@ -0,0 +1,232 @@
+// A C++ reader/writer of .ply files.
+// Columnar storage.
+
+
+#include "column.h"
+#include <cstring>
+
+namespace PLY {
+	// Prepare the Column to contain a number of rows.
+	void Column::prepare(size_t num) {
+		clear();
+		if (!prop.store) return;
+		if (scalar())
+			values.assign(num * value_bytes(), 0);
+		else
+			offsets.assign(num + 1, 0);
+	}
+
+	// Remove all rows.
+	void Column::clear() {
+		values.clear();
+		offsets.assign(1, 0);
+	}
+
+	// Set the number of list items of a row.
+	void Column::set_size(size_t row, size_t size) {
+		offsets[row+1] = offsets[row] + size;
+		values.resize(offsets[row+1] * value_bytes());
+	}
+
+	// Get a value as double.
+	double Column::get(size_t index) const {
+		double value = 0;
+		convert(values.data() + index*value_bytes(), 0, type, (char*)&value, 0, Float64, 1, false);
+		return value;
+	}
+
+	// Set a value from a double.
+	void Column::set(size_t index, double value) {
+		convert((const char*)&value, 0, Float64, values.data() + index*value_bytes(), 0, type, 1, false);
+	}
+
+
+	bool ColumnValue::get_scalar(const Property& prop, double& value) const {
+		if (!column->scalar()) return false;
+		value = column->get(*row);
+		return true;
+	}
+
+	bool ColumnValue::set_scalar(const Property& prop, const double& value) {
+		if (!column->scalar()) return false;
+		column->set(*row, value);
+		return true;
+	}
+
+	bool ColumnValue::get_size(const Property& prop, size_t& size) const {
+		if (column->prop.type != LIST) return false;
+		size = column->size(*row);
+		return true;
+	}
+
+	bool ColumnValue::get_item(const Property& prop, const size_t& num, double& value) const {
+		if (column->prop.type != LIST || num >= column->size(*row)) return false;
+		value = column->get(column->offsets[*row] + num);
+		return true;
+	}
+
+	bool ColumnValue::set_size(const Property& prop, const size_t& size) {
+		if (column->prop.type != LIST) return false;
+		column->set_size(*row, size);
+		return true;
+	}
+
+	bool ColumnValue::set_item(const Property& prop, const size_t& num, const double& value) {
+		if (column->prop.type != LIST || num >= column->size(*row)) return false;
+		column->set(column->offsets[*row] + num, value);
+		return true;
+	}
+
+	bool ColumnValue::get_string(const Property& prop, char* str) const {
+		if (column->prop.type != STRING) return false;
+		std::memcpy(str, column->values.data() + column->offsets[*row], column->size(*row));
+		return true;
+	}
+
+	bool ColumnValue::set_string(const Property& prop, const char* str) {
+		if (column->prop.type != STRING) return false;
+		size_t size = std::strlen(str) + 1;
+		column->set_size(*row, size);
+		std::memcpy(column->values.data() + column->offsets[*row], str, size);
+		return true;
+	}
+
+
+	// Get a Value.
+	Value* ColumnObject::get_value(const Element& elem, const Property& prop) {
+		// Values are generally requested in the order of the Properties.
+		for (size_t n = 0; n < values.size(); ++n) {
+			size_t index = (hint + n) % values.size();
+			if (values[index].column->prop.name == prop.name) {
+				hint = index + 1;
+				return values[index].column->prop.store ? &values[index] : nullptr;
+			}
+		}
+		return nullptr;
+	}
+
+
+	// Construct for an Element.
+	ColumnArray::ColumnArray(const Element& e): elem(e), num(0), incr(0) {
+		columns.reserve(elem.props.size());
+		for (size_t p = 0; p < elem.props.size(); ++p)
+			columns.push_back(Column(elem.props[p]));
+		for (size_t p = 0; p < columns.size(); ++p)
+			object.values.push_back(ColumnValue(&columns[p], &object.row));
+		clear();
+	}
+
+	// Prepare the Array to contain a number of Objects.
+	void ColumnArray::prepare(const size_t& size) {
+		for (size_t p = 0; p < columns.size(); ++p)
+			columns[p].prepare(size);
+		num = size;
+		incr = 0;
+	}
+
+	// Remove all Objects from the Array.
+	void ColumnArray::clear() {
+		for (size_t p = 0; p < columns.size(); ++p)
+			columns[p].clear();
+		num = 0;
+		incr = 0;
+	}
+
+	// Get the next Object.
+	Object& ColumnArray::next_object() {
+		object.row = incr++;
+		return object;
+	}
+
+	// Bind typed destinations for the Objects of an Element.
+	bool ColumnArray::bind(const Element& elem, ElementPlan& plan) {
+		Column* col;
+		for (size_t p = 0; p < elem.props.size(); ++p) {
+			if (!elem.props[p].store) continue;
+			col = find(elem.props[p].name.c_str());
+			if (col && col->scalar() && col->prop.store)
+				plan.props[p].dest = Binding(col->values.data(), col->value_bytes(), col->type);
+		}
+		incr = num;
+		return true;
+	}
+
+	// Bind a typed destination for the items of a list Property.
+	bool ColumnArray::bind_list(const Element& elem, const Property& prop,
+		const std::vector<size_t>& sizes, Binding& dest) {
+		Column* col = find(prop.name.c_str());
+		if (col == 0 || col->prop.type != LIST || !col->prop.store || col->offsets.size() != sizes.size() + 1)
+			return false;
+		for (size_t n = 0; n < sizes.size(); ++n)
+			col->offsets[n+1] = col->offsets[n] + sizes[n];
+		col->values.resize(col->offsets.back() * col->value_bytes());
+		dest = Binding(col->values.data(), col->value_bytes(), col->type);
+		return true;
+	}
+
+	// Bind a typed destination for the items of a list Property of uniform size.
+	bool ColumnArray::bind_uniform_list(const Element& elem, const Property& prop,
+		size_t size, Binding& dest) {
+		Column* col = find(prop.name.c_str());
+		if (col == 0 || col->prop.type != LIST || !col->prop.store)
+			return false;
+		for (size_t n = 1; n < col->offsets.size(); ++n)
+			col->offsets[n] = n * size;
+		col->values.resize(col->offsets.back() * col->value_bytes());
+		dest = Binding(col->values.data(), col->value_bytes(), col->type);
+		return true;
+	}
+
+	// View the values of the Objects of an Element.
+	bool ColumnArray::view(const Element& elem, ElementPlan& plan) {
+		Column* col;
+		for (size_t p = 0; p < elem.props.size(); ++p) {
+			if (!elem.props[p].store) continue;
+			col = find(elem.props[p].name.c_str());
+			if (col == 0 || !col->prop.store || col->prop.type == STRING)
+				return false;
+			Binding values(col->values.data(), col->value_bytes(), col->type);
+			plan.props[p].source = col->scalar() ? Source(values) : Source(values, col->offsets.data());
+		}
+		return true;
+	}
+
+	// Find the Column of a Property.
+	Column* ColumnArray::find(const char* name) {
+		size_t index;
+		if (!elem.find_index(name, index)) return nullptr;
+		return &columns[index];
+	}
+
+	// Change how the values of a Property are stored in memory.
+	bool ColumnArray::set_type(const char* name, Scalar_type type) {
+		Column* col = find(name);
+		if (col == 0 || col->prop.type == STRING || type <= StartType || type >= EndType) return false;
+		col->type = type;
+		col->prepare(num);
+		return true;
+	}
+
+
+	// Construct for a Header.
+	ColumnStorage::ColumnStorage(const Header& header): Storage(header) {
+		for (size_t e = 0; e < header.elements.size(); ++e) {
+			arrays.push_back(new ColumnArray(header.elements[e]));
+			set_collection(header, header.elements[e], *arrays.back());
+		}
+	}
+
+	// Destructor.
+	ColumnStorage::~ColumnStorage() {
+		for (size_t n = 0; n < arrays.size(); ++n)
+			delete arrays[n];
+	}
+
+	// Get the columns of an Element.
+	ColumnArray* ColumnStorage::get_columns(const char* name) {
+		for (size_t n = 0; n < arrays.size(); ++n)
+			if (arrays[n]->elem.name == name)
+				return arrays[n];
+		return nullptr;
+	}
+} // namespace PLY
@@ -0,0 +1,216 @@
+// A C++ reader/writer of .ply files.
+// Compressed devices.
+
+
+#include "gzip.h"
+#include "base.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <zlib.h>
+#include <QFileDevice>
+
+namespace PLY {
+	// Check whether a file is gzip-compressed.
+	bool is_gzip_file(const QString& file_name) {
+		return file_name.endsWith(".gz", Qt::CaseInsensitive);
+	}
+
+
+	// The decompression state of an InflateDevice.
+	struct InflateDevice::Inflater {
+		z_stream zs;
+		std::vector<char> input;		// The compressed data being inflated.
+		bool member_end;				// Whether a gzip member has just ended.
+		bool done;						// Whether all compressed data has been read.
+		bool failed;					// Whether the data is corrupt or truncated.
+
+		Inflater(): input(BLOCK_BYTES), member_end(false), done(false), failed(false) {
+			std::memset(&zs, 0, sizeof(zs));
+			// Detect a gzip or zlib header.
+			failed = inflateInit2(&zs, 15 + 32) != Z_OK;
+		}
+		~Inflater() { inflateEnd(&zs); }
+	}; // struct InflateDevice::Inflater
+
+
+	// Construct for a compressed device.
+	InflateDevice::InflateDevice(QIODevice* dev, bool own): ReadAheadDevice(dev, own),
+		inflater(nullptr) {}
+
+	// Destructor.
+	InflateDevice::~InflateDevice() {
+		close();
+	}
+
+	// Open the device and start inflating.
+	bool InflateDevice::open(OpenMode mode) {
+		if (isOpen())
+			HANDLE_FAULT("InflateDevice::open : the device is already open");
+		inflater = new Inflater;
+		if (ReadAheadDevice::open(mode))
+			return true;
+		delete inflater;
+		inflater = nullptr;
+		return false;
+	}
+
+	// Stop inflating and close both devices.
+	void InflateDevice::close() {
+		ReadAheadDevice::close();
+		delete inflater;
+		inflater = nullptr;
+	}
+
+	// Inflate the next block of data.
+	qint64 InflateDevice::fill(char* data, size_t size) {
+		Inflater& inf = *inflater;
+		z_stream& zs = inf.zs;
+		zs.next_out = (Bytef*)data;
+		zs.avail_out = (uInt)size;
+		while (zs.avail_out > 0 && !inf.done && !inf.failed) {
+			if (zs.avail_in == 0) {
+				qint64 got = device->read(inf.input.data(), (qint64)inf.input.size());
+				if (got <= 0) {
+					// The data must not end inside a gzip member.
+					inf.done = true;
+					inf.failed = got < 0 || !inf.member_end;
+					break;
+				}
+				zs.next_in = (Bytef*)inf.input.data();
+				zs.avail_in = (uInt)got;
+			}
+
+			int res = inflate(&zs, Z_NO_FLUSH);
+			if (res == Z_STREAM_END) {
+				// Another gzip member may follow.
+				inf.member_end = true;
+				inflateReset(&zs);
+			}
+			else if (res == Z_OK)
+				inf.member_end = false;
+			else if (res != Z_BUF_ERROR)
+				inf.failed = true;
+		}
+
+		// Data inflated before a failure is passed on first.
+		size_t len = size - zs.avail_out;
+		if (len == 0 && inf.failed) return -1;
+		return (qint64)len;
+	}
+
+
+	// The compression state of a DeflateDevice.
+	struct DeflateDevice::Deflater {
+		z_stream zs;
+		std::vector<char> input;		// The data collected for compression.
+		size_t used;					// The number of bytes collected.
+		std::vector<char> output;		// The compressed data to write.
+
+		Deflater(): input(BLOCK_BYTES), used(0), output(BLOCK_BYTES) {
+			std::memset(&zs, 0, sizeof(zs));
+		}
+	}; // struct DeflateDevice::Deflater
+
+
+	// Construct for a compressed device.
+	DeflateDevice::DeflateDevice(QIODevice* dev, bool own, int lvl): device(dev), owned(own),
+		level(lvl), deflater(nullptr), failed(false) {}
+
+	// Destructor.
+	DeflateDevice::~DeflateDevice() {
+		close();
+		if (owned)
+			delete device;
+	}
+
+	// Open the device.
+	bool DeflateDevice::open(OpenMode mode) {
+		if (isOpen() || (mode & ReadWrite) != WriteOnly)
+			HANDLE_FAULT("DeflateDevice::open : the device can only be opened once for writing");
+		if (!device->isOpen() && !device->open(WriteOnly))
+			HANDLE_FAULT("DeflateDevice::open : cannot open the compressed device");
+
+		// Write a gzip header and trailer.
+		deflater = new Deflater;
+		if (deflateInit2(&deflater->zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+			delete deflater;
+			deflater = nullptr;
+			HANDLE_FAULT("DeflateDevice::open : cannot start the compression");
+		}
+		return QIODevice::open(mode);
+	}
+
+	// Complete the gzip stream.
+	bool DeflateDevice::finish() {
+		if (deflater) {
+			if (!deflate_input(true))
+				failed = true;
+			deflateEnd(&deflater->zs);
+			delete deflater;
+			deflater = nullptr;
+
+			// Push the trailer out of any buffer of the compressed device.
+			QFileDevice* file = dynamic_cast<QFileDevice*>(device);
+			if (file && (!file->flush() || file->error() != QFileDevice::NoError))
+				failed = true;
+			if (failed)
+				setErrorString("cannot write the compressed data");
+		}
+		return !failed;
+	}
+
+	// Complete the gzip stream and close both devices.
+	void DeflateDevice::close() {
+		finish();
+		if (device->isOpen())
+			device->close();
+		if (isOpen())
+			QIODevice::close();
+	}
+
+	// Reading is not supported.
+	qint64 DeflateDevice::readData(char* data, qint64 max) {
+		return -1;
+	}
+
+	// Collect data to compress.
+	qint64 DeflateDevice::writeData(const char* data, qint64 len) {
+		if (deflater == nullptr) return -1;
+		qint64 done = 0;
+		while (done < len) {
+			size_t room = deflater->input.size() - deflater->used;
+			size_t part = std::min<size_t>(room, (size_t)(len - done));
+			std::memcpy(deflater->input.data() + deflater->used, data + done, part);
+			deflater->used += part;
+			done += (qint64)part;
+			if (deflater->used == deflater->input.size() && !deflate_input(false)) {
+				failed = true;
+				return -1;
+			}
+		}
+		return len;
+	}
+
+	// Compress the collected data.
+	bool DeflateDevice::deflate_input(bool finish) {
+		z_stream& zs = deflater->zs;
+		zs.next_in = (Bytef*)deflater->input.data();
+		zs.avail_in = (uInt)deflater->used;
+		const int flush = finish ? Z_FINISH : Z_NO_FLUSH;
+		int res;
+		do {
+			zs.next_out = (Bytef*)deflater->output.data();
+			zs.avail_out = (uInt)deflater->output.size();
+			res = deflate(&zs, flush);
+			if (res == Z_STREAM_ERROR)
+				return false;
+			qint64 len = (qint64)(deflater->output.size() - zs.avail_out);
+			if (len > 0 && device->write(deflater->output.data(), len) != len)
+				return false;
+		} while (zs.avail_out == 0 || (finish && res != Z_STREAM_END));
+		deflater->used = 0;
+		return true;
+	}
+} // namespace PLY
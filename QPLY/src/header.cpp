@@ -74,6 +74,34 @@ namespace PLY {
 		return &elements[index];
 	}
 	
+	// Mark all Elements and Properties as not stored.
+	void Header::select_none() {
+		for (size_t e = 0; e < elements.size(); ++e) {
+			elements[e].store = false;
+			for (size_t p = 0; p < elements[e].props.size(); ++p)
+				elements[e].props[p].store = false;
+		}
+	}
+
+	// Mark an Element and some of its Properties as stored.
+	bool Header::select(const char* name, const std::vector<std::string>& prop_names) {
+		Element* elem = find_element(name);
+		if (elem == 0) return false;
+		elem->store = true;
+		for (size_t p = 0; p < elem->props.size(); ++p)
+			if (prop_names.empty())
+				elem->props[p].store = true;
+		bool found = true;
+		for (size_t n = 0; n < prop_names.size(); ++n) {
+			Property* prop = elem->find_property(prop_names[n].c_str());
+			if (prop)
+				prop->store = true;
+			else
+				found = false;
+		}
+		return found;
+	}
+
 	// Apply the stream type.
 	void Header::apply_stream_type(char* ptr, size_t n) {
 		if (stream_type != system_type && n > 1) {
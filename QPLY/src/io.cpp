@@ -32,6 +32,9 @@ WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
 */
 
 #include "io.h"
+#include "gzip.h"
+#include "parallel.h"
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 
@@ -40,6 +43,16 @@ WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
 #include <QDataStream>
 
 namespace PLY {
+	// Get the remainder of a header line, without white-space at either end.
+	static std::string line_remainder(const char* ptr) {
+		WhiteSpace ignore;
+		if (ptr == 0) return std::string();
+		while (*ptr != '\0' && ignore(*ptr)) ++ptr;
+		size_t len = std::strlen(ptr);
+		while (len > 0 && ignore(ptr[len-1])) --len;
+		return std::string(ptr, len);
+	}
+
     // Use the given IO Device for reading.
     bool Reader::use_io_device(QIODevice* dev) {
         // Sanity check
@@ -74,14 +87,42 @@ namespace PLY {
             HANDLE_FAULT("Reader::open_file : file does not exist");
         }
         srcOwned = true;
+        if (is_gzip_file(file_name))
+            return use_io_device(new InflateDevice(file, true));
         return use_io_device(file);
 	}
 
+	// Open a file for reading through a memory map.
+	bool Reader::map_file(QString file_name) {
+		if (!open_file(file_name))
+			return false;
+
+		// The data starts right after the header.
+		// If the file cannot be mapped, it is simply read through the device.
+		QFile* file = dynamic_cast<QFile*>(source);
+		if (file == nullptr)
+			return true;
+		mapped = (const char*)file->map(0, file->size());
+		if (mapped) {
+			mapped_pos = (size_t)file->pos();
+			mapped_size = (size_t)file->size();
+			elem_offsets.assign(1, mapped_pos);
+		}
+		return true;
+	}
+
 	// Close the reader.
 	void Reader::close_file() {
         delete tStream;
         tStream = nullptr;
 
+		if (mapped) {
+			static_cast<QFile*>(source)->unmap((uchar*)mapped);
+			mapped = nullptr;
+			mapped_size = mapped_pos = 0;
+			elem_offsets.clear();
+		}
+
         if (source) {
             source->close();
         }
@@ -93,11 +134,12 @@ namespace PLY {
     }
 	
     bool Reader::init_stream() {
-        // Wrap io device with streams
+        // ASCII data is tokenized in blocks, straight from the map if there is one
         if (header.stream_type == ASCII) {
-            tStream = new QTextStream(source);
-            if (tStream == nullptr || tStream->status() != QTextStream::Ok)
-                HANDLE_FAULT("Reader::init_stream : invalid stream");
+            if (mapped)
+                scanner.use_memory(mapped + mapped_pos, mapped_size - mapped_pos);
+            else
+                scanner.use_io_device(source);
         }
 
         return true;
@@ -177,9 +219,9 @@ namespace PLY {
 				elem->props.push_back(prop);
 			}
 			else if (std::strcmp(word, "comment") == 0)
-				header.comments.push_back(line);
+				header.comments.push_back(line_remainder(tokenizer.line));
 			else if (std::strcmp(word, "obj_info") == 0)
-				header.obj_info.push_back(line);
+				header.obj_info.push_back(line_remainder(tokenizer.line));
 			else if (std::strcmp(word, "end_header") == 0)
 				break;
 			else 
@@ -195,15 +237,7 @@ namespace PLY {
 	
 	// Read the data from the file.
 	bool Reader::read_data(Storage* store) {
-		Element* elem;
-		Property* prop;
-		Array* collect;
-		Object* obj;
-		Value* value;
-		double dval;
-		size_t size;
-		char str[BIG_STRING];
-		bool store_prop;
+		ElementPlan plan;
 
 		// Prepare the store to receive the objects.
 		store->prepare(header);
@@ -212,78 +246,420 @@ namespace PLY {
         if (!init_stream())
             HANDLE_FAULT("Reader::read_data : stream initialization failed");
 
+		// ASCII data can be split over several threads.
+		if (header.stream_type == ASCII && threads != 1)
+			return read_ascii_parallel(store);
+
 		// The data is read in the same order as the elements.
 		for (size_t e = 0; e < header.elements.size(); ++e) {
-			elem = &header.elements[e];
-			collect = 0;
-			obj = 0;
+			if (!read_element(header.elements[e], store, plan)) return false;
+			if (element_read)
+				element_read(header.elements[e]);
+		}
+		return true;
+	}
+
+	// Read all rows of an Element.
+	bool Reader::read_element(Element& elem, Storage* store, ElementPlan& plan) {
+		Array* collect = 0;
+
+		if (store && elem.store)
+			collect = store->get_collection(header, elem);
+		if (collect)
+			collect->prepare(elem);
+
+		// Fixed-size binary rows are decoded in blocks straight
+		// into the collection, if it can bind its values.
+		// Rows with lists are too, while the lists keep the same size.
+		if (collect && header.stream_type != ASCII) {
+			if (plan.compile(elem) && collect->bind(elem, plan)) {
+				plan.specialize();
+				return read_rows(plan, elem.num);
+			}
+			if (!plan.fixed) {
+				// Mapped rows can be scanned ahead and split over several threads.
+				if (mapped && threads != 1)
+					return read_varying(elem, collect, elem.num);
+				return read_uniform(elem, collect, elem.num);
+			}
+		}
+
+		// Binary rows that are not stored are skipped.
+		if (!collect && header.stream_type != ASCII) {
+			plan.compile(elem);
+			return skip_rows(plan, elem.num);
+		}
+
+		return read_objects(elem, collect, elem.num);
+	}
+
+	// Read a number of rows of an Element one Object at a time.
+	bool Reader::read_objects(const Element& elem, Array* collect, size_t num) {
+		const Property* prop;
+		Object* obj = 0;
+		Value* value = 0;
+		double dval;
+		size_t size;
+		char str[BIG_STRING];
+		bool store_prop;
 
-			if (store && elem->store)
-				collect = store->get_collection(header, *elem);
+		// We read a number of objects of this element.
+		for (size_t n = 0; n < num; ++n) {
 			if (collect)
-				collect->prepare(*elem);
+				obj = &collect->next_object();
+			if (obj)
+				obj->prepare(elem);
 
-			// We read a number of objects of this element.
-			for (size_t n = 0; n < elem->num; ++n) {
-				if (collect)
-					obj = &collect->next_object();
+			// The properties are read in the same order as in the elements.
+			for (size_t p = 0; p < elem.props.size(); ++p) {
+				prop = &elem.props[p];
 				if (obj)
-					obj->prepare(*elem);
-				
-				// The properties are read in the same order as in the elements.
-				for (size_t p = 0; p < elem->props.size(); ++p) {
-					prop = &elem->props[p];
-					if (obj)
-						value = obj->get_value(*elem, *prop);
-					store_prop = obj && value && prop->store;
-
-					// Read the property.
-					switch (prop->type) {
-					case SCALAR:
-						// Read one value.
-						if (!read_value(prop->data_type, dval)) return false;
-						if (store_prop && !value->set_scalar(*prop, dval))
+					value = obj->get_value(elem, *prop);
+				store_prop = obj && value && prop->store;
+
+				// Binary values that are not stored are skipped.
+				if (!store_prop && header.stream_type != ASCII) {
+					if (!skip_property(*prop)) return false;
+					continue;
+				}
+
+				// Read the property.
+				switch (prop->type) {
+				case SCALAR:
+					// Read one value.
+					if (!read_value(prop->data_type, dval)) return false;
+					if (store_prop && !value->set_scalar(*prop, dval))
+						HANDLE_FAULT("Reader::read_data : invalid object");
+					break;
+				case STRING:
+					if (header.stream_type == ASCII) {
+						// Strings are stored differently in ASCII.
+						if (!read_ascii_string(str)) return false;
+						if (store_prop && !value->set_string(*prop, str))
 							HANDLE_FAULT("Reader::read_data : invalid object");
-						break;
-					case STRING:
-						if (header.stream_type == ASCII) {
-							// Strings are stored differently in ASCII.
-							read_ascii_string(str);
-							if (store_prop && !value->set_string(*prop, str))
-								HANDLE_FAULT("Reader::read_data : invalid object");
-						}
-						else {
-							// Read the size (this includes the '\0').
-							if (!read_size(Int8, size)) return false;
-							// Read the characters (including the '\0').
-							for (size_t n = 0; n < size; ++n) {
-								if (!read_value(Int8, dval)) return false;
-								str[n] = (char)dval;
-							}
-							// Store the string.
-							if (store_prop && !value->set_string(*prop, str))
-								HANDLE_FAULT("Reader::read_data : invalid object");
+					}
+					else {
+						// Read the size (this includes the '\0').
+						if (!read_size(Int8, size)) return false;
+						// Read the characters (including the '\0').
+						for (size_t n = 0; n < size; ++n) {
+							if (!read_value(Int8, dval)) return false;
+							str[n] = (char)dval;
 						}
-						break;
-					case LIST:
-						// Read the size.
-						if (!read_size(prop->size_type, size)) return false;
-						if (store_prop && !value->set_size(*prop, size))
+						// Store the string.
+						if (store_prop && !value->set_string(*prop, str))
 							HANDLE_FAULT("Reader::read_data : invalid object");
-						// Read the items.
-						for (size_t n = 0; n < size; ++n) {
-							if (!read_value(prop->data_type, dval)) return false;
-							if (store_prop && !value->set_item(*prop, n, dval))
-								HANDLE_FAULT("Reader::read_data : invalid object");
+					}
+					break;
+				case LIST:
+					// Read the size.
+					if (!read_size(prop->size_type, size)) return false;
+					if (store_prop && !value->set_size(*prop, size))
+						HANDLE_FAULT("Reader::read_data : invalid object");
+					// Read the items.
+					for (size_t n = 0; n < size; ++n) {
+						if (!read_value(prop->data_type, dval)) return false;
+						if (store_prop && !value->set_item(*prop, n, dval))
+							HANDLE_FAULT("Reader::read_data : invalid object");
+					}
+					break;
+				}
+			}
+		}
+		return true;
+	}
+
+	// Prepare to read the data in batches.
+	bool Reader::start_batches(size_t rows) {
+		if (!init_stream())
+			HANDLE_FAULT("Reader::start_batches : stream initialization failed");
+		batches.reset(new ColumnStorage(header));
+		batch_rows = std::max<size_t>(1, rows);
+		batch_elem = 0;
+		batch_row = 0;
+		return true;
+	}
+
+	// Get the columns that the batches of an Element are read into.
+	ColumnArray* Reader::batch_columns(const char* elem_name) {
+		return batches ? batches->get_columns(elem_name) : nullptr;
+	}
+
+	// Continue the batches at the start of an Element.
+	bool Reader::seek_element(const char* elem_name, size_t offset) {
+		size_t e;
+		if (!batches)
+			HANDLE_FAULT("Reader::seek_element : the batches have not been started");
+		if (header.stream_type == ASCII)
+			HANDLE_FAULT("Reader::seek_element : ASCII data cannot be skipped");
+		if (!header.find_index(elem_name, e))
+			HANDLE_FAULT("Reader::seek_element : unknown element");
+
+		if (mapped) {
+			if (offset > mapped_size)
+				HANDLE_FAULT("Reader::seek_element : offset past the end of the file");
+			mapped_pos = offset;
+		}
+		else if (source->isSequential() || !source->seek((qint64)offset))
+			HANDLE_FAULT("Reader::seek_element : the device cannot seek");
+		batch_elem = e;
+		batch_row = 0;
+		return true;
+	}
+
+	// Find the byte offset of each Element in the file.
+	bool Reader::element_offsets(std::vector<size_t>& offsets) {
+		if (header.stream_type == ASCII)
+			HANDLE_FAULT("Reader::element_offsets : ASCII data cannot be skipped");
+		if (mapped) {
+			if (!locate_elements()) return false;
+			offsets = elem_offsets;
+			return true;
+		}
+
+		ElementPlan plan;
+		offsets.assign(1, (size_t)source->pos());
+		for (size_t e = 0; e < header.elements.size(); ++e) {
+			plan.compile(header.elements[e]);
+			if (!skip_rows(plan, header.elements[e].num)) return false;
+			offsets.push_back((size_t)source->pos());
+		}
+		return true;
+	}
+
+	// Read the next batch of rows.
+	bool Reader::next_batch(Batch& batch) {
+		if (!batches) return false;
+		ElementPlan plan;
+		while (batch_elem < header.elements.size()) {
+			const Element& elem = header.elements[batch_elem];
+			if (batch_row >= elem.num) {
+				++batch_elem;
+				batch_row = 0;
+				continue;
+			}
+
+			const size_t first = batch_row;
+			const size_t count = std::min(batch_rows, elem.num - first);
+			batch_row += count;
+			if (!elem.store) {
+				// Read past the rows.
+				if (header.stream_type != ASCII) {
+					plan.compile(elem);
+					if (!skip_rows(plan, elem.num - first)) return false;
+					batch_row = elem.num;
+				}
+				else if (!read_objects(elem, 0, count))
+					return false;
+				continue;
+			}
+
+			// The columns move when prepared, so they are bound for each batch.
+			ColumnArray* rows = batches->get_columns(elem.name.c_str());
+			rows->prepare(count);
+			if (header.stream_type != ASCII && plan.compile(elem) && rows->bind(elem, plan)) {
+				plan.specialize();
+				if (!read_rows(plan, count)) return false;
+			}
+			else if (header.stream_type != ASCII && !plan.fixed) {
+				if (!read_uniform(elem, rows, count)) return false;
+			}
+			else if (!read_objects(elem, rows, count))
+				return false;
+
+			batch.elem = &elem;
+			batch.first = first;
+			batch.rows = rows;
+			return true;
+		}
+		return false;
+	}
+
+	namespace {
+		// The fewest rows worth giving to a thread.
+		const size_t MIN_RANGE_ROWS = 4096;
+
+		// The lines of an ASCII data section.
+		struct AsciiLines {
+			const char* begin;				// The first character.
+			const char* end;				// One past the last character.
+			std::vector<size_t> newlines;	// The newlines before each block.
+
+			// Count the newlines of each block in parallel.
+			AsciiLines(const char* b, const char* e, int threads): begin(b), end(e) {
+				size_t blocks = (end - begin + BLOCK_BYTES - 1) / BLOCK_BYTES;
+				newlines.assign(blocks + 1, 0);
+				parallel_for(blocks, [this](size_t n) {
+					const char* ptr = begin + n*BLOCK_BYTES;
+					const char* stop = std::min(ptr + BLOCK_BYTES, end);
+					newlines[n+1] = std::count(ptr, stop, '\n');
+				}, threads);
+				for (size_t n = 0; n < blocks; ++n)
+					newlines[n+1] += newlines[n];
+			}
+
+			// Get the number of lines, including a last line without newline.
+			size_t lines() const {
+				return newlines.back() + (begin < end && end[-1] != '\n' ? 1 : 0);
+			}
+
+			// Get the first character of a line (or end if there is no such line).
+			const char* line(size_t num) const {
+				if (num == 0) return begin;
+				if (num > newlines.back()) return end;
+				// Find the block containing the newline ending the previous line.
+				size_t block = std::lower_bound(newlines.begin(), newlines.end(), num) - newlines.begin() - 1;
+				const char* ptr = begin + block*BLOCK_BYTES;
+				for (size_t n = newlines[block]; n < num; ++n)
+					ptr = (const char*)std::memchr(ptr, '\n', end - ptr) + 1;
+				return ptr;
+			}
+		}; // struct AsciiLines
+
+		// A range of rows of an Element, decoded by one thread.
+		struct AsciiRange {
+			const char* begin;				// The first character of the rows.
+			const char* end;				// One past the last character of the rows.
+			size_t first;					// The index of the first row.
+			size_t count;					// The number of rows.
+			bool valid;						// Whether the rows were decoded.
+			std::vector<std::vector<size_t> > sizes;	// The list sizes of each Property.
+			std::vector<std::vector<double> > items;	// The list items of each Property.
+
+			// Decode the rows, storing scalars in their destinations and collecting lists.
+			bool decode(const Element& elem, const ElementPlan& plan) {
+				AsciiScanner scan;
+				scan.use_memory(begin, end - begin);
+				sizes.resize(elem.props.size());
+				items.resize(elem.props.size());
+
+				double dval;
+				size_t size;
+				for (size_t n = 0; n < count; ++n) {
+					for (size_t p = 0; p < elem.props.size(); ++p) {
+						if (!scan.next_value(dval)) return false;
+						if (elem.props[p].type == SCALAR) {
+							if (plan.props[p].dest.bound())
+								plan.props[p].dest.set(first + n, dval);
+							continue;
+						}
+						size = (size_t)dval;
+						if (elem.props[p].store)
+							sizes[p].push_back(size);
+						for (size_t i = 0; i < size; ++i) {
+							if (!scan.next_value(dval)) return false;
+							if (elem.props[p].store)
+								items[p].push_back(dval);
 						}
-						break;
 					}
 				}
+
+				// The rows must end exactly at the end of their lines.
+				const char* word;
+				return !scan.next_word(word, size);
+			}
+		}; // struct AsciiRange
+	} // namespace
+
+	// Read all ASCII data, decoding ranges of lines in parallel.
+	bool Reader::read_ascii_parallel(Storage* store) {
+		// All data must be in memory to be split.
+		std::vector<char> buffer;
+		const char* begin;
+		const char* end;
+		if (mapped) {
+			begin = mapped + mapped_pos;
+			end = mapped + mapped_size;
+		}
+		else {
+			size_t used = 0;
+			for (;;) {
+				buffer.resize(used + BLOCK_BYTES);
+				qint64 got = source->read(buffer.data() + used, BLOCK_BYTES);
+				if (got <= 0) break;
+				used += (size_t)got;
+			}
+			buffer.resize(used);
+			begin = buffer.data();
+			end = begin + used;
+		}
+
+		AsciiLines lines(begin, end, threads);
+		const int ranges = 4 * parallel_threads(threads);
+		size_t line = 0;
+		Array* collect;
+		ElementPlan plan;
+		for (size_t e = 0; e < header.elements.size(); ++e) {
+			const Element& elem = header.elements[e];
+			const char* elem_begin = lines.line(line);
+			size_t first_line = line;
+			line += elem.num;
+			if (line > lines.lines())
+				HANDLE_FAULT("Reader::read_ascii_parallel : unexpected end of data");
+
+			collect = 0;
+			if (store && elem.store)
+				collect = store->get_collection(header, elem);
+			if (collect == 0) {
+				if (element_read) element_read(elem);
+				continue;
+			}
+			collect->prepare(elem);
+
+			// Arrays that cannot bind and strings are read serially.
+			bool strings = false;
+			for (size_t p = 0; p < elem.props.size(); ++p)
+				strings = strings || elem.props[p].type == STRING;
+			plan.compile(elem);
+			if (strings || !collect->bind(elem, plan)) {
+				scanner.use_memory(elem_begin, end - elem_begin);
+				if (!read_objects(elem, collect, elem.num)) return false;
+				if (element_read) element_read(elem);
+				continue;
+			}
+
+			// Decode the ranges of rows.
+			size_t count = std::max<size_t>(1, std::min<size_t>(ranges, elem.num / MIN_RANGE_ROWS));
+			std::vector<AsciiRange> parts(count);
+			for (size_t i = 0; i < count; ++i) {
+				parts[i].first = elem.num * i / count;
+				parts[i].count = elem.num * (i+1) / count - parts[i].first;
+				parts[i].begin = lines.line(first_line + parts[i].first);
+				parts[i].end = lines.line(first_line + parts[i].first + parts[i].count);
+			}
+			parallel_for(count, [&](size_t i) {
+				parts[i].valid = parts[i].decode(elem, plan);
+			}, threads);
+			for (size_t i = 0; i < count; ++i)
+				if (!parts[i].valid)
+					HANDLE_FAULT("Reader::read_ascii_parallel : each row must be on a line of its own");
+
+			// Store the list items after each other.
+			for (size_t p = 0; p < elem.props.size(); ++p) {
+				if (elem.props[p].type != LIST || !elem.props[p].store) continue;
+				std::vector<size_t> sizes;
+				std::vector<size_t> offsets(1, 0);
+				sizes.reserve(elem.num);
+				for (size_t i = 0; i < count; ++i) {
+					sizes.insert(sizes.end(), parts[i].sizes[p].begin(), parts[i].sizes[p].end());
+					offsets.push_back(offsets.back() + parts[i].items[p].size());
+				}
+				Binding dest;
+				if (!collect->bind_list(elem, elem.props[p], sizes, dest))
+					HANDLE_FAULT("Reader::read_ascii_parallel : invalid list");
+				parallel_for(count, [&](size_t i) {
+					const std::vector<double>& items = parts[i].items[p];
+					convert((const char*)items.data(), sizeof(double), Float64,
+						dest.data + offsets[i]*dest.stride, dest.stride, dest.type, items.size(), false);
+				}, threads);
 			}
+
+			// The rows are complete, so they can be used before the next Element is decoded.
+			if (element_read) element_read(elem);
 		}
 		return true;
 	}
-	
+
 	bool Reader::read_stream_type(const std::string& word, Stream_type& type) {
 		if (word.compare("ascii") == 0)
 			header.stream_type = ASCII;
@@ -328,7 +704,8 @@ namespace PLY {
 		case Uint32:
 		case Float32:
 		case Float64:
-            *tStream >> value;
+			if (!scanner.next_value(value))
+				HANDLE_FAULT("Reader::read_ascii_value : invalid number");
 			break;
 		}
 		return true;
@@ -381,34 +758,419 @@ namespace PLY {
 	}
 
 	void Reader::read(char* ptr, size_t num) {
-        source->read(ptr, num);
+		if (mapped) {
+			size_t got = std::min(num, mapped_size - mapped_pos);
+			std::memcpy(ptr, mapped + mapped_pos, got);
+			std::memset(ptr + got, 0, num - got);
+			mapped_pos += got;
+		}
+		else
+			source->read(ptr, num);
 		header.apply_stream_type(ptr, num);
 	}
 
-	void Reader::read_ascii_string(char* str) {
-		WhiteSpace ignore;
-		// Ignore leading white-space.
-        tStream->skipWhiteSpace();
-        *tStream >> *str;
-        if (*str == '\"') {
-            // Extend the string to the next quote.
-            int len = 1;
-            for (; len < BIG_STRING-1; ++len)
-                *tStream >> str[len];
-                if (str[len] == '\"' ||
-                    str[len] == '\0')
-                        return;
-            str[len] = '\0';
-        } else {
-			// Extend the string to the next white-space.
-			int len = 1;
-			for (; len < BIG_STRING-1; ++len)
-                *tStream >> str[len];
-				if (ignore(str[len]) ||
-					str[len] == '\0')
-						return;
-			str[len] = '\0';
+	bool Reader::read_block(char* ptr, size_t num) {
+		if (mapped) {
+			if (num > mapped_size - mapped_pos) return false;
+			std::memcpy(ptr, mapped + mapped_pos, num);
+			mapped_pos += num;
+			return true;
 		}
+
+		// The device may return less than asked for (e.g. while inflating).
+		while (num > 0) {
+			qint64 got = source->read(ptr, (qint64)num);
+			if (got <= 0) return false;
+			ptr += got;
+			num -= (size_t)got;
+		}
+		return true;
+	}
+
+	bool Reader::skip_peeked(size_t num) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
+		// Peeked data is held by the device, which drops it without copying it again.
+		return source->skip((qint64)num) == (qint64)num;
+#else
+		return skip_block(num);
+#endif
+	}
+
+	bool Reader::skip_block(size_t num) {
+		if (mapped) {
+			if (num > mapped_size - mapped_pos) return false;
+			mapped_pos += num;
+			return true;
+		}
+
+		// Seeking is only worth it for larger gaps.
+		if (num >= BLOCK_BYTES / 16 && !source->isSequential()) {
+			if (source->pos() + (qint64)num > source->size()) return false;
+			return source->seek(source->pos() + (qint64)num);
+		}
+		char scratch[4096];
+		while (num > 0) {
+			size_t part = std::min(num, sizeof(scratch));
+			if (!read_block(scratch, part)) return false;
+			num -= part;
+		}
+		return true;
+	}
+
+	bool Reader::skip_rows(const ElementPlan& plan, size_t num) {
+		if (plan.fixed) {
+			if (!skip_block(num * plan.stride))
+				HANDLE_FAULT("Reader::skip_rows : unexpected end of data");
+			return true;
+		}
+
+		const bool swap = header.stream_type != header.system();
+		size_t bytes;
+		if (mapped) {
+			if (!plan.measure(mapped + mapped_pos, mapped_size - mapped_pos, num, swap, bytes))
+				HANDLE_FAULT("Reader::skip_rows : unexpected end of data");
+			mapped_pos += bytes;
+			return true;
+		}
+
+		// Only the sizes are read; everything in between is skipped at once.
+		char raw[8];
+		unsigned int size;
+		bytes = 0;
+		for (size_t n = 0; n < num; ++n) {
+			for (size_t p = 0; p < plan.props.size(); ++p) {
+				const PropertyPlan& prop = plan.props[p];
+				if (prop.kind == SCALAR) {
+					bytes += ply_type_bytes[prop.type];
+					continue;
+				}
+				if (!skip_block(bytes) || !read_block(raw, ply_type_bytes[prop.size_type]))
+					HANDLE_FAULT("Reader::skip_rows : unexpected end of data");
+				convert(raw, 0, prop.size_type, (char*)&size, 0, Uint32, 1, swap);
+				bytes = size * ply_type_bytes[prop.type];
+			}
+		}
+		if (!skip_block(bytes))
+			HANDLE_FAULT("Reader::skip_rows : unexpected end of data");
+		return true;
+	}
+
+	bool Reader::skip_property(const Property& prop) {
+		size_t size = 1;
+		if (prop.type != SCALAR && !read_size(prop.type == STRING ? Int8 : prop.size_type, size))
+			return false;
+		if (!skip_block(size * ply_type_bytes[prop.type == STRING ? Int8 : prop.data_type]))
+			HANDLE_FAULT("Reader::skip_property : unexpected end of data");
+		return true;
+	}
+
+	bool Reader::read_rows(const ElementPlan& plan, size_t num) {
+		if (num == 0 || plan.stride == 0) return true;
+
+		// Decode as many rows as fit in one block at a time.
+		// Rows in the other byte order are first swapped as a whole block.
+		const size_t rows = std::max<size_t>(1, BLOCK_BYTES / plan.stride);
+		if (threads != 1 && num > rows)
+			return read_rows_parallel(plan, num, rows);
+
+		const bool swap = header.stream_type != header.system();
+		std::vector<char> swapped(swap ? std::min(rows, num) * plan.stride : 0);
+		if (mapped) {
+			// Decode straight from the map, one block at a time to stay in cache.
+			if (num * plan.stride > mapped_size - mapped_pos)
+				HANDLE_FAULT("Reader::read_rows : unexpected end of data");
+			for (size_t first = 0; first < num; first += rows) {
+				size_t count = std::min(rows, num - first);
+				const char* block = mapped + mapped_pos;
+				if (swap) {
+					plan.swap.apply(block, count, swapped.data());
+					block = swapped.data();
+				}
+				plan.decode(block, count, first, false);
+				mapped_pos += count * plan.stride;
+			}
+			return true;
+		}
+
+		std::vector<char> block(std::min(rows, num) * plan.stride);
+		for (size_t first = 0; first < num; first += rows) {
+			size_t count = std::min(rows, num - first);
+			if (!read_block(block.data(), count * plan.stride))
+				HANDLE_FAULT("Reader::read_rows : unexpected end of data");
+			if (swap) {
+				plan.swap.apply(block.data(), count, swapped.data());
+				plan.decode(swapped.data(), count, first, false);
+			}
+			else
+				plan.decode(block.data(), count, first, false);
+		}
+		return true;
+	}
+
+	bool Reader::read_rows_parallel(const ElementPlan& plan, size_t num, size_t rows) {
+		// Each block is swapped into a buffer of its own, if needed, and decoded.
+		const bool swap = header.stream_type != header.system();
+		auto decode = [&](const char* block, size_t count, size_t first) {
+			if (swap) {
+				std::vector<char> swapped(count * plan.stride);
+				plan.swap.apply(block, count, swapped.data());
+				plan.decode(swapped.data(), count, first, false);
+			}
+			else
+				plan.decode(block, count, first, false);
+		};
+
+		if (mapped) {
+			if (num * plan.stride > mapped_size - mapped_pos)
+				HANDLE_FAULT("Reader::read_rows_parallel : unexpected end of data");
+			const char* data = mapped + mapped_pos;
+			parallel_for((num + rows - 1) / rows, [&](size_t b) {
+				decode(data + b*rows*plan.stride, std::min(rows, num - b*rows), b*rows);
+			}, threads);
+			mapped_pos += num * plan.stride;
+			return true;
+		}
+
+		// Read a block for each thread at a time, and decode those in parallel.
+		const size_t group = rows * parallel_threads(threads);
+		std::vector<char> buffer(std::min(group, num) * plan.stride);
+		for (size_t first = 0; first < num; first += group) {
+			size_t count = std::min(group, num - first);
+			if (!read_block(buffer.data(), count * plan.stride))
+				HANDLE_FAULT("Reader::read_rows_parallel : unexpected end of data");
+			parallel_for((count + rows - 1) / rows, [&](size_t b) {
+				decode(buffer.data() + b*rows*plan.stride, std::min(rows, count - b*rows), first + b*rows);
+			}, threads);
+		}
+		return true;
+	}
+
+	bool Reader::peek_sizes(const Element& elem, std::vector<size_t>& sizes) {
+		char row[4096];
+		const char* data = row;
+		size_t available;
+		if (mapped) {
+			data = mapped + mapped_pos;
+			available = mapped_size - mapped_pos;
+		}
+		else {
+			qint64 got = source->peek(row, sizeof(row));
+			if (got <= 0) return false;
+			available = (size_t)got;
+		}
+
+		const bool swap = header.stream_type != header.system();
+		unsigned int size;
+		size_t pos = 0;
+		sizes.assign(elem.props.size(), 0);
+		for (size_t p = 0; p < elem.props.size(); ++p) {
+			const Property& prop = elem.props[p];
+			if (prop.type == STRING) return false;
+			if (prop.type == LIST) {
+				if (pos + ply_type_bytes[prop.size_type] > available) return false;
+				convert(data + pos, 0, prop.size_type, (char*)&size, 0, Uint32, 1, swap);
+				sizes[p] = size;
+				pos += ply_type_bytes[prop.size_type];
+			}
+			pos += sizes[p] * ply_type_bytes[prop.data_type];
+			if (prop.type == SCALAR)
+				pos += ply_type_bytes[prop.data_type];
+		}
+		return pos <= available;
+	}
+
+	bool Reader::read_uniform(const Element& elem, Array* collect, size_t num) {
+		ElementPlan plan;
+		std::vector<size_t> sizes;
+		size_t done = 0;
+		bool bound = num > 0 && peek_sizes(elem, sizes) &&
+			plan.compile_uniform(elem, sizes) && collect->bind(elem, plan);
+		for (size_t p = 0; bound && p < elem.props.size(); ++p)
+			if (elem.props[p].type == LIST && elem.props[p].store && !plan.props[p].dest.bound())
+				bound = collect->bind_uniform_list(elem, elem.props[p], sizes[p], plan.props[p].dest);
+
+		if (bound) {
+			plan.specialize();
+			// The sizes are checked for each block before it is decoded,
+			// and only the rows before the first list of another size are taken.
+			const size_t rows = std::max<size_t>(1, BLOCK_BYTES / plan.stride);
+			const bool swap = header.stream_type != header.system();
+			std::vector<char> block(mapped ? 0 : std::min(rows, num) * plan.stride);
+			std::vector<char> swapped(swap ? std::min(rows, num) * plan.stride : 0);
+			while (done < num) {
+				size_t count = std::min(rows, num - done);
+				const char* data;
+				if (mapped) {
+					count = std::min(count, (mapped_size - mapped_pos) / plan.stride);
+					data = mapped + mapped_pos;
+				}
+				else {
+					qint64 got = source->peek(block.data(), (qint64)(count * plan.stride));
+					count = got > 0 ? (size_t)got / plan.stride : 0;
+					data = block.data();
+				}
+
+				size_t good = plan.uniform_rows(data, count, swap);
+				if (good == 0) break;
+				if (swap) {
+					plan.swap.apply(data, good, swapped.data());
+					plan.decode(swapped.data(), good, done, false);
+				}
+				else
+					plan.decode(data, good, done, false);
+				if (mapped)
+					mapped_pos += good * plan.stride;
+				else if (!skip_peeked(good * plan.stride))
+					HANDLE_FAULT("Reader::read_uniform : unexpected end of data");
+				done += good;
+				if (good < count) break;
+			}
+		}
+
+		// The remaining rows are read one at a time.
+		if (done < num) {
+			collect->restart();
+			for (size_t n = 0; n < done; ++n)
+				collect->next_object();
+			return read_objects(elem, collect, num - done);
+		}
+		return true;
+	}
+
+	bool Reader::read_varying(const Element& elem, Array* collect, size_t num) {
+		ElementPlan plan;
+		plan.compile(elem);
+		bool strings = false;
+		for (size_t p = 0; p < elem.props.size(); ++p)
+			strings = strings || elem.props[p].type == STRING;
+		if (num == 0 || strings || !collect->bind(elem, plan))
+			return read_uniform(elem, collect, num);
+
+		// Scan the sizes of the lists, and note where each range of rows starts.
+		// The sizes are only kept once they stop being the same as in the first row.
+		const bool swap = header.stream_type != header.system();
+		const size_t ranges = std::max<size_t>(1, std::min<size_t>(4 * parallel_threads(threads), num / MIN_RANGE_ROWS));
+		const char* data = mapped + mapped_pos;
+		const size_t available = mapped_size - mapped_pos;
+		std::vector<std::vector<size_t>> sizes(elem.props.size());
+		std::vector<size_t> row_sizes(elem.props.size(), 0);
+		std::vector<size_t> first_sizes;
+		std::vector<size_t> items(elem.props.size(), 0);
+		std::vector<size_t> starts;
+		std::vector<std::vector<size_t>> start_items;
+		bool uniform = true;
+		unsigned int size;
+		size_t pos = 0;
+		for (size_t n = 0; n < num; ++n) {
+			if (n == num * starts.size() / ranges) {
+				starts.push_back(pos);
+				start_items.push_back(items);
+			}
+			for (size_t p = 0; p < plan.props.size(); ++p) {
+				const PropertyPlan& prop = plan.props[p];
+				if (prop.kind == SCALAR) {
+					pos += ply_type_bytes[prop.type];
+					continue;
+				}
+				if (pos + ply_type_bytes[prop.size_type] > available)
+					HANDLE_FAULT("Reader::read_varying : unexpected end of data");
+				convert(data + pos, 0, prop.size_type, (char*)&size, 0, Uint32, 1, swap);
+				row_sizes[p] = size;
+				items[p] += size;
+				pos += ply_type_bytes[prop.size_type] + size * ply_type_bytes[prop.type];
+			}
+			if (pos > available)
+				HANDLE_FAULT("Reader::read_varying : unexpected end of data");
+
+			if (n == 0)
+				first_sizes = row_sizes;
+			else if (uniform && row_sizes != first_sizes) {
+				uniform = false;
+				for (size_t p = 0; p < elem.props.size(); ++p)
+					if (elem.props[p].type == LIST && elem.props[p].store)
+						sizes[p].assign(n, first_sizes[p]);
+			}
+			if (!uniform)
+				for (size_t p = 0; p < elem.props.size(); ++p)
+					if (elem.props[p].type == LIST && elem.props[p].store)
+						sizes[p].push_back(row_sizes[p]);
+		}
+
+		// Rows whose lists all have the same size are decoded in parallel blocks.
+		if (uniform) {
+			bool bound = plan.compile_uniform(elem, first_sizes) && collect->bind(elem, plan);
+			for (size_t p = 0; bound && p < elem.props.size(); ++p)
+				if (elem.props[p].type == LIST && elem.props[p].store && !plan.props[p].dest.bound())
+					bound = collect->bind_uniform_list(elem, elem.props[p], first_sizes[p], plan.props[p].dest);
+			if (!bound)
+				return read_uniform(elem, collect, num);
+			plan.specialize();
+			return read_rows(plan, num);
+		}
+
+		for (size_t p = 0; p < elem.props.size(); ++p)
+			if (elem.props[p].type == LIST && elem.props[p].store &&
+				!collect->bind_list(elem, elem.props[p], sizes[p], plan.props[p].dest))
+				return read_uniform(elem, collect, num);
+
+		// Decode the ranges of rows, starting from the items noted for each.
+		parallel_for(ranges, [&](size_t r) {
+			std::vector<size_t> next(start_items[r]);
+			size_t first = num * r / ranges;
+			plan.decode_varying(data + starts[r], num * (r+1) / ranges - first, first, next, swap);
+		}, threads);
+		mapped_pos += pos;
+		return true;
+	}
+
+	bool Reader::locate_span(const char* elem_name, const char* prop_name, const Scalar_type& type,
+		const char*& data, size_t& stride, size_t& count) {
+		if (!mapped)
+			HANDLE_FAULT("Reader::span : the file is not mapped");
+		if (header.stream_type != header.system())
+			HANDLE_FAULT("Reader::span : the data is not in the byte order of the system");
+
+		size_t e, p;
+		if (!header.find_index(elem_name, e) || !header.elements[e].find_index(prop_name, p))
+			HANDLE_FAULT("Reader::span : unknown property");
+		const Element& elem = header.elements[e];
+		if (elem.props[p].type != SCALAR || elem.props[p].data_type != type)
+			HANDLE_FAULT("Reader::span : invalid property type");
+
+		ElementPlan plan;
+		if (!plan.compile(elem))
+			HANDLE_FAULT("Reader::span : the rows vary in size");
+		if (!locate_elements())
+			return false;
+
+		data = mapped + elem_offsets[e] + plan.props[p].offset;
+		stride = plan.stride;
+		count = elem.num;
+		return true;
+	}
+
+	bool Reader::locate_elements() {
+		// The first offset (the start of the data) is known after mapping.
+		if (elem_offsets.size() > header.elements.size())
+			return true;
+
+		ElementPlan plan;
+		size_t bytes;
+		const bool swap = header.stream_type != header.system();
+		for (size_t e = elem_offsets.size() - 1; e < header.elements.size(); ++e) {
+			plan.compile(header.elements[e]);
+			size_t start = elem_offsets.back();
+			if (!plan.measure(mapped + start, mapped_size - start, header.elements[e].num, swap, bytes))
+				HANDLE_FAULT("Reader::locate_elements : unexpected end of data");
+			elem_offsets.push_back(start + bytes);
+		}
+		return true;
+	}
+
+	bool Reader::read_ascii_string(char* str) {
+		if (!scanner.next_string(str))
+			HANDLE_FAULT("Reader::read_ascii_string : unexpected end of data");
+		return true;
 	}
 	
     bool Writer::use_io_device(QIODevice* dev, const Stream_type& type) {
@@ -434,15 +1196,27 @@ namespace PLY {
         // Crate a QFile for use as our QIODevice
         QFile* file = new QFile(file_name);
         srcOwned = true;
+        if (is_gzip_file(file_name))
+            return use_io_device(new DeflateDevice(file, true), type);
         return use_io_device(file, type);
     }
 	
 	// Close the writer.
-	void Writer::close_file() {
+	bool Writer::close_file() {
+        bool ok = true;
+        if (source)
+            ok = flush();
         delete tStream;
         tStream = nullptr;
 
         if (source) {
+            // Complete the stream before closing, as close() cannot report a failure.
+            DeflateDevice* gz = dynamic_cast<DeflateDevice*>(source);
+            QFileDevice* file = dynamic_cast<QFileDevice*>(source);
+            if (gz && !gz->finish())
+                ok = false;
+            else if (file && (!file->flush() || file->error() != QFileDevice::NoError))
+                ok = false;
             source->close();
         }
         if (srcOwned) {
@@ -450,6 +1224,7 @@ namespace PLY {
         }
         srcOwned = false;
         source = nullptr;
+        return ok;
     }
 
 	// Write the ply header to the current stream.
@@ -457,6 +1232,8 @@ namespace PLY {
         // Check the source.
         if (!source->isOpen() || !source->isWritable())
             HANDLE_FAULT("Writer::write_header : invalid source");
+        if (!flush())
+            return false;
 
         // The header is always in ASCII (we write directly to the QIODevice)
         // First, write the magic letters, ply.
@@ -532,7 +1309,7 @@ namespace PLY {
 					break;
 				case SCALAR:
                     //(*stream) << "property " << type_names[prop->data_type] << " " << prop->name << std::endl;
-                    source->write("property \n");
+                    source->write("property ");
                     source->write(type_names[prop->data_type]); source->write(" ");
                     source->write(prop->name.c_str());
                     source->write("\n");
@@ -570,15 +1347,124 @@ namespace PLY {
 		// Write the header.
 		if (!write_header())
 			return false;
-		
+
 		// The data is written in the same order as the elements.
+		ElementPlan plan;
 		for (size_t e = 0; e < header.elements.size(); ++e) {
 			elem = &header.elements[e];
 			if (!elem->store) continue;
 			collect = store->get_collection(header, *elem);
+
+			// Rows of typed arrays are encoded in blocks.
+			plan.compile(*elem);
+			if (collect && collect->view(*elem, plan)) {
+				if (!write_rows(plan, elem->num)) return false;
+				continue;
+			}
+
 			if (!write_element(*elem, collect))
 				return false;
 		}
+		return flush();
+	}
+
+	// Write the header and the data set from memory.
+	bool Writer::write_sources() {
+		if (!write_header())
+			return false;
+
+		ElementPlan plan;
+		for (size_t e = 0; e < header.elements.size(); ++e) {
+			const Element& elem = header.elements[e];
+			if (!elem.store) continue;
+			plan.compile(elem);
+			for (size_t p = 0; p < elem.props.size(); ++p) {
+				if (!elem.props[p].store) continue;
+				if (e >= sources.size() || !sources[e][p].bound())
+					HANDLE_FAULT("Writer::write_sources : no values for " << elem.name << " " << elem.props[p].name);
+				plan.props[p].source = sources[e][p];
+			}
+			if (!write_rows(plan, elem.num)) return false;
+		}
+		return flush();
+	}
+
+	// Write a batch of consecutive rows of one Element.
+	bool Writer::write_batch(const Element& elem, Array* rows) {
+		if (rows == 0) return false;
+		ElementPlan plan;
+		plan.compile(elem);
+		if (rows->view(elem, plan)) {
+			if (!write_rows(plan, rows->size())) return false;
+		}
+		else {
+			rows->restart();
+			for (size_t n = 0; n < rows->size(); ++n)
+				if (!write_object(elem, &rows->next_object()))
+					return false;
+		}
+		return flush();
+	}
+
+	// Set where the values of a Property are taken from.
+	bool Writer::set_source(const char* elem_name, const char* prop_name, const Source& src) {
+		size_t e, p;
+		if (!header.find_index(elem_name, e) || !header.elements[e].find_index(prop_name, p))
+			HANDLE_FAULT("Writer::set_source : unknown property");
+		const Property& prop = header.elements[e].props[p];
+		if (prop.type == STRING || (prop.type == LIST) != src.list())
+			HANDLE_FAULT("Writer::set_source : invalid property type");
+
+		sources.resize(header.elements.size());
+		sources[e].resize(header.elements[e].props.size());
+		sources[e][p] = src;
+		return true;
+	}
+
+	// Encode all rows of an Element from the sources in the plan.
+	bool Writer::write_rows(const ElementPlan& plan, size_t num) {
+		if (header.stream_type != ASCII) {
+			// Rows with every value in the file can change byte order as a whole block.
+			const bool swap = header.stream_type != header.system();
+			bool whole = swap && plan.swap.valid();
+			for (size_t p = 0; whole && p < plan.props.size(); ++p)
+				whole = plan.props[p].source.bound();
+
+			std::vector<char> block;
+			for (size_t first = 0; first < num; first += BLOCK_ROWS) {
+				const size_t count = std::min(BLOCK_ROWS, num - first);
+				if (whole) {
+					block.clear();
+					plan.encode(first, count, false, block);
+					const size_t start = buffer.size();
+					buffer.resize(start + block.size());
+					plan.swap.apply(block.data(), count, buffer.data() + start);
+				}
+				else
+					plan.encode(first, count, swap, buffer);
+				if (buffer.size() >= BLOCK_BYTES && !flush())
+					return false;
+			}
+			return true;
+		}
+
+		// ASCII rows are formatted in parallel blocks, which are written in order.
+		const size_t blocks = (num + BLOCK_ROWS - 1) / BLOCK_ROWS;
+		const size_t batch = 4 * parallel_threads(threads);
+		std::vector<std::vector<char> > text(std::min(batch, blocks));
+		for (size_t b = 0; b < blocks; b += batch) {
+			const size_t count = std::min(batch, blocks - b);
+			parallel_for(count, [&](size_t i) {
+				const size_t first = (b + i) * BLOCK_ROWS;
+				text[i].clear();
+				plan.format(first, std::min(BLOCK_ROWS, num - first), text[i]);
+			}, threads);
+			for (size_t i = 0; i < count; ++i) {
+				buffer.insert(buffer.end(), text[i].begin(), text[i].end());
+				if (buffer.size() >= BLOCK_BYTES && !flush())
+					return false;
+			}
+		}
 		return true;
 	}
 
@@ -592,31 +1478,18 @@ namespace PLY {
 			obj = &collect->next_object();
 			if (!obj || !write_object(elem, obj))
 				return false;
+			if (buffer.size() >= BLOCK_BYTES && !flush())
+				return false;
 		}
 		return true;
 	}
 	
 	bool Writer::write_ascii_value(const Scalar_type& type, const double& value) {
-		switch (type) {
-		default:
-		case StartType:
-		case EndType:
+		char str[VALUE_CHARS];
+		size_t len = format_value((const char*)&value, Float64, type, str);
+		if (len == 0)
 			return false;
-		case Int8:
-		case Int16:
-		case Int32:
-		case Uint8:
-		case Uint16:
-            (*tStream) << (int)value;
-			break;
-		case Uint32:
-            (*tStream) << (unsigned int)value;
-			break;
-		case Float32:
-		case Float64:
-            (*tStream) << value;
-			break;
-		}
+		buffer.insert(buffer.end(), str, str + len);
 		return true;
 	}
 
@@ -671,7 +1544,18 @@ namespace PLY {
 
 	void Writer::write(char* ptr, size_t num) {
 		header.apply_stream_type(ptr, num);
-        source->write(ptr, num);
+		buffer.insert(buffer.end(), ptr, ptr + num);
+	}
+
+	bool Writer::flush() {
+		if (buffer.empty())
+			return true;
+		qint64 size = (qint64)buffer.size();
+		qint64 done = source->write(buffer.data(), size);
+		buffer.clear();
+		if (done != size)
+			HANDLE_FAULT("Writer::flush : the data could not be written");
+		return true;
 	}
 
 	bool Writer::write_ascii_object(const Element& elem, Object* obj) {
@@ -690,7 +1574,7 @@ namespace PLY {
 
 			// Write the value.
 			if (p > 0)
-                (*tStream) << " ";
+				buffer.push_back(' ');
 			switch (prop->type) {
 			case SCALAR:
 				// Write the scalar.
@@ -702,7 +1586,9 @@ namespace PLY {
 				// Write the string.
 				if (!value->get_string(*prop, str))
 					HANDLE_FAULT("Writer::write_ascii_object : invalid string");
-                (*tStream) << "\"" << str << "\"";
+				buffer.push_back('\"');
+				buffer.insert(buffer.end(), str, str + std::strlen(str));
+				buffer.push_back('\"');
 				break;
 			case LIST:
 				// Write the length.
@@ -711,7 +1597,7 @@ namespace PLY {
 						HANDLE_FAULT("Writer::write_ascii_object : invalid list size");
 				// Write the items.
 				for (size_t n = 0; n < size; ++n) {
-                    (*tStream) << " ";
+					buffer.push_back(' ');
 					if (!value->get_item(*prop, n, dval) ||
 						!write_ascii_value(prop->data_type, dval))
 							HANDLE_FAULT("Writer::write_ascii_object : invalid list item");
@@ -724,7 +1610,7 @@ namespace PLY {
 		}
 
 		// Each object ends with a newline.
-        (*tStream) << ::endl;
+		buffer.push_back('\n');
 		return true;
 	}
 
@@ -0,0 +1,158 @@
+// A C++ reader/writer of .ply files.
+// Decoders for known row layouts.
+
+
+#include "layouts.h"
+#include <cstring>
+
+namespace PLY {
+	namespace {
+		// Load a value from unaligned row data.
+		template < class T >
+		inline T load(const char* ptr) {
+			T value;
+			std::memcpy(&value, ptr, sizeof(T));
+			return value;
+		}
+
+		// Store a value in a destination.
+		template < class T >
+		inline void store(char* ptr, T value) {
+			std::memcpy(ptr, &value, sizeof(T));
+		}
+
+		// Check whether a destination holds consecutive values of a type.
+		inline bool packed(const Binding& dest, Scalar_type type) {
+			return dest.bound() && dest.type == type && dest.stride == ply_type_bytes[type];
+		}
+
+		// Check whether a destination holds values of either 32-bit integer type.
+		inline bool packed_index(const Binding& dest) {
+			return packed(dest, Int32) || packed(dest, Uint32);
+		}
+
+		// The destinations of the uchar colors of a vertex, stored as Color.
+		template < class Color >
+		struct Colors {
+			char* data[3];
+			size_t stride[3];
+			size_t offset;
+
+			Colors(const ElementPlan& plan, size_t first): offset(plan.props[3].offset) {
+				for (int c = 0; c < 3; ++c) {
+					stride[c] = plan.props[3+c].dest.stride;
+					data[c] = plan.props[3+c].dest.data + first*stride[c];
+				}
+			}
+
+			void set(size_t n, const char* row) const {
+				const unsigned char* color = (const unsigned char*)row + offset;
+				store(data[0] + n*stride[0], (Color)color[0]);
+				store(data[1] + n*stride[1], (Color)color[1]);
+				store(data[2] + n*stride[2], (Color)color[2]);
+			}
+		}; // struct Colors
+
+		// Colors that are absent or not stored.
+		template <>
+		struct Colors<void> {
+			Colors(const ElementPlan& plan, size_t first) {}
+			void set(size_t n, const char* row) const {}
+		}; // struct Colors<void>
+
+		// Decode vertices of float x, y, z, optionally followed by uchar colors.
+		template < class Color >
+		void decode_vertices(const ElementPlan& plan, const char* rows, size_t count, size_t first) {
+			const size_t stride = plan.stride;
+			const Binding& x = plan.props[0].dest;
+			const Binding& y = plan.props[1].dest;
+			const Binding& z = plan.props[2].dest;
+			char* xs = x.data + first*x.stride;
+			char* ys = y.data + first*y.stride;
+			char* zs = z.data + first*z.stride;
+			const Colors<Color> colors(plan, first);
+			for (size_t n = 0; n < count; ++n, rows += stride) {
+				store(xs + n*x.stride, load<float>(rows));
+				store(ys + n*y.stride, load<float>(rows + 4));
+				store(zs + n*z.stride, load<float>(rows + 8));
+				colors.set(n, rows);
+			}
+		}
+
+		// Decode uniform faces of Indices vertex indices, optionally
+		// followed by Coords texture coordinates (0: absent or not stored).
+		template < size_t Indices, size_t Coords >
+		void decode_faces(const ElementPlan& plan, const char* rows, size_t count, size_t first) {
+			const size_t stride = plan.stride;
+			const char* indices = rows + plan.props[0].offset + 1;
+			char* index_dest = plan.props[0].dest.data + first*Indices*4;
+			for (size_t n = 0; n < count; ++n)
+				std::memcpy(index_dest + n*Indices*4, indices + n*stride, Indices*4);
+			if (Coords == 0) return;
+
+			const char* coords = rows + plan.props[1].offset + 1;
+			char* coord_dest = plan.props[1].dest.data + first*Coords*4;
+			for (size_t n = 0; n < count; ++n)
+				std::memcpy(coord_dest + n*Coords*4, coords + n*stride, Coords*4);
+		}
+
+		// Find a decoder for vertices.
+		RowDecoder find_vertex_decoder(const ElementPlan& plan) {
+			const std::vector<PropertyPlan>& props = plan.props;
+			if (props.size() != 3 && props.size() != 6) return nullptr;
+			for (size_t p = 0; p < props.size(); ++p)
+				if (props[p].kind != SCALAR || props[p].type != (p < 3 ? Float32 : Uint8))
+					return nullptr;
+			for (size_t p = 0; p < 3; ++p)
+				if (!props[p].dest.bound() || props[p].dest.type != Float32)
+					return nullptr;
+			if (props.size() == 3)
+				return decode_vertices<void>;
+
+			// The colors go to the same type, or nowhere.
+			const Scalar_type color = props[3].dest.bound() ? props[3].dest.type : StartType;
+			for (size_t p = 4; p < 6; ++p)
+				if ((props[p].dest.bound() ? props[p].dest.type : StartType) != color)
+					return nullptr;
+			switch (color) {
+				case StartType: return decode_vertices<void>;
+				case Uint8: return decode_vertices<unsigned char>;
+				case Float32: return decode_vertices<float>;
+				default: return nullptr;
+			}
+		}
+
+		// Find a decoder for uniform faces.
+		RowDecoder find_face_decoder(const ElementPlan& plan) {
+			const std::vector<PropertyPlan>& props = plan.props;
+			if (props.size() != 1 && props.size() != 2) return nullptr;
+			const PropertyPlan& indices = props[0];
+			if (indices.kind != LIST || indices.size_type != Uint8 || (indices.type != Int32 && indices.type != Uint32) ||
+				!packed_index(indices.dest))
+				return nullptr;
+
+			bool coords = false;
+			if (props.size() == 2) {
+				const PropertyPlan& tex = props[1];
+				if (tex.kind != LIST || tex.size_type != Uint8 || tex.type != Float32 || tex.items != 2*indices.items)
+					return nullptr;
+				if (tex.dest.bound() && !packed(tex.dest, Float32))
+					return nullptr;
+				coords = tex.dest.bound();
+			}
+			switch (indices.items) {
+				case 3: return coords ? decode_faces<3, 6> : decode_faces<3, 0>;
+				case 4: return coords ? decode_faces<4, 8> : decode_faces<4, 0>;
+				default: return nullptr;
+			}
+		}
+	} // namespace
+
+
+	// Find a decoder specialized for the layout and destinations of a plan.
+	RowDecoder find_layout_decoder(const ElementPlan& plan) {
+		if (!plan.fixed || plan.stride == 0) return nullptr;
+		RowDecoder decoder = find_vertex_decoder(plan);
+		return decoder ? decoder : find_face_decoder(plan);
+	}
+} // namespace PLY
@@ -125,6 +125,7 @@ namespace PLY {
 			for (size_t n = 0; n < num; ++n)
 				if (collect[n] != 0)
 					collect[n]->clear();
+			arena.release();
 		}
 	}
 
@@ -133,7 +134,7 @@ namespace PLY {
 		size_t index;
         if (!header.find_index(elem.name.c_str(), index)) return nullptr;
 		if (collect[index] == 0) {
-			collect[index] = new AnyArray;
+			collect[index] = new AnyArray(&arena);
 			unknown[index] = true;
 		}
 		return collect[index];
@@ -169,5 +170,6 @@ namespace PLY {
 			collect = 0;
 			delete[] unknown;
 		}
+		arena.release();
 	}
 } // namespace PLY
@@ -0,0 +1,67 @@
+// A C++ reader/writer of .ply files.
+// Parallel loops.
+
+
+#include "parallel.h"
+#include <atomic>
+
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
+
+namespace PLY {
+	namespace {
+		// The work shared by the threads of one parallel_for.
+		struct Loop {
+			const std::function<void(size_t)>& task;
+			size_t count;
+			std::atomic<size_t> next;
+			QSemaphore done;
+
+			Loop(const std::function<void(size_t)>& t, size_t c): task(t), count(c), next(0) {}
+
+			// Run tasks until there are none left.
+			void work() {
+				for (size_t n = next++; n < count; n = next++)
+					task(n);
+			}
+		}; // struct Loop
+
+		// A pool thread taking part in a Loop.
+		struct Worker: public QRunnable {
+			Loop& loop;
+			Worker(Loop& l): loop(l) {}
+			void run() {
+				loop.work();
+				loop.done.release();
+			}
+		}; // struct Worker
+	} // namespace
+
+
+	// Run a task for each index in [0, count) on the global QThreadPool.
+	void parallel_for(size_t count, const std::function<void(size_t)>& task, int threads) {
+		if (count == 0) return;
+		QThreadPool* pool = QThreadPool::globalInstance();
+		threads = parallel_threads(threads);
+
+		// Start helpers while there are idle threads; the caller does the rest.
+		Loop loop(task, count);
+		int helpers = 0;
+		while (helpers + 1 < threads && (size_t)helpers + 1 < count) {
+			Worker* worker = new Worker(loop);
+			if (!pool->tryStart(worker)) {
+				delete worker;
+				break;
+			}
+			++helpers;
+		}
+		loop.work();
+		loop.done.acquire(helpers);
+	}
+
+	// Get the most threads parallel_for uses.
+	int parallel_threads(int threads) {
+		return threads > 0 ? threads : QThreadPool::globalInstance()->maxThreadCount() + 1;
+	}
+} // namespace PLY
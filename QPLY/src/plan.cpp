@@ -0,0 +1,454 @@
+// A C++ reader/writer of .ply files.
+// Decode plans.
+
+
+#include "plan.h"
+#include "layouts.h"
+#include <algorithm>
+#include <charconv>
+#include <clocale>
+#include <cstdio>
+
+namespace PLY {
+	namespace {
+		// Reverse the bytes of a value.
+		template < class T >
+		inline T byte_swap(T value) {
+			char* ptr = (char*)&value;
+			for (size_t i = 0; i < sizeof(T)/2; ++i)
+				std::swap(ptr[i], ptr[sizeof(T)-i-1]);
+			return value;
+		}
+
+		// Convert a run of values of known types.
+		template < class S, class D, bool SWAP >
+		void convert_run(const char* src, size_t src_stride, char* dst, size_t dst_stride, size_t count) {
+			S sval;
+			D dval;
+			for (size_t n = 0; n < count; ++n) {
+				std::memcpy(&sval, src, sizeof(S));
+				if (SWAP) sval = byte_swap(sval);
+				dval = (D)sval;
+				std::memcpy(dst, &dval, sizeof(D));
+				src += src_stride;
+				dst += dst_stride;
+			}
+		}
+
+		// Select the swap mode for a known pair of types.
+		template < class S, class D >
+		inline void convert_swap(const char* src, size_t src_stride, char* dst, size_t dst_stride, size_t count, bool swap) {
+			if (swap && sizeof(S) > 1)
+				convert_run<S, D, true>(src, src_stride, dst, dst_stride, count);
+			else
+				convert_run<S, D, false>(src, src_stride, dst, dst_stride, count);
+		}
+
+		// Select the destination type for a known source type.
+		template < class S >
+		bool convert_to(const char* src, size_t src_stride, char* dst, size_t dst_stride, Scalar_type dst_type, size_t count, bool swap) {
+			switch (dst_type) {
+			case Int8:		convert_swap<S, char>(src, src_stride, dst, dst_stride, count, swap); break;
+			case Int16:		convert_swap<S, short>(src, src_stride, dst, dst_stride, count, swap); break;
+			case Int32:		convert_swap<S, int>(src, src_stride, dst, dst_stride, count, swap); break;
+			case Uint8:		convert_swap<S, unsigned char>(src, src_stride, dst, dst_stride, count, swap); break;
+			case Uint16:	convert_swap<S, unsigned short>(src, src_stride, dst, dst_stride, count, swap); break;
+			case Uint32:	convert_swap<S, unsigned int>(src, src_stride, dst, dst_stride, count, swap); break;
+			case Float32:	convert_swap<S, float>(src, src_stride, dst, dst_stride, count, swap); break;
+			case Float64:	convert_swap<S, double>(src, src_stride, dst, dst_stride, count, swap); break;
+			default:
+				return false;
+			}
+			return true;
+		}
+
+		// Reverse the bytes of a strided run of values.
+		template < class T >
+		void swap_run(char* data, size_t stride, size_t count) {
+			T value;
+			for (size_t n = 0; n < count; ++n, data += stride) {
+				std::memcpy(&value, data, sizeof(T));
+				value = byte_swap(value);
+				std::memcpy(data, &value, sizeof(T));
+			}
+		}
+
+		// Format an integer.
+		template < class T, class I >
+		inline size_t format_integer(const char* value, char* str) {
+			T ival;
+			std::memcpy(&ival, value, sizeof(T));
+			return std::to_chars(str, str + VALUE_CHARS, (I)ival).ptr - str;
+		}
+
+		// Format a floating point number, so that it reads back the same.
+		template < class T >
+		inline size_t format_real(const char* value, char* str) {
+			T fval;
+			std::memcpy(&fval, value, sizeof(T));
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+			return std::to_chars(str, str + VALUE_CHARS, fval).ptr - str;
+#else
+			int len = std::snprintf(str, VALUE_CHARS, "%.*g", sizeof(T) == 4 ? 9 : 17, (double)fval);
+			// snprintf follows the locale, while ply always uses a '.'.
+			char point = *std::localeconv()->decimal_point;
+			if (point != '.')
+				std::replace(str, str + len, point, '.');
+			return (size_t)len;
+#endif
+		}
+
+		// Append a size to a buffer.
+		inline void encode_size(size_t size, Scalar_type type, bool swap, char* dst) {
+			unsigned int uival = (unsigned int)size;
+			convert((const char*)&uival, 0, Uint32, dst, 0, type, 1, false);
+			if (swap) swap_values(dst, 0, type, 1);
+		}
+	} // namespace
+
+
+	// Store a value in a row.
+	void Binding::set(size_t row, double value) const {
+		convert((const char*)&value, 0, Float64, data + row*stride, 0, type, 1, false);
+	}
+
+
+	// Compile the plan for an Element.
+	bool ElementPlan::compile(const Element& elem) {
+		props.assign(elem.props.size(), PropertyPlan());
+		fixed = true;
+		stride = 0;
+		decoder = nullptr;
+		for (size_t p = 0; p < elem.props.size(); ++p) {
+			const Property& prop = elem.props[p];
+			props[p].kind = prop.type;
+			props[p].type = prop.data_type;
+			props[p].size_type = prop.type == STRING ? Int8 : prop.size_type;
+			if (!fixed || prop.type != SCALAR) {
+				// Rows containing lists or strings vary in size.
+				fixed = false;
+				continue;
+			}
+			props[p].offset = stride;
+			stride += ply_type_bytes[prop.data_type];
+		}
+		if (!fixed) stride = 0;
+
+		// Fixed-size rows can change byte order as a whole.
+		std::vector<size_t> sizes;
+		for (size_t p = 0; fixed && p < props.size(); ++p)
+			sizes.push_back(ply_type_bytes[props[p].type]);
+		swap.compile(sizes);
+		return fixed;
+	}
+
+	// Compile the plan for rows whose lists all have the same size.
+	bool ElementPlan::compile_uniform(const Element& elem, const std::vector<size_t>& sizes) {
+		compile(elem);
+		std::vector<size_t> values;
+		fixed = true;
+		stride = 0;
+		for (size_t p = 0; p < props.size(); ++p) {
+			PropertyPlan& plan = props[p];
+			if (plan.kind == STRING) {
+				compile(elem);
+				return false;
+			}
+			plan.offset = stride;
+			size_t count = 1;
+			if (plan.kind == LIST) {
+				// The size comes first, followed by the items.
+				count = plan.items = sizes[p];
+				values.push_back(ply_type_bytes[plan.size_type]);
+				stride += ply_type_bytes[plan.size_type];
+			}
+			values.insert(values.end(), count, ply_type_bytes[plan.type]);
+			stride += count * ply_type_bytes[plan.type];
+		}
+		swap.compile(values);
+		return true;
+	}
+
+	// Count the leading rows of a block whose lists have the uniform sizes.
+	size_t ElementPlan::uniform_rows(const char* rows, size_t count, bool swap) const {
+		// The expected sizes are compared in their raw form.
+		std::vector<size_t> lists;
+		std::vector<char> expect;
+		unsigned int size;
+		for (size_t p = 0; p < props.size(); ++p) {
+			if (props[p].kind != LIST) continue;
+			lists.push_back(p);
+			expect.resize(8 * lists.size());
+			size = (unsigned int)props[p].items;
+			convert((const char*)&size, 0, Uint32, &expect[8 * (lists.size()-1)], 0, props[p].size_type, 1, false);
+			if (swap) swap_values(&expect[8 * (lists.size()-1)], 0, props[p].size_type, 1);
+		}
+
+		for (size_t n = 0; n < count; ++n, rows += stride)
+			for (size_t l = 0; l < lists.size(); ++l) {
+				const PropertyPlan& plan = props[lists[l]];
+				if (std::memcmp(rows + plan.offset, &expect[8*l], ply_type_bytes[plan.size_type]) != 0)
+					return n;
+			}
+		return count;
+	}
+
+	// Check whether any Property has a destination.
+	bool ElementPlan::any_bound() const {
+		for (size_t p = 0; p < props.size(); ++p)
+			if (props[p].dest.bound())
+				return true;
+		return false;
+	}
+
+	// Select a decoder specialized for the layout of the rows.
+	bool ElementPlan::specialize() {
+		decoder = find_layout_decoder(*this);
+		return decoder != nullptr;
+	}
+
+	// Decode a block of consecutive fixed-size (or uniform) rows.
+	void ElementPlan::decode(const char* rows, size_t count, size_t first, bool swap) const {
+		if (decoder && !swap) {
+			decoder(*this, rows, count, first);
+			return;
+		}
+		for (size_t p = 0; p < props.size(); ++p) {
+			const PropertyPlan& plan = props[p];
+			if (!plan.dest.bound()) continue;
+			if (plan.kind == LIST) {
+				// Each position in the lists is converted as a column of its own.
+				const char* items = rows + plan.offset + ply_type_bytes[plan.size_type];
+				for (size_t i = 0; i < plan.items; ++i)
+					convert(items + i*ply_type_bytes[plan.type], stride, plan.type,
+						plan.dest.data + (first*plan.items + i)*plan.dest.stride, plan.items*plan.dest.stride,
+						plan.dest.type, count, swap);
+				continue;
+			}
+			convert(rows + plan.offset, stride, plan.type,
+				plan.dest.data + first*plan.dest.stride, plan.dest.stride, plan.dest.type,
+				count, swap);
+		}
+	}
+
+	// Decode a block of consecutive rows that vary in size.
+	size_t ElementPlan::decode_varying(const char* rows, size_t count, size_t first,
+		std::vector<size_t>& items, bool swap) const {
+		unsigned int size;
+		size_t bytes = 0;
+		for (size_t n = 0; n < count; ++n) {
+			for (size_t p = 0; p < props.size(); ++p) {
+				const PropertyPlan& plan = props[p];
+				if (plan.kind == SCALAR) {
+					if (plan.dest.bound())
+						convert(rows + bytes, 0, plan.type,
+							plan.dest.data + (first + n)*plan.dest.stride, 0, plan.dest.type, 1, swap);
+					bytes += ply_type_bytes[plan.type];
+					continue;
+				}
+				convert(rows + bytes, 0, plan.size_type, (char*)&size, 0, Uint32, 1, swap);
+				bytes += ply_type_bytes[plan.size_type];
+				if (plan.kind == LIST && plan.dest.bound()) {
+					convert(rows + bytes, ply_type_bytes[plan.type], plan.type,
+						plan.dest.data + items[p]*plan.dest.stride, plan.dest.stride, plan.dest.type, size, swap);
+					items[p] += size;
+				}
+				bytes += size * ply_type_bytes[plan.type];
+			}
+		}
+		return bytes;
+	}
+
+	// Measure the size of a number of consecutive rows.
+	bool ElementPlan::measure(const char* rows, size_t available, size_t count, bool swap, size_t& bytes) const {
+		if (fixed) {
+			bytes = count * stride;
+			return bytes <= available;
+		}
+
+		unsigned int size;
+		bytes = 0;
+		for (size_t n = 0; n < count; ++n) {
+			for (size_t p = 0; p < props.size(); ++p) {
+				const PropertyPlan& plan = props[p];
+				if (plan.kind == SCALAR) {
+					bytes += ply_type_bytes[plan.type];
+					continue;
+				}
+				// Lists and strings start with their size.
+				if (bytes + ply_type_bytes[plan.size_type] > available ||
+					!convert(rows + bytes, 0, plan.size_type, (char*)&size, 0, Uint32, 1, swap))
+					return false;
+				bytes += ply_type_bytes[plan.size_type] + size * ply_type_bytes[plan.type];
+			}
+			if (bytes > available)
+				return false;
+		}
+		return true;
+	}
+
+
+	// Encode a block of consecutive rows from their sources.
+	void ElementPlan::encode(size_t first, size_t count, bool swap, std::vector<char>& out) const {
+		// The rows have the same size, unless the size of a list varies.
+		size_t row_bytes = 0;
+		bool same = true;
+		for (size_t p = 0; p < props.size(); ++p) {
+			const PropertyPlan& plan = props[p];
+			if (!plan.source.bound()) continue;
+			if (!plan.source.list())
+				row_bytes += ply_type_bytes[plan.type];
+			else if (plan.source.offsets)
+				same = false;
+			else
+				row_bytes += ply_type_bytes[plan.size_type] + plan.source.list_size * ply_type_bytes[plan.type];
+		}
+
+		const size_t start = out.size();
+		if (same) {
+			// Encode each value of the rows as a column.
+			out.resize(start + count * row_bytes);
+			char* rows = out.data() + start;
+			size_t offset = 0;
+			for (size_t p = 0; p < props.size(); ++p) {
+				const PropertyPlan& plan = props[p];
+				const Binding& values = plan.source.values;
+				if (!plan.source.bound()) continue;
+				if (!plan.source.list()) {
+					convert(values.data + first*values.stride, values.stride, values.type,
+						rows + offset, row_bytes, plan.type, count, false);
+					if (swap) swap_values(rows + offset, row_bytes, plan.type, count);
+					offset += ply_type_bytes[plan.type];
+					continue;
+				}
+
+				const size_t size = plan.source.list_size;
+				for (size_t n = 0; n < count; ++n)
+					encode_size(size, plan.size_type, swap, rows + n*row_bytes + offset);
+				offset += ply_type_bytes[plan.size_type];
+				for (size_t i = 0; i < size; ++i) {
+					convert(values.data + (first*size + i)*values.stride, size*values.stride, values.type,
+						rows + offset, row_bytes, plan.type, count, false);
+					if (swap) swap_values(rows + offset, row_bytes, plan.type, count);
+					offset += ply_type_bytes[plan.type];
+				}
+			}
+			return;
+		}
+
+		// Otherwise, measure the lists and encode one row at a time.
+		size_t bytes = count * row_bytes;
+		for (size_t p = 0; p < props.size(); ++p) {
+			const PropertyPlan& plan = props[p];
+			if (plan.source.bound() && plan.source.offsets)
+				bytes += count * ply_type_bytes[plan.size_type] +
+					(plan.source.offsets[first+count] - plan.source.offsets[first]) * ply_type_bytes[plan.type];
+		}
+		out.resize(start + bytes);
+		char* ptr = out.data() + start;
+		for (size_t row = first; row < first + count; ++row) {
+			for (size_t p = 0; p < props.size(); ++p) {
+				const PropertyPlan& plan = props[p];
+				const Binding& values = plan.source.values;
+				if (!plan.source.bound()) continue;
+				if (!plan.source.list()) {
+					convert(values.data + row*values.stride, 0, values.type, ptr, 0, plan.type, 1, false);
+					if (swap) swap_values(ptr, 0, plan.type, 1);
+					ptr += ply_type_bytes[plan.type];
+					continue;
+				}
+
+				const size_t size = plan.source.size(row);
+				encode_size(size, plan.size_type, swap, ptr);
+				ptr += ply_type_bytes[plan.size_type];
+				convert(values.data + plan.source.first(row)*values.stride, values.stride, values.type,
+					ptr, ply_type_bytes[plan.type], plan.type, size, false);
+				if (swap) swap_values(ptr, ply_type_bytes[plan.type], plan.type, size);
+				ptr += size * ply_type_bytes[plan.type];
+			}
+		}
+	}
+
+	// Format a block of consecutive rows from their sources as ASCII.
+	void ElementPlan::format(size_t first, size_t count, std::vector<char>& out) const {
+		char str[VALUE_CHARS];
+		size_t len;
+		for (size_t row = first; row < first + count; ++row) {
+			bool separate = false;
+			for (size_t p = 0; p < props.size(); ++p) {
+				const PropertyPlan& plan = props[p];
+				const Binding& values = plan.source.values;
+				if (!plan.source.bound()) continue;
+				if (separate) out.push_back(' ');
+				separate = true;
+				if (!plan.source.list()) {
+					len = format_value(values.data + row*values.stride, values.type, plan.type, str);
+					out.insert(out.end(), str, str + len);
+					continue;
+				}
+
+				const size_t size = plan.source.size(row);
+				unsigned int uival = (unsigned int)size;
+				len = format_value((const char*)&uival, Uint32, plan.size_type, str);
+				out.insert(out.end(), str, str + len);
+				const char* item = values.data + plan.source.first(row)*values.stride;
+				for (size_t i = 0; i < size; ++i, item += values.stride) {
+					out.push_back(' ');
+					len = format_value(item, values.type, plan.type, str);
+					out.insert(out.end(), str, str + len);
+				}
+			}
+			out.push_back('\n');
+		}
+	}
+
+
+	// Convert a strided run of values from one type to another.
+	bool convert(const char* src, size_t src_stride, Scalar_type src_type,
+		char* dst, size_t dst_stride, Scalar_type dst_type,
+		size_t count, bool swap) {
+		switch (src_type) {
+		case Int8:		return convert_to<char>(src, src_stride, dst, dst_stride, dst_type, count, swap);
+		case Int16:		return convert_to<short>(src, src_stride, dst, dst_stride, dst_type, count, swap);
+		case Int32:		return convert_to<int>(src, src_stride, dst, dst_stride, dst_type, count, swap);
+		case Uint8:		return convert_to<unsigned char>(src, src_stride, dst, dst_stride, dst_type, count, swap);
+		case Uint16:	return convert_to<unsigned short>(src, src_stride, dst, dst_stride, dst_type, count, swap);
+		case Uint32:	return convert_to<unsigned int>(src, src_stride, dst, dst_stride, dst_type, count, swap);
+		case Float32:	return convert_to<float>(src, src_stride, dst, dst_stride, dst_type, count, swap);
+		case Float64:	return convert_to<double>(src, src_stride, dst, dst_stride, dst_type, count, swap);
+		default:
+			return false;
+		}
+	}
+
+	// Reverse the bytes of a strided run of values.
+	void swap_values(char* data, size_t stride, Scalar_type type, size_t count) {
+		switch (ply_type_bytes[type]) {
+		case 2:	swap_run<short>(data, stride, count); break;
+		case 4:	swap_run<int>(data, stride, count); break;
+		case 8:	swap_run<double>(data, stride, count); break;
+		default:
+			break;
+		}
+	}
+
+	// Format a value as ASCII text.
+	size_t format_value(const char* src, Scalar_type src_type, Scalar_type type, char* str) {
+		// Round the value to the type in the file first.
+		char value[8];
+		if (!convert(src, 0, src_type, value, 0, type, 1, false))
+			return 0;
+		switch (type) {
+		case Int8:		return format_integer<char, int>(value, str);
+		case Int16:		return format_integer<short, int>(value, str);
+		case Int32:		return format_integer<int, int>(value, str);
+		case Uint8:		return format_integer<unsigned char, unsigned int>(value, str);
+		case Uint16:	return format_integer<unsigned short, unsigned int>(value, str);
+		case Uint32:	return format_integer<unsigned int, unsigned int>(value, str);
+		case Float32:	return format_real<float>(value, str);
+		case Float64:	return format_real<double>(value, str);
+		default:
+			return 0;
+		}
+	}
+} // namespace PLY
@@ -29,6 +29,65 @@ bool ScalarValue<T>::set_scalar(const Property& prop, const double& value) {
     return true;
 }
 
+template <class T>
+bool ScalarValue<T>::locate(const Property& prop, Binding& bind) {
+    if (prop.type != SCALAR) {
+        return false;
+    }
+    bind = Binding(&val, sizeof(T), scalar_type_of<T>::type);
+    return true;
+}
+
+template <class T, size_t N>
+ListValue<T, N>::ListValue() : count(0) {}
+
+template <class T, size_t N>
+bool ListValue<T, N>::get_size(const Property& prop, size_t& size) const {
+    if (prop.type != LIST) {
+        return false;
+    }
+    size = count;
+    return true;
+}
+
+template <class T, size_t N>
+bool ListValue<T, N>::get_item(const Property& prop, const size_t& num, double& value) const {
+    if (prop.type != LIST || num >= count) {
+        return false;
+    }
+    value = (double)data()[num];
+    return true;
+}
+
+template <class T, size_t N>
+bool ListValue<T, N>::set_size(const Property& prop, const size_t& size) {
+    if (prop.type != LIST) {
+        return false;
+    }
+    resize(size);
+    return true;
+}
+
+template <class T, size_t N>
+bool ListValue<T, N>::set_item(const Property& prop, const size_t& num, const double& value) {
+    if (prop.type != LIST || num >= count) {
+        return false;
+    }
+    data()[num] = (T)value;
+    return true;
+}
+
+template <class T, size_t N>
+void ListValue<T, N>::resize(size_t size) {
+    // Only lists that do not fit inline use the heap
+    if (size > N) {
+        spill.resize(size);
+    } else {
+        spill.clear();
+    }
+    count = size;
+}
+
 Vertex::Vertex() : value_x(0), value_y(0), value_z(0) {}
 Vertex::Vertex(float x, float y, float z): value_x(x), value_y(y), value_z(z) {}
 
@@ -272,19 +331,8 @@ void VertexNCT::tn(float coord) { value_tn.set_scalar(prop_tn, coord); }
 /// ================= END Vertex w/ Normal, Color, and Tex Coord ========================= ///
 
 Face::Face() {}
-Face::Face(const size_t& size) { indices.set_size(prop_ind, size); }
-Face::Face(const Face& f) {
-    if (f.indices.data != 0) {
-        size_t size;
-        double val;
-        f.indices.get_size(prop_ind, size);
-        indices.set_size(prop_ind, size);
-        for (size_t n = 0; n < size; ++n) {
-            f.indices.get_item(prop_ind, n, val);
-            indices.set_item(prop_ind, n, val);
-        }
-    }
-}
+Face::Face(const size_t& size) { indices.resize(size); }
+Face::Face(const Face& f) : Object(f), indices(f.indices) {}
 
 // Get a Value.
 Value* Face::get_value(const Element& elem, const Property& prop) {
@@ -300,40 +348,25 @@ bool Face::make_element(Element& elem) const {
 }
 
 size_t Face::size() const {
-    size_t s;
-    indices.get_size(prop_ind, s);
-    return s;
+    return indices.size();
 }
 
 size_t Face::vertex(const size_t& num) const {
-    double index;
-    indices.get_item(prop_ind, num, index);
-    return (size_t)index;
+    return indices.data()[num];
 }
 
 void Face::size(const size_t& size) {
-    indices.set_size(prop_ind, size);
+    indices.resize(size);
 }
 
 void Face::vertex(const size_t& num, const size_t& index) {
-    indices.set_item(prop_ind, num, (double)index);
+    indices.data()[num] = (unsigned int)index;
 }
 
 FaceTex::FaceTex() : Face() {}
-FaceTex::FaceTex(const size_t& size) : Face(size) { texcoords.set_size(prop_ind, size); }
+FaceTex::FaceTex(const size_t& size) : Face(size) { texcoords.resize(size); }
 FaceTex::FaceTex(const Face& f) : Face(f) {}
-FaceTex::FaceTex(const FaceTex& f) : Face(f) {
-    if (f.texcoords.data != 0) {
-        size_t size;
-        double val;
-        f.texcoords.get_size(prop_tex, size);
-        texcoords.set_size(prop_tex, size);
-        for (size_t n = 0; n < size; ++n) {
-            f.texcoords.get_item(prop_tex, n, val);
-            texcoords.set_item(prop_tex, n, val);
-        }
-    }
-}
+FaceTex::FaceTex(const FaceTex& f) : Face(f), texcoords(f.texcoords) {}
 
 // Get a Value.
 Value* FaceTex::get_value(const Element& elem, const Property& prop) {
@@ -357,17 +390,15 @@ size_t FaceTex::size() const {
 
 void FaceTex::size(const size_t& size) {
     Face::size(size);
-    texcoords.set_size(prop_tex, size*3);
+    texcoords.resize(size*3);
 }
 
 float FaceTex::texcoord(const size_t& num) const {
-    double coord;
-    texcoords.get_item(prop_tex, num, coord);
-    return (float)coord;
+    return texcoords.data()[num];
 }
 
 void FaceTex::texcoord(const size_t& num, const float& coord) {
-    texcoords.set_item(prop_tex, num, (double)coord);
+    texcoords.data()[num] = coord;
 }
 
 template <class T>
@@ -402,7 +433,48 @@ Object& ObjExternal<T>::next_object() {
     return objects[incr++];
 }
 
+template <class T>
+bool ObjExternal<T>::bind(const Element& elem, ElementPlan& plan) {
+    // Create all the objects up front
+    objects.resize(elem.num);
+    for (size_t n = 0; n < elem.num; ++n) {
+        objects[n].prepare(elem);
+    }
+    if (elem.num == 0) {
+        return true;
+    }
+
+    // Every object has the same layout, so the values of the
+    // first object give the location of the values of all of them
+    T& first = objects[0];
+    for (size_t p = 0; p < elem.props.size(); ++p) {
+        const Property& prop = elem.props[p];
+        if (!prop.store) {
+            continue;
+        }
+
+        Value* value = first.get_value(elem, prop);
+        if (value == 0) {
+            continue;
+        }
+
+        Binding dest;
+        if (!value->locate(prop, dest)) {
+            plan.compile(elem);
+            return false;
+        }
+        dest.stride = sizeof(T);
+        plan.props[p].dest = dest;
+    }
+
+    incr = elem.num;
+    return true;
+}
+
 // Explicit template instantiations to match the typedefs in the header
+template struct ListValue<unsigned int, 4>;
+template struct ListValue<float, 8>;
+
 template struct ObjArray<Face>;
 template struct ObjArray<FaceTex>;
 
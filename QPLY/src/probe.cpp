@@ -0,0 +1,152 @@
+// A C++ reader/writer of .ply files.
+// Header probes.
+
+
+#include "probe.h"
+#include "gzip.h"
+#include "io.h"
+#include "plan.h"
+
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+
+namespace PLY {
+	// Probe a file.
+	bool Probe::open_file(QString file_name) {
+		QFile file(file_name);
+		if (is_gzip_file(file_name)) {
+			InflateDevice inflated(&file);
+			if (!inflated.open(QIODevice::ReadOnly))
+				HANDLE_FAULT("Probe::open_file : cannot open the file");
+			return open_io_device(&inflated);
+		}
+		if (!file.open(QIODevice::ReadOnly))
+			HANDLE_FAULT("Probe::open_file : cannot open the file");
+		if (!open_io_device(&file))
+			return false;
+		file_time = QFileInfo(file_name).lastModified().toMSecsSinceEpoch();
+		load_index(index_name(file_name));
+		return true;
+	}
+
+	// Probe a device.
+	bool Probe::open_io_device(QIODevice* dev) {
+		header = Header();
+		file_size = NO_OFFSET;
+		file_time = -1;
+		Reader reader(header);
+		if (!reader.use_io_device(dev))
+			return false;
+		if (!dev->isSequential())
+			file_size = (size_t)dev->size();
+
+		// Binary offsets are known up to the first Element that varies in size.
+		ElementPlan plan;
+		offsets.assign(1, (size_t)dev->pos());
+		for (size_t e = 0; e < header.elements.size() && header.stream_type != ASCII; ++e) {
+			if (!plan.compile(header.elements[e])) break;
+			offsets.push_back(offsets.back() + header.elements[e].num * plan.stride);
+		}
+		return true;
+	}
+
+	// Find all offsets of a binary file and write its index file.
+	bool Probe::index(QString file_name) {
+		if (is_gzip_file(file_name))
+			HANDLE_FAULT("Probe::index : compressed files cannot be indexed");
+		Header found;
+		Reader reader(found);
+		if (!reader.map_file(file_name))
+			return false;
+		header = found;
+		file_size = (size_t)reader.source->size();
+		file_time = QFileInfo(file_name).lastModified().toMSecsSinceEpoch();
+		bool located = reader.element_offsets(offsets);
+		reader.close_file();
+		return located && save_index(index_name(file_name));
+	}
+
+	// Check whether the offsets of all Elements are known.
+	bool Probe::complete() const {
+		return offsets.size() == header.elements.size() + 1;
+	}
+
+	// Get the number of rows of an Element.
+	size_t Probe::count(const char* name) const {
+		size_t e;
+		return header.find_index(name, e) ? header.elements[e].num : 0;
+	}
+
+	// Get the byte offset of an Element.
+	size_t Probe::offset(const char* name) const {
+		size_t e;
+		if (!header.find_index(name, e) || e >= offsets.size()) return NO_OFFSET;
+		return offsets[e];
+	}
+
+	// Get the size of the data of an Element in bytes.
+	size_t Probe::data_bytes(const char* name) const {
+		size_t e;
+		if (!header.find_index(name, e) || e + 1 >= offsets.size()) return NO_OFFSET;
+		return offsets[e+1] - offsets[e];
+	}
+
+	// Read the offsets from an index file.
+	bool Probe::load_index(QString file_name) {
+		QFile file(file_name);
+		if (!file.open(QIODevice::ReadOnly))
+			return false;
+
+		// The index repeats the file size, time and Elements, so a stale index is ignored.
+		// A file rewritten with the same size and counts can still have lists of other sizes.
+		char line[BIG_STRING];
+		char name[BIG_STRING];
+		unsigned long long size, num, start;
+		long long time;
+		if (file_time < 0 ||
+			file.readLine(line, BIG_STRING) <= 0 || std::strcmp(line, "ply_index 2\n") != 0 ||
+			file.readLine(line, BIG_STRING) <= 0 || std::sscanf(line, "size %llu", &size) != 1 ||
+			size != (unsigned long long)file_size ||
+			file.readLine(line, BIG_STRING) <= 0 || std::sscanf(line, "time %lld", &time) != 1 ||
+			time != (long long)file_time)
+			return false;
+
+		std::vector<size_t> found;
+		for (size_t e = 0; e < header.elements.size(); ++e) {
+			if (file.readLine(line, BIG_STRING) <= 0 ||
+				std::sscanf(line, "element %s %llu %llu", name, &num, &start) != 3 ||
+				header.elements[e].name != name || num != header.elements[e].num)
+				return false;
+			found.push_back((size_t)start);
+		}
+		if (file.readLine(line, BIG_STRING) <= 0 || std::sscanf(line, "end %llu", &start) != 1)
+			return false;
+		found.push_back((size_t)start);
+		offsets.swap(found);
+		return true;
+	}
+
+	// Write the offsets to an index file.
+	bool Probe::save_index(QString file_name) const {
+		if (!complete() || file_size == NO_OFFSET || file_time < 0)
+			HANDLE_FAULT("Probe::save_index : the offsets are not known");
+		QFile file(file_name);
+		if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+			HANDLE_FAULT("Probe::save_index : cannot write the index file");
+
+		std::ostringstream out;
+		out << "ply_index 2\n";
+		out << "size " << file_size << "\n";
+		out << "time " << file_time << "\n";
+		for (size_t e = 0; e < header.elements.size(); ++e)
+			out << "element " << header.elements[e].name << " " << header.elements[e].num << " " << offsets[e] << "\n";
+		out << "end " << offsets.back() << "\n";
+		std::string text = out.str();
+		return file.write(text.data(), (qint64)text.size()) == (qint64)text.size();
+	}
+} // namespace PLY
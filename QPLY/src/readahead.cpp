@@ -0,0 +1,174 @@
+// A C++ reader/writer of .ply files.
+// Read-ahead devices.
+
+
+#include "readahead.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#include <QSemaphore>
+#include <QThread>
+
+namespace PLY {
+	// The thread filling the buffers of a ReadAheadDevice.
+	// The buffers are passed back and forth through two semaphores:
+	// the thread fills a free buffer while the reader empties a full one.
+	struct ReadAheadDevice::Worker: public QThread {
+		// A buffer of data read ahead.
+		struct Buffer {
+			std::vector<char> data;
+			size_t size;				// The number of bytes in the buffer.
+			bool last;					// Whether the data ends after this buffer.
+			bool failed;				// Whether the data ended in a failure.
+		};
+
+		ReadAheadDevice& owner;
+		Buffer buffers[2];
+		QSemaphore free_buffers;
+		QSemaphore full_buffers;
+		std::atomic<bool> stopping;
+
+		Worker(ReadAheadDevice& dev, size_t block): owner(dev), free_buffers(2), stopping(false) {
+			for (int b = 0; b < 2; ++b) {
+				buffers[b].data.resize(block);
+				buffers[b].size = 0;
+				buffers[b].last = buffers[b].failed = false;
+			}
+		}
+
+		// Fill the buffers until the end of the data, or until stopped.
+		void run() {
+			for (int b = 0; ; b = 1 - b) {
+				free_buffers.acquire();
+				if (stopping) break;
+
+				Buffer& out = buffers[b];
+				qint64 got = owner.fill(out.data.data(), out.data.size());
+				out.size = got > 0 ? (size_t)got : 0;
+				out.last = got <= 0;
+				out.failed = got < 0;
+				full_buffers.release();
+				if (out.last) break;
+			}
+		}
+	}; // struct ReadAheadDevice::Worker
+
+
+	// Construct for a device.
+	ReadAheadDevice::ReadAheadDevice(QIODevice* dev, bool own, size_t size): device(dev),
+		owned(own), block(size), worker(nullptr), turn(0), current(-1), pos(0), failed(false) {}
+
+	// Destructor.
+	ReadAheadDevice::~ReadAheadDevice() {
+		close();
+		if (owned)
+			delete device;
+	}
+
+	// Open the device and start reading ahead.
+	bool ReadAheadDevice::open(OpenMode mode) {
+		if (isOpen() || (mode & ReadWrite) != ReadOnly)
+			HANDLE_FAULT("ReadAheadDevice::open : the device can only be opened once for reading");
+		if (!device->isOpen() && !device->open(ReadOnly))
+			HANDLE_FAULT("ReadAheadDevice::open : cannot open the device");
+
+		turn = 0;
+		current = -1;
+		pos = 0;
+		failed = false;
+		worker = new Worker(*this, block);
+		worker->start();
+		return QIODevice::open(mode);
+	}
+
+	// Stop reading ahead and close both devices.
+	void ReadAheadDevice::close() {
+		stop();
+		failed = false;
+		if (device->isOpen())
+			device->close();
+		if (isOpen())
+			QIODevice::close();
+	}
+
+	// Check whether all data has been read.
+	bool ReadAheadDevice::atEnd() const {
+		if (QIODevice::bytesAvailable() > 0) return false;
+		if (worker == nullptr) return true;
+		return current >= 0 && worker->buffers[current].last && pos == worker->buffers[current].size;
+	}
+
+	// Get the number of bytes that can be read without waiting.
+	qint64 ReadAheadDevice::bytesAvailable() const {
+		qint64 ready = 0;
+		if (worker && current >= 0)
+			ready = (qint64)(worker->buffers[current].size - pos);
+		return ready + QIODevice::bytesAvailable();
+	}
+
+	// Fill a buffer by reading the device.
+	qint64 ReadAheadDevice::fill(char* data, size_t size) {
+		size_t done = 0;
+		while (done < size) {
+			qint64 got = device->read(data + done, (qint64)(size - done));
+			if (got < 0 && done == 0) return -1;
+			if (got <= 0) break;
+			done += (size_t)got;
+		}
+		return (qint64)done;
+	}
+
+	// Stop the read-ahead thread.
+	void ReadAheadDevice::stop() {
+		if (worker) {
+			// Wake the thread if it waits for a free buffer.
+			worker->stopping = true;
+			worker->free_buffers.release(2);
+			worker->wait();
+			delete worker;
+			worker = nullptr;
+		}
+		current = -1;
+	}
+
+	// Read the data read ahead.
+	qint64 ReadAheadDevice::readData(char* data, qint64 max) {
+		qint64 copied = 0;
+		while (copied < max && worker) {
+			if (current < 0 || pos == worker->buffers[current].size) {
+				if (current >= 0) {
+					if (worker->buffers[current].last) {
+						// The thread has finished, so its buffers can go.
+						failed = worker->buffers[current].failed;
+						stop();
+						break;
+					}
+					// Hand the buffer back to be refilled.
+					worker->free_buffers.release();
+				}
+				worker->full_buffers.acquire();
+				current = turn;
+				turn = 1 - turn;
+				pos = 0;
+				continue;
+			}
+			const Worker::Buffer& buffer = worker->buffers[current];
+			size_t len = std::min<size_t>(buffer.size - pos, (size_t)(max - copied));
+			std::memcpy(data + copied, buffer.data.data() + pos, len);
+			pos += len;
+			copied += (qint64)len;
+		}
+		if (copied == 0 && failed) {
+			setErrorString("ReadAheadDevice: the data could not be read");
+			return -1;
+		}
+		return copied;
+	}
+
+	// Writing is not supported.
+	qint64 ReadAheadDevice::writeData(const char* data, qint64 len) {
+		return -1;
+	}
+} // namespace PLY
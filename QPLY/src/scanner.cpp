@@ -0,0 +1,167 @@
+// A C++ reader/writer of .ply files.
+// ASCII scanner.
+
+
+#include "scanner.h"
+#include <algorithm>
+#include <charconv>
+#include <clocale>
+#include <cstdlib>
+#include <cstring>
+#include <locale>
+#include <sstream>
+
+#include <QIODevice>
+
+namespace PLY {
+	namespace {
+		// Check for white-space (the same as WhiteSpace, but inlined).
+		inline bool is_space(char c) {
+			return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+		}
+
+		// Parse a floating point number.
+		inline bool parse_real(const char* first, const char* last, double& value) {
+			if (first < last && *first == '+') ++first;
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+			std::from_chars_result res = std::from_chars(first, last, value);
+			return res.ec == std::errc() && res.ptr == last;
+#else
+			// Without from_chars, strtod is only usable if the locale uses a '.'.
+			char str[64];
+			size_t len = last - first;
+			if (len < sizeof(str) && *std::localeconv()->decimal_point == '.') {
+				std::memcpy(str, first, len);
+				str[len] = '\0';
+				char* stop;
+				value = std::strtod(str, &stop);
+				return len > 0 && stop == str + len;
+			}
+			std::istringstream in(std::string(first, last));
+			in.imbue(std::locale::classic());
+			in >> value;
+			return !in.fail() && in.peek() == EOF;
+#endif
+		}
+	} // namespace
+
+
+	// Scan a device.
+	void AsciiScanner::use_io_device(QIODevice* dev) {
+		source = dev;
+		buffer.resize(BLOCK_BYTES);
+		pos = end = buffer.data();
+		eof = false;
+	}
+
+	// Scan a range of memory.
+	void AsciiScanner::use_memory(const char* data, size_t size) {
+		source = 0;
+		pos = data;
+		end = data + size;
+		eof = true;
+	}
+
+	// Get the next word.
+	bool AsciiScanner::next_word(const char*& word, size_t& len) {
+		// Ignore leading white-space.
+		for (;;) {
+			while (pos < end && is_space(*pos))
+				++pos;
+			if (pos < end) break;
+			if (!refill()) return false;
+		}
+
+		const char* stop = token_end(false);
+		word = pos;
+		len = stop - pos;
+		pos = stop;
+		return true;
+	}
+
+	// Get the next value.
+	bool AsciiScanner::next_value(double& value) {
+		const char* word;
+		size_t len;
+		return next_word(word, len) && parse(word, word + len, value);
+	}
+
+	// Get the next string.
+	bool AsciiScanner::next_string(char* str) {
+		for (;;) {
+			while (pos < end && is_space(*pos))
+				++pos;
+			if (pos < end) break;
+			if (!refill()) return false;
+		}
+
+		const bool quoted = *pos == '\"';
+		const char* stop = token_end(quoted);
+		const char* first = quoted ? pos + 1 : pos;
+		size_t len = std::min<size_t>(stop - first, BIG_STRING - 1);
+		std::memcpy(str, first, len);
+		str[len] = '\0';
+		pos = (quoted && stop < end) ? stop + 1 : stop;
+		return true;
+	}
+
+	// Parse a number.
+	bool AsciiScanner::parse(const char* first, const char* last, double& value) {
+		// Most values in ply files are integers, which are parsed exactly.
+		const char* ptr = first;
+		bool negative = false;
+		if (ptr < last && (*ptr == '-' || *ptr == '+'))
+			negative = *ptr++ == '-';
+		if (ptr < last && last - ptr < 19) {
+			long long ival = 0;
+			const char* digits = ptr;
+			while (ptr < last && *ptr >= '0' && *ptr <= '9')
+				ival = ival*10 + (*ptr++ - '0');
+			if (ptr == last && ptr != digits) {
+				value = negative ? -(double)ival : (double)ival;
+				return true;
+			}
+		}
+		return parse_real(first, last, value);
+	}
+
+	// Keep the unscanned characters and read the next block.
+	bool AsciiScanner::refill() {
+		if (eof) return false;
+
+		// Move the remainder to the front, growing the buffer for very long tokens.
+		size_t from = pos - buffer.data();
+		size_t keep = end - pos;
+		if (keep == buffer.size())
+			buffer.resize(2 * buffer.size());
+		std::memmove(buffer.data(), buffer.data() + from, keep);
+		pos = buffer.data();
+		end = pos + keep;
+
+		qint64 got = source->read(buffer.data() + keep, (qint64)(buffer.size() - keep));
+		if (got <= 0) {
+			eof = true;
+			return false;
+		}
+		end += got;
+		return true;
+	}
+
+	// Find the end of the token starting at pos.
+	const char* AsciiScanner::token_end(bool quoted) {
+		const char* stop = quoted ? pos + 1 : pos;
+		for (;;) {
+			if (quoted)
+				while (stop < end && *stop != '\"') ++stop;
+			else
+				while (stop < end && !is_space(*stop)) ++stop;
+			if (stop < end) return stop;
+
+			// The token may continue in the next block.
+			size_t done = stop - pos;
+			bool more = refill();
+			stop = pos + done;
+			if (!more) return stop;
+		}
+	}
+} // namespace PLY
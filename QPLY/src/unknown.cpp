@@ -23,6 +23,7 @@
 
 
 #include "unknown.h"
+#include <new>
 
 namespace PLY {
 	// Get the scalar value.
@@ -34,9 +35,8 @@ namespace PLY {
 	// Set the scalar value.
 	bool AnyValue::set_scalar(const Property& prop, const double& value) {
 		if (prop.type != SCALAR) return false;
-		deinit();
 		// Initialise the array and store the scalar.
-		data = new char[ply_type_bytes[prop.data_type]];
+		reserve(ply_type_bytes[prop.data_type]);
 		return to_pointer(value, prop.data_type, data);
 	}
 	
@@ -59,10 +59,8 @@ namespace PLY {
 	// Prepare the list Value to recieve a number of items.
 	bool AnyValue::set_size(const Property& prop, const size_t& size) {
 		if (prop.type != LIST) return false;
-		deinit();
 		// Initialise the array and store the size.
-		size_t len = ply_type_bytes[prop.size_type] + (size * ply_type_bytes[prop.data_type]);
-		data = new char[len];
+		reserve(ply_type_bytes[prop.size_type] + (size * ply_type_bytes[prop.data_type]));
 		return to_pointer((double)size, prop.size_type, data);
 	}
 
@@ -84,9 +82,8 @@ namespace PLY {
 	//  Set the string Value.
 	bool AnyValue::set_string(const Property& prop, const char* str) {
 		if (prop.type != STRING) return false;
-		deinit();
 		// Initialise the array (incl. the '\0') and store the string.
-		data = new char[std::strlen(str) + 1];
+		reserve(std::strlen(str) + 1);
 		std::strcpy(data, str);
 		return true;
 	}
@@ -184,6 +181,14 @@ namespace PLY {
 			to[i] = from[i];
 	}
 
+	// Make room for a number of bytes.
+	void AnyValue::reserve(size_t len) {
+		if (data && len <= bytes) return;
+		deinit();
+		data = arena ? (char*)arena->allocate(len, sizeof(double)) : new char[len];
+		bytes = len;
+	}
+
 	
 	// Prepare the Object to represent an Element.
 	void AnyObject::prepare(const Element& elem) {
@@ -195,13 +200,18 @@ namespace PLY {
 	Value* AnyObject::get_value(const Element& elem, const Property& prop) {
 		size_t index;
 		if (!elem.find_index(prop.name.c_str(), index)) return 0;
-		if (values[index] == 0) values[index] = new AnyValue();
+		if (values[index] == 0) {
+			if (arena)
+				values[index] = new (arena->allocate(sizeof(AnyValue), alignof(AnyValue))) AnyValue(arena);
+			else
+				values[index] = new AnyValue();
+		}
 		return values[index];
 	}
 	
 	// Initialize the objects.
 	void AnyObject::init(size_t size) {
-		values = new Value*[size];
+		values = arena ? arena->allocate_array<Value*>(size) : new Value*[size];
 		num = size;
 		for (size_t n = 0; n < size; ++n)
 			values[n] = 0;
@@ -209,6 +219,11 @@ namespace PLY {
 	
 	// Deinitialize the objects.
 	void AnyObject::deinit() {
+		// Values in an Arena are released with the Arena.
+		if (arena) {
+			values = 0;
+			return;
+		}
 		if (values) {
 			for (size_t n = 0; n < num; ++n)
 				if (values[n] != 0)
@@ -228,6 +243,12 @@ namespace PLY {
 
 	// Remove all [Objects](\ref Object) from the array.
 	void AnyArray::clear() {
+		// Objects in an Arena are released with the Arena.
+		if (arena) {
+			objects = 0;
+			num = incr = 0;
+			return;
+		}
 		for (size_t n = 0; n < num; ++n) {
 			if (objects[n] != 0) {
 				delete objects[n];
@@ -238,14 +259,18 @@ namespace PLY {
 	
 	// Get the next Object.
 	Object& AnyArray::next_object() {
-		if (objects[incr] == 0)
-			objects[incr] = new AnyObject;
+		if (objects[incr] == 0) {
+			if (arena)
+				objects[incr] = new (arena->allocate(sizeof(AnyObject), alignof(AnyObject))) AnyObject(arena);
+			else
+				objects[incr] = new AnyObject;
+		}
 		return *objects[incr++];
 	}
 
 	// Initialize the objects.
 	void AnyArray::init(size_t size) {
-		objects = new Object*[size];
+		objects = arena ? arena->allocate_array<Object*>(size) : new Object*[size];
 		num = size;
 		for (size_t n = 0; n < size; ++n)
 			objects[n] = 0;
@@ -255,7 +280,7 @@ namespace PLY {
 	void AnyArray::deinit() {
 		if (objects) {
 			clear();
-			delete[] objects;
+			if (!arena) delete[] objects;
 			objects = 0;
 		}
 	}
@@ -0,0 +1,56 @@
+#-------------------------------------------------
+#
+# Benchmarks of reading and writing PLY files
+#
+#-------------------------------------------------
+
+QT       += testlib
+QT       -= gui
+
+TARGET = tst_qplybench
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+# Shared Project Configuration
+include(../config.pri)
+
+# Link in 3rd party libs
+macx:LIBS += -lQuaZip
+
+win32:CONFIG(debug, debug|release): LIBS += -lQuaZipd
+else:win32: LIBS += -lQuaZip
+
+# Peak memory is read from the process counters
+win32: LIBS += -lpsapi
+
+SOURCES += \
+    tst_qplybench.cpp
+
+# Add in the PSData library
+win32:CONFIG(release, debug|release): LIBS += -L$$OUT_PWD/../PSData/release/ -lpsdata
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$OUT_PWD/../PSData/debug/ -lpsdata
+else:unix: LIBS += -L$$OUT_PWD/../PSData/ -lpsdata
+
+INCLUDEPATH += $$PWD/../PSData/ $$PWD/../PSData/include
+DEPENDPATH += $$PWD/../PSData/include
+
+# Add in the QPLY library
+win32-g++:CONFIG(release, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../QPLY/release/libQPLY.a
+else:win32-g++:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../QPLY/debug/libQPLY.a
+else:win32:!win32-g++:CONFIG(release, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../QPLY/release/QPLY.lib
+else:win32:!win32-g++:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$OUT_PWD/../QPLY/debug/QPLY.lib
+else:macx: PRE_TARGETDEPS += $$OUT_PWD/../QPLY/libQPLY.a
+
+win32:CONFIG(release, debug|release): LIBS += -L$$OUT_PWD/../QPLY/release/ -lQPLY
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$OUT_PWD/../QPLY/debug/ -lQPLY
+else:macx: LIBS += -L$$OUT_PWD/../QPLY/ -lQPLY
+
+INCLUDEPATH += $$PWD/../QPLY/include
+DEPENDPATH += $$PWD/../QPLY/include
+
+# QPLY reads and writes .ply.gz files through zlib
+macx: LIBS += -lz
+win32:CONFIG(debug, debug|release): LIBS += -lzlibd
+else:win32: LIBS += -lzlib
@@ -0,0 +1,526 @@
+#include <QString>
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <quazip/quazip.h>
+#include <quazip/quazipfile.h>
+#include <quazip/quazipnewinfo.h>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <psapi.h>
+#elif !defined(Q_OS_LINUX)
+#include <sys/resource.h>
+#endif
+
+#ifdef _WIN32
+#pragma warning(push)
+#pragma warning(disable: 4100)
+#else
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter"
+#endif
+
+#include <io.h>
+#include <column.h>
+
+#ifdef _WIN32
+#pragma warning(pop)
+#else
+#pragma clang diagnostic pop
+#endif
+
+#include <PLYMeshData.h>
+
+// The name of the model inside the zip archives (as in PhotoScan projects)
+static const char* ZIP_MODEL_NAME = "model0.ply";
+
+// The mesh sizes to measure, in faces
+static const qlonglong FACE_COUNTS[] = { 100000, 1000000, 10000000, 50000000 };
+
+// The formats of the generated files
+static const char* FORMATS[] = { "ascii", "binary_little_endian", "binary_big_endian" };
+
+// The largest mesh used unless QPLYBENCH_MAX_FACES asks for more
+static const qlonglong DEFAULT_MAX_FACES = 1000000;
+
+// A regular grid of vertices, split into triangles
+struct SyntheticMesh {
+    size_t mVertexCount, mFaceCount;
+    std::vector<float> mXYZ;
+    std::vector<unsigned char> mRGB;
+    std::vector<unsigned int> mIndices;
+    std::vector<float> mTexCoords;
+
+    SyntheticMesh() : mVertexCount(0), mFaceCount(0) {}
+
+    // Build a grid with (at least) the given number of faces
+    void generate(size_t pFaceCount) {
+        // Each cell of the grid holds two triangles
+        size_t lCells = (pFaceCount + 1) / 2;
+        size_t lColumns = (size_t)std::ceil(std::sqrt((double)lCells)) + 1;
+        size_t lRows = (lCells + lColumns - 2) / (lColumns - 1) + 1;
+        mVertexCount = lColumns * lRows;
+        mFaceCount = pFaceCount;
+
+        mXYZ.resize(3 * mVertexCount);
+        mRGB.resize(3 * mVertexCount);
+        for (size_t v = 0; v < mVertexCount; v++) {
+            size_t lCol = v % lColumns, lRow = v / lColumns;
+            mXYZ[3*v + 0] = (float)lCol / (lColumns - 1);
+            mXYZ[3*v + 1] = (float)lRow / (lRows - 1);
+            mXYZ[3*v + 2] = 0.1f * std::sin(0.05f * lCol) * std::cos(0.05f * lRow);
+            mRGB[3*v + 0] = (unsigned char)(lCol * 255 / (lColumns - 1));
+            mRGB[3*v + 1] = (unsigned char)(lRow * 255 / (lRows - 1));
+            mRGB[3*v + 2] = (unsigned char)(v % 256);
+        }
+
+        mIndices.resize(3 * mFaceCount);
+        mTexCoords.resize(6 * mFaceCount);
+        for (size_t f = 0; f < mFaceCount; f++) {
+            size_t lCell = f / 2;
+            size_t lCorner = (lCell / (lColumns - 1)) * lColumns + lCell % (lColumns - 1);
+            size_t lCorners[3];
+            if (f % 2 == 0) {
+                lCorners[0] = lCorner; lCorners[1] = lCorner + 1; lCorners[2] = lCorner + lColumns;
+            } else {
+                lCorners[0] = lCorner + 1; lCorners[1] = lCorner + lColumns + 1; lCorners[2] = lCorner + lColumns;
+            }
+            for (int c = 0; c < 3; c++) {
+                mIndices[3*f + c] = (unsigned int)lCorners[c];
+                mTexCoords[6*f + 2*c + 0] = mXYZ[3*lCorners[c] + 0];
+                mTexCoords[6*f + 2*c + 1] = mXYZ[3*lCorners[c] + 1];
+            }
+        }
+    }
+
+    // Write the mesh in the layout of PhotoScan models
+    bool write(QIODevice* pDevice, PLY::Stream_type pType, bool pColors, bool pTexCoords) const {
+        PLY::Header lHeader;
+        PLY::Element lVertex("vertex");
+        lVertex.num = mVertexCount;
+        lVertex.add_property(PLY::Property("x", PLY::SCALAR, PLY::Float32));
+        lVertex.add_property(PLY::Property("y", PLY::SCALAR, PLY::Float32));
+        lVertex.add_property(PLY::Property("z", PLY::SCALAR, PLY::Float32));
+        if (pColors) {
+            lVertex.add_property(PLY::Property("red", PLY::SCALAR, PLY::Uint8));
+            lVertex.add_property(PLY::Property("green", PLY::SCALAR, PLY::Uint8));
+            lVertex.add_property(PLY::Property("blue", PLY::SCALAR, PLY::Uint8));
+        }
+        PLY::Element lFace("face");
+        lFace.num = mFaceCount;
+        lFace.add_property(PLY::Property("vertex_indices", PLY::LIST, PLY::Int32, PLY::Uint8));
+        if (pTexCoords) {
+            lFace.add_property(PLY::Property("texcoord", PLY::LIST, PLY::Float32, PLY::Uint8));
+        }
+        lHeader.add_element(lVertex);
+        lHeader.add_element(lFace);
+
+        PLY::Writer lWriter(lHeader, pDevice, pType);
+        lWriter.set_values("vertex", "x", &mXYZ[0], 3 * sizeof(float));
+        lWriter.set_values("vertex", "y", &mXYZ[1], 3 * sizeof(float));
+        lWriter.set_values("vertex", "z", &mXYZ[2], 3 * sizeof(float));
+        if (pColors) {
+            lWriter.set_values("vertex", "red", &mRGB[0], 3);
+            lWriter.set_values("vertex", "green", &mRGB[1], 3);
+            lWriter.set_values("vertex", "blue", &mRGB[2], 3);
+        }
+        lWriter.set_fixed_lists("face", "vertex_indices", mIndices.data(), 3);
+        if (pTexCoords) {
+            lWriter.set_fixed_lists("face", "texcoord", mTexCoords.data(), 6);
+        }
+        return lWriter.write_sources();
+    }
+};
+
+#ifdef Q_OS_LINUX
+// Read a size in kB from /proc/self/status, in megabytes
+static double procStatusMB(const char* pField) {
+    QFile lStatus("/proc/self/status");
+    if (!lStatus.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return 0.0;
+    }
+    for (QByteArray lLine = lStatus.readLine(); !lLine.isEmpty(); lLine = lStatus.readLine()) {
+        if (lLine.startsWith(pField)) {
+            return lLine.mid((int)strlen(pField)).trimmed().split(' ').first().toDouble() / 1024.0;
+        }
+    }
+    return 0.0;
+}
+#endif
+
+// The memory used by one benchmark row. On Linux the peak of the process is
+// reset when the row starts, so the peak belongs to the row alone. Elsewhere
+// only the peak of the whole process is known, which includes earlier rows.
+struct RowMemory {
+    double mStartMB;            // The memory held when the row started
+    bool mOwnPeak;              // Whether the peak was reset for the row
+
+    RowMemory() : mStartMB(0.0), mOwnPeak(false) {}
+
+    void start() {
+#ifdef Q_OS_LINUX
+        // Writing 5 to clear_refs sets the peak (VmHWM) to the current size
+        QFile lClear("/proc/self/clear_refs");
+        mOwnPeak = lClear.open(QIODevice::WriteOnly) && lClear.write("5") == 1;
+        lClear.close();
+        mStartMB = procStatusMB("VmRSS:");
+#endif
+    }
+
+    // The peak memory, in megabytes
+    double peakMB() const {
+#if defined(Q_OS_LINUX)
+        return procStatusMB("VmHWM:");
+#elif defined(Q_OS_WIN)
+        PROCESS_MEMORY_COUNTERS lCounters;
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &lCounters, sizeof(lCounters))) {
+            return 0.0;
+        }
+        return lCounters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+        struct rusage lUsage;
+        getrusage(RUSAGE_SELF, &lUsage);
+#ifdef Q_OS_MAC
+        return lUsage.ru_maxrss / (1024.0 * 1024.0);
+#else
+        return lUsage.ru_maxrss / 1024.0;
+#endif
+#endif
+    }
+};
+
+// Report the throughput of the iterations of a benchmark, and its memory
+static void reportThroughput(qint64 pBytes, qlonglong pRows, qint64 pNanoseconds, int pIterations,
+                             const RowMemory& pMemory) {
+    if (pIterations == 0 || pNanoseconds == 0) {
+        return;
+    }
+    double lSeconds = pNanoseconds / 1e9 / pIterations;
+    double lPeakMB = pMemory.peakMB();
+    if (pMemory.mOwnPeak) {
+        qInfo("%.1f MB/s, %.2f M rows/s, peak memory %.1f MB (%.1f MB above the start of the row)",
+              pBytes / lSeconds / (1024.0 * 1024.0), pRows / lSeconds / 1e6, lPeakMB, lPeakMB - pMemory.mStartMB);
+    } else {
+        qInfo("%.1f MB/s, %.2f M rows/s, peak memory of the process %.1f MB",
+              pBytes / lSeconds / (1024.0 * 1024.0), pRows / lSeconds / 1e6, lPeakMB);
+    }
+}
+
+class QPLYBench : public QObject
+{
+    Q_OBJECT
+
+public:
+    QPLYBench();
+
+private slots:
+    void initTestCase();
+
+    void readData_data();
+    void readData();
+
+    void writeData_data();
+    void writeData();
+
+    void readMesh_data();
+    void readMesh();
+
+    void cleanupTestCase();
+
+private:
+    // Add a row for each mesh size, format and container
+    void addMeshRows();
+
+    // Get the generated file of a row, generating the files of its mesh size first if needed
+    QString fileFor(qlonglong pFaces, QString pFormat, bool pColors, bool pTexCoords, bool pZipped);
+
+    // Write the generated mesh to a file
+    bool writeFile(QString pPath, QString pFormat, bool pColors, bool pTexCoords, bool pZipped);
+
+    // Open a generated file for reading, from inside its archive if zipped
+    bool openReader(PLY::Reader& pReader, QString pPath, bool pZipped, std::unique_ptr<QIODevice>& pDevice);
+
+    QTemporaryDir* mDir;
+    qlonglong mMaxFaces;
+    SyntheticMesh mMesh;
+    QMap<QString, qint64> mFileBytes;
+};
+
+/******************************/
+QPLYBench::QPLYBench() : mDir(nullptr), mMaxFaces(DEFAULT_MAX_FACES) {}
+
+void QPLYBench::initTestCase() {
+    mDir = new QTemporaryDir();
+    QVERIFY(mDir->isValid());
+
+    bool lOK = false;
+    qlonglong lMaxFaces = qgetenv("QPLYBENCH_MAX_FACES").toLongLong(&lOK);
+    if (lOK && lMaxFaces > 0) {
+        mMaxFaces = lMaxFaces;
+    }
+    qInfo("Synthetic meshes of up to %lld faces in %s", mMaxFaces, mDir->path().toLocal8Bit().data());
+}
+
+void QPLYBench::addMeshRows() {
+    QTest::addColumn<qlonglong>("faces");
+    QTest::addColumn<QString>("format");
+    QTest::addColumn<bool>("colors");
+    QTest::addColumn<bool>("texCoords");
+    QTest::addColumn<bool>("zipped");
+
+    for (qlonglong lFaces : FACE_COUNTS) {
+        if (lFaces > mMaxFaces) {
+            continue;
+        }
+        for (const char* lFormat : FORMATS) {
+            for (int lVariant = 0; lVariant < 8; lVariant++) {
+                bool lColors = (lVariant & 1) != 0;
+                bool lTexCoords = (lVariant & 2) != 0;
+                bool lZipped = (lVariant & 4) != 0;
+                QString lName = QString("%1 faces, %2%3%4%5").arg(lFaces).arg(lFormat)
+                        .arg(lColors ? ", colors" : "").arg(lTexCoords ? ", uvs" : "")
+                        .arg(lZipped ? ", zip" : "");
+                QTest::newRow(lName.toLocal8Bit().data()) << lFaces << QString(lFormat)
+                                                         << lColors << lTexCoords << lZipped;
+            }
+        }
+    }
+}
+
+// The path of a generated file
+static QString generatedName(qlonglong pFaces, QString pFormat, bool pColors, bool pTexCoords, bool pZipped) {
+    QString lName = QString("f%1_%2%3%4").arg(pFaces).arg(pFormat)
+            .arg(pColors ? "_c" : "").arg(pTexCoords ? "_t" : "");
+    return lName + (pZipped ? ".zip" : ".ply");
+}
+
+QString QPLYBench::fileFor(qlonglong pFaces, QString pFormat, bool pColors, bool pTexCoords, bool pZipped) {
+    QString lPath = mDir->filePath(generatedName(pFaces, pFormat, pColors, pTexCoords, pZipped));
+    if (mFileBytes.contains(lPath)) {
+        return lPath;
+    }
+
+    // All files of a mesh size are written at once, after which the mesh is
+    // released, so that it does not count towards the memory of the rows
+    mMesh.generate((size_t)pFaces);
+    for (const char* lFormat : FORMATS) {
+        for (int lVariant = 0; lVariant < 8; lVariant++) {
+            bool lColors = (lVariant & 1) != 0;
+            bool lTexCoords = (lVariant & 2) != 0;
+            bool lZipped = (lVariant & 4) != 0;
+            writeFile(mDir->filePath(generatedName(pFaces, lFormat, lColors, lTexCoords, lZipped)),
+                      lFormat, lColors, lTexCoords, lZipped);
+        }
+    }
+    mMesh = SyntheticMesh();
+    return mFileBytes.contains(lPath) ? lPath : QString();
+}
+
+bool QPLYBench::writeFile(QString pPath, QString pFormat, bool pColors, bool pTexCoords, bool pZipped) {
+    PLY::Stream_type lType = PLY::ASCII;
+    if (pFormat == "binary_little_endian") {
+        lType = PLY::BINARY_LE;
+    } else if (pFormat == "binary_big_endian") {
+        lType = PLY::BINARY_BE;
+    }
+
+    bool lWritten = false;
+    if (pZipped) {
+        QuaZip lZip(pPath);
+        if (lZip.open(QuaZip::mdCreate)) {
+            QuaZipFile lInsideFile(&lZip);
+            if (lInsideFile.open(QIODevice::WriteOnly, QuaZipNewInfo(ZIP_MODEL_NAME))) {
+                lWritten = mMesh.write(&lInsideFile, lType, pColors, pTexCoords);
+                mFileBytes[pPath] = lInsideFile.pos();
+                lInsideFile.close();
+            }
+            lZip.close();
+        }
+    } else {
+        QFile lFile(pPath);
+        if (lFile.open(QIODevice::WriteOnly)) {
+            lWritten = mMesh.write(&lFile, lType, pColors, pTexCoords);
+            lFile.close();
+            mFileBytes[pPath] = QFileInfo(pPath).size();
+        }
+    }
+
+    if (!lWritten) {
+        qWarning("Failed to generate '%s'", pPath.toLocal8Bit().data());
+        mFileBytes.remove(pPath);
+    }
+    return lWritten;
+}
+
+bool QPLYBench::openReader(PLY::Reader& pReader, QString pPath, bool pZipped, std::unique_ptr<QIODevice>& pDevice) {
+    if (!pZipped) {
+        return pReader.open_file(pPath);
+    }
+    pDevice.reset(new QuaZipFile(pPath, ZIP_MODEL_NAME));
+    if (!pDevice->open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    return pReader.use_io_device(pDevice.get());
+}
+
+void QPLYBench::readData_data() {
+    addMeshRows();
+}
+
+void QPLYBench::readData() {
+    QFETCH(qlonglong, faces);
+    QFETCH(QString, format);
+    QFETCH(bool, colors);
+    QFETCH(bool, texCoords);
+    QFETCH(bool, zipped);
+
+    QString lPath = fileFor(faces, format, colors, texCoords, zipped);
+    QVERIFY(!lPath.isEmpty());
+
+    qlonglong lRows = 0;
+    qint64 lNanoseconds = 0;
+    int lIterations = 0;
+    RowMemory lMemory;
+    lMemory.start();
+    QBENCHMARK {
+        QElapsedTimer lTimer;
+        lTimer.start();
+
+        std::unique_ptr<QIODevice> lDevice;
+        PLY::Header lHeader;
+        PLY::Reader lReader(lHeader);
+        QVERIFY(openReader(lReader, lPath, zipped, lDevice));
+        PLY::ColumnStorage lStore(lHeader);
+        QVERIFY(lReader.read_data(&lStore));
+        lReader.close_file();
+
+        lNanoseconds += lTimer.nsecsElapsed();
+        lIterations++;
+        lRows = 0;
+        for (const PLY::Element& lElem : lHeader.elements) {
+            lRows += lElem.num;
+        }
+    }
+    reportThroughput(mFileBytes[lPath], lRows, lNanoseconds, lIterations, lMemory);
+}
+
+void QPLYBench::writeData_data() {
+    addMeshRows();
+}
+
+void QPLYBench::writeData() {
+    QFETCH(qlonglong, faces);
+    QFETCH(QString, format);
+    QFETCH(bool, colors);
+    QFETCH(bool, texCoords);
+    QFETCH(bool, zipped);
+
+    QString lPath = fileFor(faces, format, colors, texCoords, zipped);
+    QVERIFY(!lPath.isEmpty());
+
+    // Read the mesh to write once, outside of the measurements
+    std::unique_ptr<QIODevice> lInput;
+    PLY::Header lHeader;
+    PLY::Reader lReader(lHeader);
+    QVERIFY(openReader(lReader, lPath, zipped, lInput));
+    PLY::ColumnStorage lStore(lHeader);
+    QVERIFY(lReader.read_data(&lStore));
+    lReader.close_file();
+    PLY::Stream_type lType = lHeader.stream_type;
+
+    qlonglong lRows = 0;
+    for (const PLY::Element& lElem : lHeader.elements) {
+        lRows += lElem.num;
+    }
+
+    // The storage being written is not counted as memory of the row
+    QString lOutPath = mDir->filePath(zipped ? "written.zip" : "written.ply");
+    qint64 lNanoseconds = 0;
+    int lIterations = 0;
+    RowMemory lMemory;
+    lMemory.start();
+    QBENCHMARK {
+        QElapsedTimer lTimer;
+        lTimer.start();
+
+        bool lWritten = false;
+        if (zipped) {
+            QuaZip lZip(lOutPath);
+            QVERIFY(lZip.open(QuaZip::mdCreate));
+            QuaZipFile lInsideFile(&lZip);
+            QVERIFY(lInsideFile.open(QIODevice::WriteOnly, QuaZipNewInfo(ZIP_MODEL_NAME)));
+            PLY::Writer lWriter(lHeader, &lInsideFile, lType);
+            lWritten = lWriter.write_data(&lStore);
+            lInsideFile.close();
+            lZip.close();
+        } else {
+            QFile lFile(lOutPath);
+            QVERIFY(lFile.open(QIODevice::WriteOnly));
+            PLY::Writer lWriter(lHeader, &lFile, lType);
+            lWritten = lWriter.write_data(&lStore);
+            lFile.close();
+        }
+        QVERIFY(lWritten);
+
+        lNanoseconds += lTimer.nsecsElapsed();
+        lIterations++;
+    }
+    QFile::remove(lOutPath);
+    reportThroughput(mFileBytes[lPath], lRows, lNanoseconds, lIterations, lMemory);
+}
+
+void QPLYBench::readMesh_data() {
+    addMeshRows();
+}
+
+void QPLYBench::readMesh() {
+    QFETCH(qlonglong, faces);
+    QFETCH(QString, format);
+    QFETCH(bool, colors);
+    QFETCH(bool, texCoords);
+    QFETCH(bool, zipped);
+
+    QString lPath = fileFor(faces, format, colors, texCoords, zipped);
+    QVERIFY(!lPath.isEmpty());
+
+    qlonglong lRows = 0;
+    qint64 lNanoseconds = 0;
+    int lIterations = 0;
+    RowMemory lMemory;
+    lMemory.start();
+    QBENCHMARK {
+        QElapsedTimer lTimer;
+        lTimer.start();
+
+        PLYMeshData lMesh;
+        if (zipped) {
+            QVERIFY(lMesh.readPLYFile(QFileInfo(lPath), ZIP_MODEL_NAME));
+        } else {
+            QVERIFY(lMesh.readPLYFile(QFileInfo(), lPath));
+        }
+
+        lNanoseconds += lTimer.nsecsElapsed();
+        lIterations++;
+        lRows = (qlonglong)(lMesh.getVertexCount() + lMesh.getFaceCount());
+    }
+    reportThroughput(mFileBytes[lPath], lRows, lNanoseconds, lIterations, lMemory);
+}
+
+void QPLYBench::cleanupTestCase() {
+    delete mDir;
+    mDir = nullptr;
+}
+
+QTEST_APPLESS_MAIN(QPLYBench)
+
+#include "tst_qplybench.moc"